@@ -1,12 +1,65 @@
 // client.cpp
 #include <grpcpp/grpcpp.h>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "proto/interface.grpc.pb.h"
 #include "proto/interface.pb.h"
 
+/**
+ * @brief Parses a whole word as an unsigned 64-bit integer
+ * @param word Input word
+ * @param value Parsed value
+ * @return false if the word is not entirely a non-negative integer in range
+ */
+bool parseUnsigned(const std::string& word, uint64_t& value) {
+    size_t used = 0;
+    try {
+        if (word.empty() || word[0] == '-')
+            return false;
+        value = std::stoull(word, &used);
+    } catch (const std::exception&) {
+        return false;
+    }
+    return used == word.size();
+}
+
+/**
+ * @brief Parses the remaining words of a command as numbers greater than 1
+ * @param iss Stream positioned after the command word
+ * @param numbers Parsed numbers
+ * @return false (after printing why) if a word is not a valid number or none were given
+ */
+bool parseNumbers(std::istringstream& iss, std::vector<uint64_t>& numbers) {
+    std::string word;
+    while (iss >> word) {
+        uint64_t num = 0;
+        if (!parseUnsigned(word, num)) {
+            std::cout << "Not a positive integer: " << word << "\n";
+            return false;
+        }
+        if (num <= 1) {
+            std::cout << "number must be a positive integer\n";
+            return false;
+        }
+        numbers.push_back(num);
+    }
+    if (numbers.empty()) {
+        std::cout << "Give at least one number\n";
+        return false;
+    }
+    return true;
+}
+
 /**
  * @class NumberClient
  * @brief Client for interacting with a gRPC-based number management service.
@@ -90,28 +143,506 @@ public:
         }
     }
 
+    /**
+     * @brief Inserts several numbers with one request.
+     *
+     * @details Sends an InsertBatchRequest and prints the summary followed by the
+     *          outcome of each number, decoded from the result bitmap.
+     *
+     * @param numbers The numbers to insert
+     */
+    void InsertBatch(const std::vector<uint64_t>& numbers) {
+        numbermgmt::InsertBatchRequest request;
+        request.mutable_numbers()->Add(numbers.begin(), numbers.end());
+
+        numbermgmt::BatchResult response;
+        grpc::ClientContext context;
+
+        grpc::Status status = stub_->InsertBatch(&context, request, &response);
+        PrintBatch(status, response, numbers, "inserted", "already exists");
+    }
+
+    /**
+     * @brief Deletes several numbers with one request.
+     *
+     * @param numbers The numbers to delete
+     */
+    void DeleteBatch(const std::vector<uint64_t>& numbers) {
+        numbermgmt::DeleteBatchRequest request;
+        request.mutable_numbers()->Add(numbers.begin(), numbers.end());
+
+        numbermgmt::BatchResult response;
+        grpc::ClientContext context;
+
+        grpc::Status status = stub_->DeleteBatch(&context, request, &response);
+        PrintBatch(status, response, numbers, "deleted", "not found");
+    }
+
+    /**
+     * @brief Streams every number in a file to the server in chunks (bulk insert).
+     *
+     * @details Reads whitespace-separated numbers and sends them as BulkInsertChunks of
+     * kBulkChunk numbers while the file is still being read, then prints the server's
+     * summary. Stops at the first word that is not a number.
+     *
+     * @param path File to read
+     */
+    void BulkInsert(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "Cannot open " << path << "\n";
+            return;
+        }
+        numbermgmt::BulkInsertSummary response;
+        grpc::ClientContext context;
+        std::unique_ptr<grpc::ClientWriter<numbermgmt::BulkInsertChunk>> writer =
+            stub_->BulkInsert(&context, &response);
+
+        numbermgmt::BulkInsertChunk chunk;
+        chunk.mutable_numbers()->Reserve(kBulkChunk);
+        uint64_t num;
+        bool open = true;
+        while (open && in >> num) {
+            chunk.add_numbers(num);
+            if (chunk.numbers_size() == kBulkChunk) {
+                open = writer->Write(chunk);
+                chunk.clear_numbers();
+            }
+        }
+        if (!in.eof())
+            std::cout << "Stopped at a word that is not a number\n";
+        if (open && chunk.numbers_size() > 0)
+            writer->Write(chunk);
+        writer->WritesDone();
+        grpc::Status status = writer->Finish();
+
+        if (status.ok()) {
+            std::cout << response.message() << "\n";
+        } else {
+            std::cout << "RPC failed:\n"
+                      << "  code    = " << status.error_code() << "\n"
+                      << "  message = " << status.error_message() << "\n"
+                      << "  details = " << status.error_details() << "\n";
+        }
+    }
+
     /**
      * @brief Retrieves and prints all stored numbers with their insertion timestamps.
      *
-     * @details Sends a ListRequest and prints the server response message followed
-     * by all stored entries in the format:
+     * @details Opens a ListStream and prints each chunk as it arrives, so neither side
+     * holds the whole set, in the format:
      * number (unix_timestamp)
+     * followed by the total count.
      *
      * @note The list is printed in the order returned by the server.
      */
     void List() {
-        numbermgmt::ListRequest request;
-        numbermgmt::NumberListResponse response;
+        numbermgmt::ListStreamRequest request;
+        numbermgmt::NumberChunk chunk;
+        grpc::ClientContext context;
+
+        std::unique_ptr<grpc::ClientReader<numbermgmt::NumberChunk>> reader = stub_->ListStream(&context, request);
+        uint64_t count = 0;
+        while (reader->Read(&chunk)) {
+            for (int i = 0; i < chunk.numbers_size(); ++i) {
+                std::cout << chunk.numbers(i)
+                          << "  (" << (i < chunk.unix_seconds_size() ? chunk.unix_seconds(i) : 0) << ")\n";
+            }
+            count += chunk.numbers_size();
+        }
+        grpc::Status status = reader->Finish();
+
+        if (status.ok()) {
+            std::cout << "Current count: " << count << "\n";
+        } else {
+            std::cout << "RPC failed:\n"
+                      << "  code    = " << status.error_code() << "\n"
+                      << "  message = " << status.error_message() << "\n"
+                      << "  details = " << status.error_details() << "\n";
+        }
+    }
+
+    /**
+     * @brief Checks whether a number is stored, without changing anything.
+     *
+     * @param number The number to look up
+     */
+    void Contains(uint64_t number) {
+        numbermgmt::ContainsRequest request;
+        request.set_number(number);
+        numbermgmt::ContainsResponse response;
+        grpc::ClientContext context;
+
+        grpc::Status status = stub_->Contains(&context, request, &response);
+
+        if (status.ok()) {
+            std::cout << number << (response.found() ? " is stored" : " is not stored") << "\n";
+        } else {
+            std::cout << "RPC failed:\n"
+                      << "  code    = " << status.error_code() << "\n"
+                      << "  message = " << status.error_message() << "\n"
+                      << "  details = " << status.error_details() << "\n";
+        }
+    }
+
+    /**
+     * @brief Retrieves one number with its insertion timestamp.
+     *
+     * @param number The number to look up
+     */
+    void Get(uint64_t number) {
+        numbermgmt::GetRequest request;
+        request.set_number(number);
+        numbermgmt::OperationResult response;
+        grpc::ClientContext context;
+
+        grpc::Status status = stub_->Get(&context, request, &response);
+
+        if (status.ok()) {
+            std::cout << response.message() << "\n";
+        } else {
+            std::cout << "RPC failed:\n"
+                      << "  code    = " << status.error_code() << "\n"
+                      << "  message = " << status.error_message() << "\n"
+                      << "  details = " << status.error_details() << "\n";
+        }
+    }
+
+    /**
+     * @brief Prints how many stored numbers are smaller than a number.
+     *
+     * @param number The number to rank; it need not be stored
+     */
+    void Rank(uint64_t number) {
+        numbermgmt::RankRequest request;
+        request.set_number(number);
+        numbermgmt::RankResponse response;
+        grpc::ClientContext context;
+
+        grpc::Status status = stub_->Rank(&context, request, &response);
+
+        if (status.ok()) {
+            std::cout << response.rank() << " numbers are smaller than " << number << "\n";
+        } else {
+            std::cout << "RPC failed:\n"
+                      << "  code    = " << status.error_code() << "\n"
+                      << "  message = " << status.error_message() << "\n"
+                      << "  details = " << status.error_details() << "\n";
+        }
+    }
+
+    /**
+     * @brief Retrieves the number at a position in ascending order.
+     *
+     * @param position 0 for the smallest number
+     */
+    void Select(uint64_t position) {
+        numbermgmt::SelectRequest request;
+        request.set_position(position);
+        numbermgmt::OperationResult response;
         grpc::ClientContext context;
 
-        grpc::Status status = stub_->List(&context, request, &response);
+        grpc::Status status = stub_->Select(&context, request, &response);
 
         if (status.ok()) {
             std::cout << response.message() << "\n";
+            if (response.success())
+                std::cout << "  number: " << response.entry().number()
+                          << "  inserted: " << response.entry().timestamp().unix_seconds() << "\n";
+        } else {
+            std::cout << "RPC failed:\n"
+                      << "  code    = " << status.error_code() << "\n"
+                      << "  message = " << status.error_message() << "\n"
+                      << "  details = " << status.error_details() << "\n";
+        }
+    }
+
+    /**
+     * @brief Looks up several numbers in a single request and prints one line per number.
+     *
+     * @param numbers The numbers to look up
+     */
+    void ContainsMany(const std::vector<uint64_t>& numbers) {
+        numbermgmt::ContainsManyRequest request;
+        request.mutable_numbers()->Add(numbers.begin(), numbers.end());
+        numbermgmt::ContainsManyResponse response;
+        grpc::ClientContext context;
+
+        grpc::Status status = stub_->ContainsMany(&context, request, &response);
+
+        if (!status.ok()) {
+            std::cout << "RPC failed:\n"
+                      << "  code    = " << status.error_code() << "\n"
+                      << "  message = " << status.error_message() << "\n"
+                      << "  details = " << status.error_details() << "\n";
+            return;
+        }
+        std::cout << "Found " << response.count() << " of " << numbers.size() << " numbers\n";
+        const std::string& bits = response.found();
+        for (size_t i = 0; i < numbers.size(); ++i) {
+            bool set = i / 8 < bits.size() && (static_cast<uint8_t>(bits[i / 8]) >> (i % 8)) & 1;
+            std::cout << "  " << numbers[i];
+            if (set && static_cast<int>(i) < response.unix_seconds_size())
+                std::cout << "  (" << response.unix_seconds(static_cast<int>(i)) << ")\n";
+            else
+                std::cout << "  not stored\n";
+        }
+    }
+
+    /**
+     * @brief Retrieves and prints the numbers in [min, max), one page per request.
+     *
+     * @details Sends ListRangeRequests, passing each page's cursor to the next request,
+     * until the server returns no cursor. Entries are printed as
+     * number (unix_timestamp)
+     * under a header per page.
+     *
+     * @param min Smallest number to list
+     * @param max Exclusive upper bound, 0 for none
+     * @param limit Entries per page, 0 for the server default
+     */
+    void ListRange(uint64_t min, uint64_t max, uint32_t limit) {
+        numbermgmt::ListRangeRequest request;
+        request.set_min(min);
+        request.set_max(max);
+        request.set_limit(limit);
+
+        for (int page = 1;; ++page) {
+            numbermgmt::ListRangeResponse response;
+            grpc::ClientContext context;
+            grpc::Status status = stub_->ListRange(&context, request, &response);
+
+            if (!status.ok()) {
+                std::cout << "RPC failed:\n"
+                          << "  code    = " << status.error_code() << "\n"
+                          << "  message = " << status.error_message() << "\n"
+                          << "  details = " << status.error_details() << "\n";
+                return;
+            }
+            if (!response.success()) {
+                std::cout << "Failed: " << response.message() << "\n";
+                return;
+            }
+            std::cout << "Page " << page << ": " << response.message() << "\n";
             for (const auto& entry : response.entries()) {
                 std::cout << entry.number()
                           << "  (" << entry.timestamp().unix_seconds() << ")\n";
             }
+            if (response.next_cursor().empty())
+                return;
+            request.set_cursor(response.next_cursor());
+        }
+    }
+
+    /**
+     * @brief Runs an interactive pipelined session over one bidirectional stream.
+     *
+     * @details Reads commands from `in` until "end": insert, delete and contains, each
+     * taking one or more numbers. Every number becomes one tagged operation that is sent
+     * immediately, without waiting for earlier results, so many operations are in flight at
+     * once. A background thread prints results as they arrive, in the format:
+     * [tag] message
+     * Results for different numbers may arrive out of order; operations on the same number
+     * are applied in the order they were sent.
+     *
+     * @param in Command source (the CLI's standard input)
+     */
+    void Session(std::istream& in) {
+        grpc::ClientContext context;
+        std::shared_ptr<grpc::ClientReaderWriter<numbermgmt::SessionRequest, numbermgmt::SessionResponse>> stream =
+            stub_->Session(&context);
+        std::mutex print_mutex;
+
+        std::thread reader([&] {
+            numbermgmt::SessionResponse response;
+            while (stream->Read(&response)) {
+                std::lock_guard<std::mutex> lock(print_mutex);
+                std::cout << "[" << response.tag() << "] " << response.message() << "\n" << std::flush;
+            }
+        });
+
+        std::cout << "Session open: insert|delete|contains <n...>, end to close\n";
+        uint64_t tag = 0;
+        bool open = true;
+        std::string line;
+        while (open && std::getline(in, line)) {
+            std::istringstream iss(line);
+            std::string cmd;
+            if (!(iss >> cmd))
+                continue;
+            if (cmd == "end")
+                break;
+            std::vector<uint64_t> numbers;
+            if (cmd != "insert" && cmd != "delete" && cmd != "contains") {
+                std::lock_guard<std::mutex> lock(print_mutex);
+                std::cout << "Unknown session command\n";
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(print_mutex);
+                if (!parseNumbers(iss, numbers))
+                    continue;
+            }
+            for (uint64_t num : numbers) {
+                numbermgmt::SessionRequest request;
+                request.set_tag(++tag);
+                if (cmd == "insert") request.mutable_insert()->set_number(num);
+                else if (cmd == "delete") request.mutable_delete_()->set_number(num);
+                else request.mutable_contains()->set_number(num);
+                {
+                    std::lock_guard<std::mutex> lock(print_mutex);
+                    std::cout << "[" << tag << "] " << cmd << " " << num << " sent\n";
+                }
+                if (!stream->Write(request)) {
+                    open = false;
+                    break;
+                }
+            }
+        }
+        stream->WritesDone();
+        reader.join();
+        grpc::Status status = stream->Finish();
+
+        if (status.ok()) {
+            std::cout << "Session closed after " << tag << " operations\n";
+        } else {
+            std::cout << "RPC failed:\n"
+                      << "  code    = " << status.error_code() << "\n"
+                      << "  message = " << status.error_message() << "\n"
+                      << "  details = " << status.error_details() << "\n";
+        }
+    }
+
+    /**
+     * @brief Follows the server's change feed and prints changes as they happen.
+     *
+     * @details Prints the feed id and the sequence the watch starts after, then one line per
+     * change in the format:
+     * #sequence insert number (unix_timestamp) | #sequence delete number | #sequence clear first..last
+     * and returns after `count` changes. Passing the printed feed id and the last sequence
+     * seen resumes the feed without missing a change, as long as the server still holds it.
+     *
+     * @param count Changes to print before returning
+     * @param feedId Feed to resume, or 0 to start at the next change
+     * @param after Last sequence seen when resuming
+     */
+    void Watch(uint64_t count, uint64_t feedId, uint64_t after) {
+        numbermgmt::WatchRequest request;
+        request.set_feed_id(feedId);
+        request.set_after_sequence(after);
+        numbermgmt::WatchResponse response;
+        grpc::ClientContext context;
+
+        std::unique_ptr<grpc::ClientReader<numbermgmt::WatchResponse>> reader = stub_->Watch(&context, request);
+        uint64_t seen = 0;
+        uint64_t last = after;
+        while (seen < count && reader->Read(&response)) {
+            if (seen == 0 && response.events_size() == 0)
+                std::cout << "Watching feed " << response.feed_id() << " after sequence " << response.sequence() << "\n";
+            for (int i = 0; i < response.events_size() && seen < count; ++i, ++seen) {
+                const numbermgmt::ChangeEvent& event = response.events(i);
+                std::cout << "#" << event.sequence() << " ";
+                if (event.kind() == numbermgmt::ChangeEvent::INSERT)
+                    std::cout << "insert " << event.number() << "  (" << event.unix_seconds() << ")\n";
+                else if (event.kind() == numbermgmt::ChangeEvent::DELETE)
+                    std::cout << "delete " << event.number() << "\n";
+                else
+                    std::cout << "clear " << event.number() << ".." << event.last() << "\n";
+                last = event.sequence();
+            }
+            std::cout << std::flush;
+        }
+        if (seen == count)
+            context.TryCancel();
+        grpc::Status status = reader->Finish();
+
+        if (status.ok() || (seen == count && status.error_code() == grpc::StatusCode::CANCELLED)) {
+            std::cout << "Watched " << seen << " changes, last sequence " << last << "\n";
+        } else {
+            std::cout << "RPC failed:\n"
+                      << "  code    = " << status.error_code() << "\n"
+                      << "  message = " << status.error_message() << "\n"
+                      << "  details = " << status.error_details() << "\n";
+        }
+    }
+
+    /**
+     * @brief Brings a local copy of the set up to date and prints what it took.
+     *
+     * @details The first call downloads the whole set. Later calls pass the version of the
+     * copy to ListChangesSince and only receive the inserts and deletes made since, unless
+     * the server no longer has them and sends the whole set again. Prints the number of
+     * entries and changes received and the size of the copy, in the format:
+     * Refreshed from <full snapshot|changes>: E entries, C changes; local copy holds N numbers (version V)
+     */
+    void Refresh() {
+        numbermgmt::ListChangesRequest request;
+        request.set_feed_id(copyFeed_);
+        request.set_version(copyVersion_);
+        numbermgmt::ChangesChunk chunk;
+        grpc::ClientContext context;
+
+        std::unique_ptr<grpc::ClientReader<numbermgmt::ChangesChunk>> reader = stub_->ListChangesSince(&context, request);
+        bool full = false;
+        uint64_t entries = 0;
+        uint64_t changes = 0;
+        while (reader->Read(&chunk)) {
+            if (chunk.reset()) {
+                copy_.clear();
+                full = true;
+            }
+            for (int i = 0; i < chunk.numbers_size(); ++i)
+                copy_[chunk.numbers(i)] = i < chunk.unix_seconds_size() ? chunk.unix_seconds(i) : 0;
+            for (const numbermgmt::ChangeEvent& event : chunk.events()) {
+                if (event.kind() == numbermgmt::ChangeEvent::INSERT)
+                    copy_[event.number()] = event.unix_seconds();
+                else if (event.kind() == numbermgmt::ChangeEvent::DELETE)
+                    copy_.erase(event.number());
+                else
+                    copy_.erase(copy_.lower_bound(event.number()), copy_.upper_bound(event.last()));
+            }
+            entries += chunk.numbers_size();
+            changes += chunk.events_size();
+            copyFeed_ = chunk.feed_id();
+            copyVersion_ = chunk.version();
+        }
+        grpc::Status status = reader->Finish();
+
+        if (status.ok()) {
+            std::cout << "Refreshed from " << (full ? "full snapshot" : "changes") << ": " << entries << " entries, "
+                      << changes << " changes; local copy holds " << copy_.size() << " numbers (version "
+                      << copyVersion_ << ")\n";
+        } else {
+            copyFeed_ = 0;  // the copy may be half updated; start over next time
+            std::cout << "RPC failed:\n"
+                      << "  code    = " << status.error_code() << "\n"
+                      << "  message = " << status.error_message() << "\n"
+                      << "  details = " << status.error_details() << "\n";
+        }
+    }
+
+    /**
+     * @brief Retrieves and prints store statistics without listing the set.
+     *
+     * @details Prints the count, smallest and largest number, oldest and newest insertion
+     * timestamp and the memory reserved by the server's storage backend.
+     */
+    void Stats() {
+        numbermgmt::StatsRequest request;
+        numbermgmt::StatsResponse response;
+        grpc::ClientContext context;
+
+        grpc::Status status = stub_->Stats(&context, request, &response);
+
+        if (status.ok()) {
+            std::cout << "count:  " << response.count() << "\n";
+            if (response.count() > 0) {
+                std::cout << "min:    " << response.min() << "\n"
+                          << "max:    " << response.max() << "\n"
+                          << "oldest: " << response.oldest().unix_seconds() << "\n"
+                          << "newest: " << response.newest().unix_seconds() << "\n";
+            }
+            std::cout << "memory: " << response.memory_bytes() << " bytes\n";
         } else {
             std::cout << "RPC failed:\n"
                       << "  code    = " << status.error_code() << "\n"
@@ -120,6 +651,38 @@ public:
         }
     }
 
+    /**
+     * @brief Removes every number in [min, max) with one request.
+     *
+     * @param min Smallest number to remove
+     * @param max Exclusive upper bound; 0 removes everything from min up
+     */
+    void DeleteRange(uint64_t min, uint64_t max) {
+        numbermgmt::DeleteRangeRequest request;
+        request.set_min(min);
+        request.set_max(max);
+        numbermgmt::DeleteCountResult response;
+        grpc::ClientContext context;
+
+        grpc::Status status = stub_->DeleteRange(&context, request, &response);
+        printDeleteCount(status, response);
+    }
+
+    /**
+     * @brief Removes every number inserted before a point in time.
+     *
+     * @param unixSeconds Cutoff; numbers inserted strictly earlier are removed
+     */
+    void DeleteInsertedBefore(int64_t unixSeconds) {
+        numbermgmt::DeleteInsertedBeforeRequest request;
+        request.mutable_before()->set_unix_seconds(unixSeconds);
+        numbermgmt::DeleteCountResult response;
+        grpc::ClientContext context;
+
+        grpc::Status status = stub_->DeleteInsertedBefore(&context, request, &response);
+        printDeleteCount(status, response);
+    }
+
     /**
      * @brief Removes all numbers from the remote storage (clear operation).
      *
@@ -143,7 +706,57 @@ public:
     }
 
 private:
+    static constexpr int kBulkChunk = 65536;  // numbers per BulkInsert message (512 KiB)
+
     std::unique_ptr<numbermgmt::NumberManagement::Stub> stub_;
+
+    std::map<uint64_t, int64_t> copy_;  // local copy of the set kept by Refresh: number -> insert time
+    uint64_t copyFeed_ = 0;             // feed and version copy_ is current to; 0 = no copy yet
+    uint64_t copyVersion_ = 0;
+
+    /**
+     * @brief Prints the outcome of a DeleteRange or DeleteInsertedBefore call.
+     */
+    static void printDeleteCount(const grpc::Status& status, const numbermgmt::DeleteCountResult& response) {
+        if (status.ok()) {
+            std::cout << response.message() << "\n";
+        } else {
+            std::cout << "RPC failed:\n"
+                      << "  code    = " << status.error_code() << "\n"
+                      << "  message = " << status.error_message() << "\n"
+                      << "  details = " << status.error_details() << "\n";
+        }
+    }
+
+    /**
+     * @brief Prints a batch result, one line per number.
+     *
+     * @param status RPC status
+     * @param response Batch result
+     * @param numbers The numbers that were sent, in request order
+     * @param done Word for a number whose bit is set
+     * @param skipped Word for a number whose bit is clear
+     */
+    static void PrintBatch(const grpc::Status& status, const numbermgmt::BatchResult& response,
+                           const std::vector<uint64_t>& numbers, const char* done, const char* skipped) {
+        if (!status.ok()) {
+            std::cout << "RPC failed:\n"
+                      << "  code    = " << status.error_code() << "\n"
+                      << "  message = " << status.error_message() << "\n"
+                      << "  details = " << status.error_details() << "\n";
+            return;
+        }
+        if (!response.success()) {
+            std::cout << "Failed: " << response.message() << "\n";
+            return;
+        }
+        std::cout << response.message() << "\n";
+        const std::string& bits = response.outcomes();
+        for (size_t i = 0; i < numbers.size(); ++i) {
+            bool set = i / 8 < bits.size() && (static_cast<uint8_t>(bits[i / 8]) >> (i % 8)) & 1;
+            std::cout << "  " << numbers[i] << "  " << (set ? done : skipped) << "\n";
+        }
+    }
 };
 
 /**
@@ -170,8 +783,33 @@ void print_help() {
     Commands:
     insert <number>     Add a positive integer           e.g. insert 2025
     delete <number>     Remove a number if it exists     e.g. delete 100
+    insert-batch <n...> Add several numbers at once      e.g. insert-batch 5 6 7
+    delete-batch <n...> Remove several numbers at once   e.g. delete-batch 5 7
+    bulk-insert <file>  Stream every number in a file    e.g. bulk-insert ids.txt
+    contains <number>   Check whether a number is stored e.g. contains 2025
+    get <number>        Show a number and its timestamp  e.g. get 2025
+    contains-many <n...> Check several numbers at once   e.g. contains-many 5 6
+    rank <number>       Count stored numbers below it    e.g. rank 2025
+    select <position>   Show the number at a position,
+                        0 = smallest                     e.g. select 0
     list                Show all numbers (sorted) with timestamps
+    list-range <min> <max> [page]
+                        Show numbers in [min, max) page by page;
+                        max 0 = no limit                 e.g. list-range 10 100 5
+    refresh             Update a local copy of the set with the changes
+                        since the last refresh
+    stats               Show count, min/max, oldest/newest insert and memory
+    delete-range <min> <max>
+                        Delete numbers in [min, max);
+                        max 0 = no limit                 e.g. delete-range 10 100
+    delete-before <unix_seconds>
+                        Delete numbers inserted earlier  e.g. delete-before 1767225600
     clear               Delete everything
+    session             Pipeline insert/delete/contains commands over one
+                        stream without waiting for each result; end leaves
+    watch <count> [feed_id after_sequence]
+                        Print the next count changes as they happen, or
+                        resume after a sequence seen     e.g. watch 10
     help                Show this help message
     exit                Exit the program
 
@@ -234,6 +872,53 @@ int main()
                 }
             }
         }
+        else if (cmd == "insert-batch") {
+            std::vector<uint64_t> numbers;
+            if (parseNumbers(iss, numbers)) client.InsertBatch(numbers);
+        }
+        else if (cmd == "delete-batch") {
+            std::vector<uint64_t> numbers;
+            if (parseNumbers(iss, numbers)) client.DeleteBatch(numbers);
+        }
+        else if (cmd == "rank" || cmd == "select") {
+            std::vector<std::string> words{std::istream_iterator<std::string>(iss), std::istream_iterator<std::string>()};
+            uint64_t value = 0;
+            if (words.size() != 1 || !parseUnsigned(words[0], value)) {
+                std::cout << "Usage: " << cmd << (cmd == "rank" ? " <number>\n" : " <position>\n");
+            }
+            else if (cmd == "rank") {
+                client.Rank(value);
+            }
+            else {
+                client.Select(value);
+            }
+        }
+        else if (cmd == "contains" || cmd == "get") {
+            std::vector<std::string> words{std::istream_iterator<std::string>(iss), std::istream_iterator<std::string>()};
+            uint64_t num = 0;
+            if (words.size() != 1 || !parseUnsigned(words[0], num)) {
+                std::cout << "Usage: " << cmd << " <number>\n";
+            }
+            else if (cmd == "contains") {
+                client.Contains(num);
+            }
+            else {
+                client.Get(num);
+            }
+        }
+        else if (cmd == "contains-many") {
+            std::vector<uint64_t> numbers;
+            if (parseNumbers(iss, numbers)) client.ContainsMany(numbers);
+        }
+        else if (cmd == "bulk-insert") {
+            std::string path, extra;
+            if (!(iss >> path) || (iss >> extra)) {
+                std::cout << "Usage: bulk-insert <file>\n";
+            }
+            else {
+                client.BulkInsert(path);
+            }
+        }
         else if (cmd == "list") {
             // Verify correct number of args
             if(countWordsAlg(iss.str()) > 1){
@@ -243,6 +928,80 @@ int main()
                 client.List();
             }
         }
+        else if (cmd == "list-range") {
+            std::vector<std::string> words{std::istream_iterator<std::string>(iss), std::istream_iterator<std::string>()};
+            uint64_t values[3] = {0, 0, 0};
+            bool valid = words.size() == 2 || words.size() == 3;
+            for (size_t i = 0; valid && i < words.size(); ++i)
+                valid = parseUnsigned(words[i], values[i]);
+            if (!valid || values[2] > std::numeric_limits<uint32_t>::max()) {
+                std::cout << "Usage: list-range <min> <max> [page] with non-negative integers\n";
+            }
+            else {
+                client.ListRange(values[0], values[1], static_cast<uint32_t>(values[2]));
+            }
+        }
+        else if (cmd == "delete-range") {
+            std::vector<std::string> words{std::istream_iterator<std::string>(iss), std::istream_iterator<std::string>()};
+            uint64_t values[2] = {0, 0};
+            bool valid = words.size() == 2;
+            for (size_t i = 0; valid && i < words.size(); ++i)
+                valid = parseUnsigned(words[i], values[i]);
+            if (!valid) {
+                std::cout << "Usage: delete-range <min> <max> with non-negative integers\n";
+            }
+            else {
+                client.DeleteRange(values[0], values[1]);
+            }
+        }
+        else if (cmd == "delete-before") {
+            std::vector<std::string> words{std::istream_iterator<std::string>(iss), std::istream_iterator<std::string>()};
+            uint64_t seconds = 0;
+            if (words.size() != 1 || !parseUnsigned(words[0], seconds) ||
+                seconds > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+                std::cout << "Usage: delete-before <unix_seconds>\n";
+            }
+            else {
+                client.DeleteInsertedBefore(static_cast<int64_t>(seconds));
+            }
+        }
+        else if (cmd == "session") {
+            if(countWordsAlg(iss.str()) > 1){
+                std::cout << "Too many arguments were input\n";
+            }
+            else{
+                client.Session(std::cin);
+            }
+        }
+        else if (cmd == "watch") {
+            std::vector<std::string> words{std::istream_iterator<std::string>(iss), std::istream_iterator<std::string>()};
+            uint64_t values[3] = {0, 0, 0};
+            bool valid = words.size() == 1 || words.size() == 3;
+            for (size_t i = 0; valid && i < words.size(); ++i)
+                valid = parseUnsigned(words[i], values[i]);
+            if (!valid || values[0] == 0) {
+                std::cout << "Usage: watch <count> [feed_id after_sequence]\n";
+            }
+            else {
+                client.Watch(values[0], values[1], values[2]);
+            }
+        }
+        else if (cmd == "refresh") {
+            if(countWordsAlg(iss.str()) > 1){
+                std::cout << "Too many arguments were input\n";
+            }
+            else{
+                client.Refresh();
+            }
+        }
+        else if (cmd == "stats") {
+            if(countWordsAlg(iss.str()) > 1){
+                std::cout << "Too many arguments were input\n";
+            }
+            else{
+                client.Stats();
+            }
+        }
         else if (cmd == "clear") {
             // Verify correct number of args
             if(countWordsAlg(iss.str()) > 1){
@@ -0,0 +1,202 @@
+// store_bench.cpp
+#include "btree.h"
+#include "number_store.h"
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Micro-benchmark of the server storage containers
+ *
+ * @details Runs the same workload against std::map (the original storage) and every
+ *          candidate container: random inserts, point lookups, an in-order scan and
+ *          random deletes. Reports nanoseconds per operation. A second pass measures
+ *          write latency percentiles of each NumberStore backend while another thread
+ *          keeps listing the whole set. A third pass loads a dense run of consecutive
+ *          numbers into every backend and reports heap bytes per number, the size and
+ *          utilization of its node pools, and the cost of a full scan of entries versus
+ *          numbers only; roaring, which leaves the expiry index off by default, is
+ *          measured again with it on.
+ *
+ *          Usage: store_bench [count]   (default 1000000)
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double ns_per_op(Clock::time_point start, size_t ops) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    return ops ? static_cast<double>(elapsed) / static_cast<double>(ops) : 0.0;
+}
+
+/**
+ * @brief Time insert / find / scan / erase for one container type
+ * @param name Label printed in the report
+ * @param keys Keys to insert, in insertion order
+ * @param probes Keys looked up after the inserts, then deleted
+ * @param now Timestamp stored with every key
+ */
+template <typename Container>
+void run(const std::string& name, const std::vector<uint64_t>& keys, const std::vector<uint64_t>& probes, time_t now) {
+    Container c;
+
+    auto start = Clock::now();
+    for (uint64_t k : keys)
+        c.try_emplace(k, now);
+    double insert_ns = ns_per_op(start, keys.size());
+
+    size_t hits = 0;
+    start = Clock::now();
+    for (uint64_t k : probes)
+        hits += c.find(k) != c.end();
+    double find_ns = ns_per_op(start, probes.size());
+
+    uint64_t checksum = 0;
+    start = Clock::now();
+    for (const auto& [num, ts] : c)
+        checksum += num ^ static_cast<uint64_t>(ts);
+    double scan_ns = ns_per_op(start, c.size());
+
+    start = Clock::now();
+    for (uint64_t k : probes)
+        c.erase(k);
+    double erase_ns = ns_per_op(start, probes.size());
+
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << insert_ns << std::setw(12) << find_ns << std::setw(12) << scan_ns
+              << std::setw(12) << erase_ns << "    (hits " << hits << ", checksum " << checksum << ")\n";
+}
+
+/**
+ * @brief Measure insert/erase latency of a backend while a reader lists the full set
+ * @param backend Backend name passed to make_number_store
+ * @param keys Keys preloaded before measuring
+ * @param now Timestamp stored with every key
+ */
+void run_concurrent(const std::string& backend, const std::vector<uint64_t>& keys, time_t now) {
+    StoreOptions options;
+    options.backend = backend;
+    std::unique_ptr<NumberStore> store = make_number_store(options);
+    for (uint64_t k : keys)
+        store->insert(k, now);
+
+    std::atomic<bool> done{false};
+    size_t lists = 0;
+    std::thread reader([&] {
+        while (!done.load()) {
+            size_t seen = 0;
+            store->snapshot()->for_each([&](uint64_t, time_t) { ++seen; });  // what List does
+            ++lists;
+        }
+    });
+
+    std::vector<double> latencies;
+    latencies.reserve(keys.size() / 4);
+    for (size_t i = 0; i < keys.size() / 4; ++i) {
+        uint64_t k = keys[i] + keys.size() * 4;  // outside the preloaded range
+        auto start = Clock::now();
+        if (i % 2 == 0)
+            store->insert(k, now);
+        else
+            store->erase(keys[i - 1] + keys.size() * 4);
+        latencies.push_back(ns_per_op(start, 1));
+    }
+    done.store(true);
+    reader.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))]; };
+    std::cout << std::left << std::setw(10) << backend << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << pct(0.5) << std::setw(12) << pct(0.99) << std::setw(12) << pct(0.999)
+              << "    (" << lists << " full lists during the run)\n";
+}
+
+size_t heap_in_use() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;  // small chunks plus large mmapped blocks
+}
+
+/**
+ * @brief Report heap bytes per number and full-scan cost on a dense run of consecutive numbers
+ * @param backend Backend name passed to make_number_store
+ * @param count Length of the run
+ * @param now Timestamp stored with every key
+ * @param expiry_index Override the backend's expiry index default (labelled with a *)
+ */
+void run_dense(const std::string& backend, size_t count, time_t now, std::optional<bool> expiry_index = std::nullopt) {
+    StoreOptions options;
+    options.backend = backend;
+    options.expiry_index = expiry_index;
+    size_t before = heap_in_use();
+    std::unique_ptr<NumberStore> store = make_number_store(options);
+    for (uint64_t k = 0; k < count; ++k)
+        store->insert(k, now);
+    double per_number = static_cast<double>(heap_in_use() - before) / static_cast<double>(count);
+    PoolStats pools = store->allocator_stats();
+
+    uint64_t checksum = 0;
+    auto start = Clock::now();
+    store->for_each([&](uint64_t num, time_t ts) { checksum += num ^ static_cast<uint64_t>(ts); });
+    double entries_ns = ns_per_op(start, count);
+
+    start = Clock::now();
+    store->for_each_number([&](uint64_t num) { checksum += num; });
+    double numbers_ns = ns_per_op(start, count);
+
+    std::cout << std::left << std::setw(10) << (expiry_index ? backend + "*" : backend) << std::right << std::fixed
+              << std::setprecision(1) << std::setw(12) << per_number << std::setw(12) << pools.reserved_bytes / 1024 << std::setw(11)
+              << pools.utilization() * 100 << "%" << std::setw(12) << entries_ns << std::setw(12) << numbers_ns
+              << "    (checksum " << checksum << ")\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::stoull(argv[1]) : 1000000;
+
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> keys(count);
+    for (auto& k : keys)
+        k = rng() % (count * 4) + 1;
+
+    std::vector<uint64_t> probes(keys);
+    std::shuffle(probes.begin(), probes.end(), rng);
+
+    std::cout << count << " keys, ns/op\n"
+              << std::left << std::setw(10) << "container" << std::right << std::setw(12) << "insert"
+              << std::setw(12) << "find" << std::setw(12) << "scan" << std::setw(12) << "erase" << "\n";
+
+    time_t now = time(nullptr);
+    run<std::map<uint64_t, time_t>>("std::map", keys, probes, now);
+    run<BPlusTree<uint64_t, time_t>>("b+tree", keys, probes, now);
+
+    std::cout << "\nwrite latency under concurrent List, ns\n"
+              << std::left << std::setw(10) << "backend" << std::right << std::setw(12) << "p50"
+              << std::setw(12) << "p99" << std::setw(12) << "p99.9" << "\n";
+    for (const char* backend : {"btree", "skiplist", "art", "hash"})
+        run_concurrent(backend, keys, now);
+
+    std::cout << "\nmemory and full-scan ns/number, " << count << " consecutive numbers\n"
+              << std::left << std::setw(10) << "backend" << std::right << std::setw(12) << "bytes"
+              << std::setw(12) << "pool KiB" << std::setw(12) << "pool used" << std::setw(12) << "entries"
+              << std::setw(12) << "numbers" << "\n";
+    for (const char* backend : {"btree", "skiplist", "roaring", "art", "hash"})
+        run_dense(backend, count, now);
+    run_dense("roaring", count, now, true);
+    std::cout << "* with the expiry index (--expiry-index on; the default for btree, art and hash)\n";
+    return 0;
+}
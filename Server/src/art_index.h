@@ -0,0 +1,600 @@
+// art_index.h
+#pragma once
+
+#include "node_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <initializer_list>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Shard index backed by an adaptive radix tree over 64-bit keys
+ *
+ * @details Keys are split into 8 bytes, most significant first, so an in-order walk of the
+ *          tree is sorted by number. Each inner node branches on one byte and grows or
+ *          shrinks between 4, 16, 48 and 256 child slots with its fan-out; single-child
+ *          chains are collapsed into a per-node prefix (path compression). A lookup therefore
+ *          costs at most 8 node visits regardless of how many numbers are stored.
+ *
+ *          Child references are tagged pointers: the low bit marks a leaf holding the full
+ *          key and its timestamp. Leaves and each node size come from their own NodePool,
+ *          so clear() releases the whole tree without walking it.
+ */
+class ArtIndex {
+public:
+    ArtIndex() = default;
+    ~ArtIndex() { clear(); }
+
+    ArtIndex(const ArtIndex&) = delete;
+    ArtIndex& operator=(const ArtIndex&) = delete;
+
+    std::pair<time_t, bool> insert(uint64_t number, time_t ts) {
+        Ref* slot = &root_;
+        int depth = 0;
+        for (;;) {
+            Ref ref = *slot;
+            if (!ref) {
+                *slot = make_leaf(number, ts);
+                break;
+            }
+            if (is_leaf(ref)) {
+                Leaf* leaf = as_leaf(ref);
+                if (leaf->key == number)
+                    return {leaf->ts, false};
+                // Two keys meet: branch at the first byte where they differ
+                Node4* node = make<Node4>();
+                while (byte_at(number, depth + node->prefix_len) == byte_at(leaf->key, depth + node->prefix_len)) {
+                    node->prefix[node->prefix_len] = byte_at(number, depth + node->prefix_len);
+                    ++node->prefix_len;
+                }
+                int split = depth + node->prefix_len;
+                Ref grown = ref_of(node);
+                add_child(grown, node, byte_at(leaf->key, split), ref);
+                add_child(grown, node, byte_at(number, split), make_leaf(number, ts));
+                *slot = grown;
+                break;
+            }
+
+            Node* node = as_node(ref);
+            int matched = prefix_match(node, number, depth);
+            if (matched < node->prefix_len) {
+                // Key leaves the compressed path: split it with a new parent
+                Node4* parent = make<Node4>();
+                parent->prefix_len = static_cast<uint8_t>(matched);
+                std::memcpy(parent->prefix, node->prefix, matched);
+                uint8_t old_byte = node->prefix[matched];
+                node->prefix_len = static_cast<uint8_t>(node->prefix_len - matched - 1);
+                std::memmove(node->prefix, node->prefix + matched + 1, node->prefix_len);
+                Ref grown = ref_of(parent);
+                add_child(grown, parent, old_byte, ref);
+                add_child(grown, parent, byte_at(number, depth + matched), make_leaf(number, ts));
+                *slot = grown;
+                break;
+            }
+
+            depth += node->prefix_len;
+            uint8_t b = byte_at(number, depth);
+            Ref* child = find_child(node, b);
+            if (!child) {
+                add_child(*slot, node, b, make_leaf(number, ts));
+                break;
+            }
+            slot = child;
+            ++depth;
+        }
+        ++size_;
+        return {ts, true};
+    }
+
+    std::optional<time_t> erase(uint64_t number) {
+        std::optional<time_t> erased = erase_from(root_, number, 0);
+        if (erased)
+            --size_;
+        return erased;
+    }
+
+    std::optional<time_t> find(uint64_t number) const {
+        Ref ref = root_;
+        int depth = 0;
+        while (ref) {
+            if (is_leaf(ref)) {
+                const Leaf* leaf = as_leaf(ref);
+                return leaf->key == number ? std::optional<time_t>(leaf->ts) : std::nullopt;
+            }
+            Node* node = as_node(ref);
+            if (prefix_match(node, number, depth) != node->prefix_len)
+                return std::nullopt;
+            depth += node->prefix_len;
+            Ref* child = find_child(node, byte_at(number, depth));
+            if (!child)
+                return std::nullopt;
+            ref = *child;
+            ++depth;
+        }
+        return std::nullopt;
+    }
+
+    std::optional<uint64_t> first() const { return root_ ? std::optional<uint64_t>(edge_leaf(false)) : std::nullopt; }
+    std::optional<uint64_t> last() const { return root_ ? std::optional<uint64_t>(edge_leaf(true)) : std::nullopt; }
+
+    template <typename Fn>
+    void scan(uint64_t from, Fn&& fn) const {
+        if (root_)
+            scan_from(root_, from, 0, true, fn);
+    }
+
+    size_t size() const { return size_; }
+
+    PoolStats allocator_stats() const {
+        PoolStats stats;
+        for (const NodePool* pool : {&leaves_, &nodes4_, &nodes16_, &nodes48_, &nodes256_})
+            stats += pool->stats();
+        return stats;
+    }
+
+    void clear() {
+        // Nodes are trivially destructible, so dropping the pools frees the whole tree
+        for (NodePool* pool : {&leaves_, &nodes4_, &nodes16_, &nodes48_, &nodes256_})
+            pool->release();
+        root_ = 0;
+        size_ = 0;
+    }
+
+    /**
+     * @brief Free about `bytes` of a retired tree's slabs (see Reclaimer)
+     * @return true once every pool is empty
+     */
+    bool release_some(size_t bytes) {
+        root_ = 0;
+        size_ = 0;
+        size_t left = bytes;
+        for (NodePool* pool : {&leaves_, &nodes4_, &nodes16_, &nodes48_, &nodes256_}) {
+            if (left == 0)
+                return false;
+            left -= std::min(left, pool->release_some(left));
+        }
+        return left > 0;
+    }
+
+private:
+    using Ref = uintptr_t;  // tagged child pointer: 0 = empty, low bit set = Leaf
+
+    static constexpr Ref kLeafTag = 1;
+    static constexpr int kKeyBytes = 8;
+
+    enum class NodeType : uint8_t { N4, N16, N48, N256 };
+
+    struct Leaf {
+        uint64_t key;
+        time_t ts;
+    };
+
+    struct Node {
+        NodeType type;
+        uint8_t prefix_len = 0;
+        uint16_t count = 0;
+        uint8_t prefix[kKeyBytes];  // compressed path bytes below the parent's branch byte
+    };
+
+    struct Node4 : Node {
+        Node4() { type = NodeType::N4; }
+        uint8_t keys[4] = {};  // sorted
+        Ref children[4] = {};
+    };
+
+    struct Node16 : Node {
+        Node16() { type = NodeType::N16; }
+        uint8_t keys[16] = {};  // sorted
+        Ref children[16] = {};
+    };
+
+    struct Node48 : Node {
+        Node48() { type = NodeType::N48; }
+        uint8_t index[256] = {};  // byte -> slot + 1, 0 = absent
+        Ref children[48] = {};
+    };
+
+    struct Node256 : Node {
+        Node256() { type = NodeType::N256; }
+        Ref children[256] = {};
+    };
+
+    Ref root_ = 0;
+    size_t size_ = 0;
+    NodePool leaves_{sizeof(Leaf), alignof(Leaf)};
+    NodePool nodes4_{sizeof(Node4), alignof(Node4)};
+    NodePool nodes16_{sizeof(Node16), alignof(Node16)};
+    NodePool nodes48_{sizeof(Node48), alignof(Node48)};
+    NodePool nodes256_{sizeof(Node256), alignof(Node256)};
+
+    static uint8_t byte_at(uint64_t key, int depth) { return static_cast<uint8_t>(key >> (8 * (kKeyBytes - 1 - depth))); }
+
+    static bool is_leaf(Ref ref) { return ref & kLeafTag; }
+    static Leaf* as_leaf(Ref ref) { return reinterpret_cast<Leaf*>(ref & ~kLeafTag); }
+    static Node* as_node(Ref ref) { return reinterpret_cast<Node*>(ref); }
+    static Ref ref_of(Node* node) { return reinterpret_cast<Ref>(node); }
+    Ref make_leaf(uint64_t key, time_t ts) { return reinterpret_cast<Ref>(new (leaves_.allocate()) Leaf{key, ts}) | kLeafTag; }
+
+    template <typename T>
+    NodePool& pool_for() {
+        if constexpr (std::is_same_v<T, Leaf>)
+            return leaves_;
+        else if constexpr (std::is_same_v<T, Node4>)
+            return nodes4_;
+        else if constexpr (std::is_same_v<T, Node16>)
+            return nodes16_;
+        else if constexpr (std::is_same_v<T, Node48>)
+            return nodes48_;
+        else
+            return nodes256_;
+    }
+
+    template <typename T>
+    T* make() {
+        return new (pool_for<T>().allocate()) T;
+    }
+
+    template <typename T>
+    void free_node(T* node) {
+        node->~T();
+        pool_for<T>().deallocate(node);
+    }
+
+    /**
+     * @brief Number of leading prefix bytes of node that match key at depth
+     */
+    static int prefix_match(const Node* node, uint64_t key, int depth) {
+        int i = 0;
+        while (i < node->prefix_len && node->prefix[i] == byte_at(key, depth + i))
+            ++i;
+        return i;
+    }
+
+    /**
+     * @brief Key of the leftmost or rightmost leaf of a non-empty tree (at most 8 steps)
+     */
+    uint64_t edge_leaf(bool rightmost) const {
+        Ref ref = root_;
+        while (!is_leaf(ref)) {
+            Node* node = as_node(ref);
+            switch (node->type) {
+            case NodeType::N4: {
+                auto* n = static_cast<Node4*>(node);
+                ref = n->children[rightmost ? n->count - 1 : 0];
+                break;
+            }
+            case NodeType::N16: {
+                auto* n = static_cast<Node16*>(node);
+                ref = n->children[rightmost ? n->count - 1 : 0];
+                break;
+            }
+            case NodeType::N48: {
+                auto* n = static_cast<Node48*>(node);
+                int b = rightmost ? 255 : 0;
+                while (!n->index[b])
+                    b += rightmost ? -1 : 1;
+                ref = n->children[n->index[b] - 1];
+                break;
+            }
+            case NodeType::N256: {
+                auto* n = static_cast<Node256*>(node);
+                int b = rightmost ? 255 : 0;
+                while (!n->children[b])
+                    b += rightmost ? -1 : 1;
+                ref = n->children[b];
+                break;
+            }
+            }
+        }
+        return as_leaf(ref)->key;
+    }
+
+    static Ref* find_child(Node* node, uint8_t b) {
+        switch (node->type) {
+        case NodeType::N4: {
+            auto* n = static_cast<Node4*>(node);
+            for (int i = 0; i < n->count; ++i)
+                if (n->keys[i] == b)
+                    return &n->children[i];
+            return nullptr;
+        }
+        case NodeType::N16: {
+            auto* n = static_cast<Node16*>(node);
+            for (int i = 0; i < n->count; ++i)
+                if (n->keys[i] == b)
+                    return &n->children[i];
+            return nullptr;
+        }
+        case NodeType::N48: {
+            auto* n = static_cast<Node48*>(node);
+            return n->index[b] ? &n->children[n->index[b] - 1] : nullptr;
+        }
+        case NodeType::N256: {
+            auto* n = static_cast<Node256*>(node);
+            return n->children[b] ? &n->children[b] : nullptr;
+        }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Visit children with branch byte >= start in ascending byte order
+     * @param fn Callable fn(byte, child) returning false to stop
+     * @return false if fn stopped the iteration
+     */
+    template <typename Fn>
+    static bool for_each_child(const Node* node, uint8_t start, Fn&& fn) {
+        switch (node->type) {
+        case NodeType::N4: {
+            auto* n = static_cast<const Node4*>(node);
+            for (int i = 0; i < n->count; ++i)
+                if (n->keys[i] >= start && !fn(n->keys[i], n->children[i]))
+                    return false;
+            return true;
+        }
+        case NodeType::N16: {
+            auto* n = static_cast<const Node16*>(node);
+            for (int i = 0; i < n->count; ++i)
+                if (n->keys[i] >= start && !fn(n->keys[i], n->children[i]))
+                    return false;
+            return true;
+        }
+        case NodeType::N48: {
+            auto* n = static_cast<const Node48*>(node);
+            for (unsigned b = start; b < 256; ++b)
+                if (n->index[b] && !fn(static_cast<uint8_t>(b), n->children[n->index[b] - 1]))
+                    return false;
+            return true;
+        }
+        case NodeType::N256: {
+            auto* n = static_cast<const Node256*>(node);
+            for (unsigned b = start; b < 256; ++b)
+                if (n->children[b] && !fn(static_cast<uint8_t>(b), n->children[b]))
+                    return false;
+            return true;
+        }
+        }
+        return true;
+    }
+
+    template <typename Small>
+    static void insert_sorted(Small* n, uint8_t b, Ref child) {
+        int pos = n->count;
+        while (pos > 0 && n->keys[pos - 1] > b) {
+            n->keys[pos] = n->keys[pos - 1];
+            n->children[pos] = n->children[pos - 1];
+            --pos;
+        }
+        n->keys[pos] = b;
+        n->children[pos] = child;
+        ++n->count;
+    }
+
+    template <typename Small>
+    static void remove_sorted(Small* n, uint8_t b) {
+        int pos = 0;
+        while (n->keys[pos] != b)
+            ++pos;
+        for (; pos + 1 < n->count; ++pos) {
+            n->keys[pos] = n->keys[pos + 1];
+            n->children[pos] = n->children[pos + 1];
+        }
+        --n->count;
+        n->children[n->count] = 0;
+    }
+
+    static void copy_header(Node* to, const Node* from) {
+        to->prefix_len = from->prefix_len;
+        to->count = from->count;
+        std::memcpy(to->prefix, from->prefix, kKeyBytes);
+    }
+
+    /**
+     * @brief Add a child under byte b, growing node (and updating slot) when it is full
+     */
+    void add_child(Ref& slot, Node* node, uint8_t b, Ref child) {
+        switch (node->type) {
+        case NodeType::N4: {
+            auto* n = static_cast<Node4*>(node);
+            if (n->count < 4)
+                return insert_sorted(n, b, child);
+            auto* grown = make<Node16>();
+            copy_header(grown, n);
+            std::memcpy(grown->keys, n->keys, sizeof(n->keys));
+            std::memcpy(grown->children, n->children, sizeof(n->children));
+            free_node(n);
+            slot = ref_of(grown);
+            return insert_sorted(grown, b, child);
+        }
+        case NodeType::N16: {
+            auto* n = static_cast<Node16*>(node);
+            if (n->count < 16)
+                return insert_sorted(n, b, child);
+            auto* grown = make<Node48>();
+            copy_header(grown, n);
+            for (int i = 0; i < n->count; ++i) {
+                grown->index[n->keys[i]] = static_cast<uint8_t>(i + 1);
+                grown->children[i] = n->children[i];
+            }
+            free_node(n);
+            slot = ref_of(grown);
+            return add_child(slot, grown, b, child);
+        }
+        case NodeType::N48: {
+            auto* n = static_cast<Node48*>(node);
+            if (n->count < 48) {
+                int free_slot = 0;
+                while (n->children[free_slot])
+                    ++free_slot;
+                n->children[free_slot] = child;
+                n->index[b] = static_cast<uint8_t>(free_slot + 1);
+                ++n->count;
+                return;
+            }
+            auto* grown = make<Node256>();
+            copy_header(grown, n);
+            for (unsigned k = 0; k < 256; ++k)
+                if (n->index[k])
+                    grown->children[k] = n->children[n->index[k] - 1];
+            free_node(n);
+            slot = ref_of(grown);
+            return add_child(slot, grown, b, child);
+        }
+        case NodeType::N256: {
+            auto* n = static_cast<Node256*>(node);
+            n->children[b] = child;
+            ++n->count;
+            return;
+        }
+        }
+    }
+
+    /**
+     * @brief Remove the child under byte b, shrinking or collapsing node (and updating slot)
+     * @details Shrink thresholds sit below the grow thresholds so a node never flaps.
+     */
+    void remove_child(Ref& slot, Node* node, uint8_t b) {
+        switch (node->type) {
+        case NodeType::N4: {
+            auto* n = static_cast<Node4*>(node);
+            remove_sorted(n, b);
+            if (n->count > 1)
+                return;
+            // One child left: fold this node's path into it
+            Ref only = n->children[0];
+            if (!is_leaf(only)) {
+                Node* child = as_node(only);
+                uint8_t prefix[kKeyBytes];
+                int len = 0;
+                std::memcpy(prefix, n->prefix, n->prefix_len);
+                len += n->prefix_len;
+                prefix[len++] = n->keys[0];
+                std::memcpy(prefix + len, child->prefix, child->prefix_len);
+                len += child->prefix_len;
+                std::memcpy(child->prefix, prefix, len);
+                child->prefix_len = static_cast<uint8_t>(len);
+            }
+            free_node(n);
+            slot = only;
+            return;
+        }
+        case NodeType::N16: {
+            auto* n = static_cast<Node16*>(node);
+            remove_sorted(n, b);
+            if (n->count > 3)
+                return;
+            auto* shrunk = make<Node4>();
+            copy_header(shrunk, n);
+            std::memcpy(shrunk->keys, n->keys, n->count);
+            std::memcpy(shrunk->children, n->children, n->count * sizeof(Ref));
+            free_node(n);
+            slot = ref_of(shrunk);
+            return;
+        }
+        case NodeType::N48: {
+            auto* n = static_cast<Node48*>(node);
+            n->children[n->index[b] - 1] = 0;
+            n->index[b] = 0;
+            if (--n->count > 12)
+                return;
+            auto* shrunk = make<Node16>();
+            copy_header(shrunk, n);
+            int pos = 0;
+            for (unsigned k = 0; k < 256; ++k) {
+                if (n->index[k]) {
+                    shrunk->keys[pos] = static_cast<uint8_t>(k);
+                    shrunk->children[pos++] = n->children[n->index[k] - 1];
+                }
+            }
+            free_node(n);
+            slot = ref_of(shrunk);
+            return;
+        }
+        case NodeType::N256: {
+            auto* n = static_cast<Node256*>(node);
+            n->children[b] = 0;
+            if (--n->count > 37)
+                return;
+            auto* shrunk = make<Node48>();
+            copy_header(shrunk, n);
+            int pos = 0;
+            for (unsigned k = 0; k < 256; ++k) {
+                if (n->children[k]) {
+                    shrunk->index[k] = static_cast<uint8_t>(pos + 1);
+                    shrunk->children[pos++] = n->children[k];
+                }
+            }
+            free_node(n);
+            slot = ref_of(shrunk);
+            return;
+        }
+        }
+    }
+
+    std::optional<time_t> erase_from(Ref& slot, uint64_t key, int depth) {
+        Ref ref = slot;
+        if (!ref)
+            return std::nullopt;
+        if (is_leaf(ref)) {  // only reached for a single-entry tree
+            Leaf* leaf = as_leaf(ref);
+            if (leaf->key != key)
+                return std::nullopt;
+            time_t erased = leaf->ts;
+            free_node(leaf);
+            slot = 0;
+            return erased;
+        }
+
+        Node* node = as_node(ref);
+        if (prefix_match(node, key, depth) != node->prefix_len)
+            return std::nullopt;
+        depth += node->prefix_len;
+        uint8_t b = byte_at(key, depth);
+        Ref* child = find_child(node, b);
+        if (!child)
+            return std::nullopt;
+        if (!is_leaf(*child))
+            return erase_from(*child, key, depth + 1);
+        Leaf* leaf = as_leaf(*child);
+        if (leaf->key != key)
+            return std::nullopt;
+        time_t erased = leaf->ts;
+        free_node(leaf);
+        remove_child(slot, node, b);
+        return erased;
+    }
+
+    /**
+     * @brief In-order walk of keys >= from
+     * @param bounded true while the path so far equals the leading bytes of from
+     * @return false if fn stopped the walk
+     */
+    template <typename Fn>
+    static bool scan_from(Ref ref, uint64_t from, int depth, bool bounded, Fn& fn) {
+        if (is_leaf(ref)) {
+            const Leaf* leaf = as_leaf(ref);
+            return (bounded && leaf->key < from) || fn(leaf->key, leaf->ts);
+        }
+
+        const Node* node = as_node(ref);
+        for (int i = 0; bounded && i < node->prefix_len; ++i) {
+            uint8_t want = byte_at(from, depth + i);
+            if (node->prefix[i] < want)
+                return true;  // whole subtree sorts below from
+            if (node->prefix[i] > want)
+                bounded = false;  // whole subtree sorts above from
+        }
+        depth += node->prefix_len;
+        uint8_t start = bounded ? byte_at(from, depth) : 0;
+        return for_each_child(node, start, [&](uint8_t b, Ref child) {
+            return scan_from(child, from, depth + 1, bounded && b == start, fn);
+        });
+    }
+};
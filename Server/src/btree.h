@@ -0,0 +1,605 @@
+// btree.h
+#pragma once
+
+#include "node_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief In-memory B+tree with wide, cache-line-aligned nodes and linked leaves
+ *
+ * @details Drop-in replacement for the subset of std::map used by the server: keys are
+ *          unique and kept sorted, try_emplace/erase/find/lower_bound behave like their
+ *          std::map counterparts. Each node packs dozens of keys into a few cache lines and
+ *          leaves keep keys and values in separate arrays, so a lookup only touches the key
+ *          array. Leaves are chained in key order, turning a full traversal into a
+ *          sequential walk over leaves instead of a pointer chase per element.
+ *
+ *          Nodes come from a per-tree NodePool, so inserts and erases recycle node memory
+ *          without touching the global allocator, and clear() hands whole slabs back at once.
+ *
+ *          Inner nodes also count the elements under each child, which makes the tree an
+ *          order-statistic tree: rank() and select() descend once, in O(log n).
+ *
+ * @note Not thread-safe; callers provide their own synchronization.
+ * @note Iterators are invalidated by any insert or erase.
+ */
+template <typename Key, typename Value, std::size_t NodeBytes = 512>
+class BPlusTree {
+    static constexpr std::size_t kCacheLine = 64;
+
+    struct Node {
+        uint16_t count;  // keys stored in this node
+        bool leaf;
+    };
+
+    static constexpr std::size_t kHeaderBytes = 32;  // Node fields plus the leaf sibling links
+    static constexpr std::size_t kLeafCap = (NodeBytes - kHeaderBytes) / (sizeof(Key) + sizeof(Value));
+    static constexpr std::size_t kInnerCap =
+        (NodeBytes - kHeaderBytes - sizeof(std::size_t)) / (sizeof(Key) + sizeof(Node*) + sizeof(std::size_t));
+    static_assert(kLeafCap >= 4 && kInnerCap >= 4, "NodeBytes too small for Key/Value");
+
+    struct alignas(kCacheLine) Leaf : Node {
+        Leaf* prev;
+        Leaf* next;
+        Key keys[kLeafCap];
+        Value values[kLeafCap];
+    };
+
+    struct alignas(kCacheLine) Inner : Node {
+        Key keys[kInnerCap];            // keys[i] is the smallest key reachable through children[i + 1]
+        Node* children[kInnerCap + 1];
+        std::size_t sizes[kInnerCap + 1];  // elements under children[i]
+    };
+
+    struct Split {
+        Key key{};
+        Node* right = nullptr;
+    };
+
+public:
+    class iterator {
+    public:
+        iterator() = default;
+
+        const Key& key() const { return leaf_->keys[pos_]; }
+        Value& value() const { return leaf_->values[pos_]; }
+        std::pair<const Key&, Value&> operator*() const { return {leaf_->keys[pos_], leaf_->values[pos_]}; }
+
+        iterator& operator++() {
+            if (++pos_ == leaf_->count) {
+                leaf_ = leaf_->next;
+                pos_ = 0;
+            }
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const { return leaf_ == other.leaf_ && pos_ == other.pos_; }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class BPlusTree;
+        iterator(Leaf* leaf, unsigned pos) : leaf_(leaf), pos_(pos) {}
+
+        Leaf* leaf_ = nullptr;
+        unsigned pos_ = 0;
+    };
+
+    BPlusTree() = default;
+    ~BPlusTree() { clear(); }
+
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    BPlusTree(BPlusTree&& other) noexcept { swap(other); }
+    BPlusTree& operator=(BPlusTree&& other) noexcept {
+        if (this != &other) {
+            clear();
+            swap(other);
+        }
+        return *this;
+    }
+
+    void swap(BPlusTree& other) noexcept {
+        std::swap(root_, other.root_);
+        std::swap(first_, other.first_);
+        std::swap(last_, other.last_);
+        std::swap(size_, other.size_);
+        pool_.swap(other.pool_);
+    }
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    iterator begin() const { return size_ ? iterator(first_, 0) : end(); }
+    iterator end() const { return iterator(); }
+
+    /**
+     * @brief Iterator to the largest element, or end() when empty
+     */
+    iterator last() const { return size_ ? iterator(last_, last_->count - 1u) : end(); }
+
+    /**
+     * @brief Insert key -> value unless the key already exists
+     * @param key Key to insert
+     * @param value Value stored when the key is new
+     * @return Iterator to the (new or existing) element and whether an insertion happened
+     */
+    std::pair<iterator, bool> try_emplace(const Key& key, const Value& value) {
+        if (!root_) {
+            Leaf* leaf = new_leaf();
+            root_ = first_ = last_ = leaf;
+        }
+
+        Leaf* where = nullptr;
+        unsigned at = 0;
+        Split split;
+        bool inserted = insert_into(root_, key, value, where, at, split);
+
+        if (split.right) {
+            Inner* root = new_inner();
+            root->count = 1;
+            root->keys[0] = split.key;
+            root->children[0] = root_;
+            root->children[1] = split.right;
+            root->sizes[0] = weight(root_);
+            root->sizes[1] = weight(split.right);
+            root_ = root;
+        }
+        if (inserted)
+            ++size_;
+        return {iterator(where, at), inserted};
+    }
+
+    /**
+     * @brief Remove a key if present
+     * @param key Key to remove
+     * @param erased Receives the removed value when not null
+     * @return Number of elements removed (0 or 1)
+     */
+    std::size_t erase(const Key& key, Value* erased = nullptr) {
+        if (!root_ || !erase_from(root_, key, erased))
+            return 0;
+
+        --size_;
+        if (root_->leaf) {
+            if (root_->count == 0) {
+                free_node(static_cast<Leaf*>(root_));
+                root_ = first_ = last_ = nullptr;
+            }
+        } else if (root_->count == 0) {
+            Inner* old = static_cast<Inner*>(root_);
+            root_ = old->children[0];
+            free_node(old);
+        }
+        return 1;
+    }
+
+    /**
+     * @brief Locate a key
+     * @param key Key to search for
+     * @return Iterator to the element, or end() when absent
+     */
+    iterator find(const Key& key) const {
+        iterator it = lower_bound(key);
+        return (it != end() && !(key < it.key())) ? it : end();
+    }
+
+    /**
+     * @brief First element whose key is not less than the given key
+     * @param key Lower bound
+     * @return Iterator to the element, or end() when every key is smaller
+     */
+    iterator lower_bound(const Key& key) const {
+        if (!root_)
+            return end();
+
+        const Leaf* leaf = descend(key);
+        unsigned pos = static_cast<unsigned>(std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys);
+        if (pos == leaf->count)
+            return leaf->next ? iterator(leaf->next, 0) : end();
+        return iterator(const_cast<Leaf*>(leaf), pos);
+    }
+
+    /**
+     * @brief Number of elements whose key is less than the given key, in O(log n)
+     * @param key Any key, stored or not
+     */
+    std::size_t rank(const Key& key) const {
+        if (!root_)
+            return 0;
+        std::size_t below = 0;
+        const Node* node = root_;
+        while (!node->leaf) {
+            const Inner* inner = static_cast<const Inner*>(node);
+            unsigned c = child_index(inner, key);
+            for (unsigned i = 0; i < c; ++i)
+                below += inner->sizes[i];
+            node = inner->children[c];
+        }
+        const Leaf* leaf = static_cast<const Leaf*>(node);
+        return below + static_cast<std::size_t>(std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys);
+    }
+
+    /**
+     * @brief Element at a position in key order, in O(log n)
+     * @param k Position, 0 for the smallest key
+     * @return Iterator to the element, or end() when k >= size()
+     */
+    iterator select(std::size_t k) const {
+        if (k >= size_)
+            return end();
+        const Node* node = root_;
+        while (!node->leaf) {
+            const Inner* inner = static_cast<const Inner*>(node);
+            unsigned c = 0;
+            for (; k >= inner->sizes[c]; ++c)
+                k -= inner->sizes[c];
+            node = inner->children[c];
+        }
+        return iterator(const_cast<Leaf*>(static_cast<const Leaf*>(node)), static_cast<unsigned>(k));
+    }
+
+    /**
+     * @brief Visit elements with key >= from one leaf at a time, as parallel key and value arrays
+     * @details Each call hands over a contiguous run of keys and the matching run of values,
+     *          so a caller interested in one column streams it without touching the other.
+     * @param from Lower bound
+     * @param fn Callable fn(const Key* keys, const Value* values, size_t n) returning false to stop
+     */
+    template <typename Fn>
+    void scan_spans(const Key& from, Fn&& fn) const {
+        if (!root_)
+            return;
+        const Leaf* leaf = descend(from);
+        unsigned pos = static_cast<unsigned>(std::lower_bound(leaf->keys, leaf->keys + leaf->count, from) - leaf->keys);
+        for (; leaf; leaf = leaf->next, pos = 0)
+            if (pos < leaf->count && !fn(leaf->keys + pos, leaf->values + pos, std::size_t{leaf->count} - pos))
+                return;
+    }
+
+    /**
+     * @brief Remove every element and release all nodes
+     */
+    void clear() {
+        // Trivial nodes need no per-node teardown: dropping the slabs frees them all
+        if (root_ && !(std::is_trivially_destructible_v<Key> && std::is_trivially_destructible_v<Value>))
+            destroy(root_);
+        pool_.release();
+        root_ = first_ = last_ = nullptr;
+        size_ = 0;
+    }
+
+    /**
+     * @brief Free about `bytes` of a retired tree's memory (see Reclaimer)
+     * @details The tree reads as empty after the first call and must only be released
+     *          further or destroyed.
+     * @return true once every node is gone
+     */
+    bool release_some(std::size_t bytes) {
+        if (root_ && !(std::is_trivially_destructible_v<Key> && std::is_trivially_destructible_v<Value>))
+            destroy(root_);
+        root_ = first_ = last_ = nullptr;
+        size_ = 0;
+        return pool_.release_some(bytes) < bytes;
+    }
+
+    /**
+     * @brief Node memory held by this tree
+     */
+    PoolStats allocator_stats() const { return pool_.stats(); }
+
+private:
+    Node* root_ = nullptr;
+    Leaf* first_ = nullptr;  // leftmost leaf, start of the in-order chain
+    Leaf* last_ = nullptr;   // rightmost leaf
+    std::size_t size_ = 0;
+    NodePool pool_{std::max(sizeof(Leaf), sizeof(Inner)), kCacheLine};
+
+    static constexpr unsigned kLeafMin = kLeafCap / 2;
+    static constexpr unsigned kInnerMin = kInnerCap / 2;
+
+    Leaf* new_leaf() {
+        Leaf* leaf = new (pool_.allocate()) Leaf;
+        leaf->count = 0;
+        leaf->leaf = true;
+        leaf->prev = leaf->next = nullptr;
+        return leaf;
+    }
+
+    Inner* new_inner() {
+        Inner* inner = new (pool_.allocate()) Inner;
+        inner->count = 0;
+        inner->leaf = false;
+        return inner;
+    }
+
+    static unsigned child_index(const Inner* inner, const Key& key) {
+        return static_cast<unsigned>(std::upper_bound(inner->keys, inner->keys + inner->count, key) - inner->keys);
+    }
+
+    const Leaf* descend(const Key& key) const {
+        const Node* node = root_;
+        while (!node->leaf) {
+            const Inner* inner = static_cast<const Inner*>(node);
+            node = inner->children[child_index(inner, key)];
+        }
+        return static_cast<const Leaf*>(node);
+    }
+
+    /**
+     * @brief Elements under a node, summed from its child counts (only needed on splits and merges)
+     */
+    static std::size_t weight(const Node* node) {
+        if (node->leaf)
+            return node->count;
+        const Inner* inner = static_cast<const Inner*>(node);
+        std::size_t total = 0;
+        for (unsigned i = 0; i <= inner->count; ++i)
+            total += inner->sizes[i];
+        return total;
+    }
+
+    template <typename T>
+    void free_node(T* node) {
+        node->~T();
+        pool_.deallocate(node);
+    }
+
+    void destroy(Node* node) {
+        if (node->leaf) {
+            free_node(static_cast<Leaf*>(node));
+            return;
+        }
+        Inner* inner = static_cast<Inner*>(node);
+        for (unsigned i = 0; i <= inner->count; ++i)
+            destroy(inner->children[i]);
+        free_node(inner);
+    }
+
+    bool insert_into(Node* node, const Key& key, const Value& value, Leaf*& where, unsigned& at, Split& split) {
+        if (node->leaf)
+            return insert_into_leaf(static_cast<Leaf*>(node), key, value, where, at, split);
+
+        Inner* inner = static_cast<Inner*>(node);
+        unsigned c = child_index(inner, key);
+        Split child_split;
+        bool inserted = insert_into(inner->children[c], key, value, where, at, child_split);
+        if (child_split.right) {
+            inner->sizes[c] = weight(inner->children[c]);
+            insert_child(inner, c, child_split, split);
+        } else if (inserted) {
+            ++inner->sizes[c];
+        }
+        return inserted;
+    }
+
+    bool insert_into_leaf(Leaf* leaf, const Key& key, const Value& value, Leaf*& where, unsigned& at, Split& split) {
+        unsigned pos = static_cast<unsigned>(std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys);
+        if (pos < leaf->count && !(key < leaf->keys[pos])) {
+            where = leaf;
+            at = pos;
+            return false;
+        }
+
+        if (leaf->count == kLeafCap) {
+            // Move the upper half into a new right sibling, then insert into whichever half owns the key
+            constexpr unsigned half = (kLeafCap + 1) / 2;
+            Leaf* right = new_leaf();
+            right->count = static_cast<uint16_t>(kLeafCap - half);
+            std::copy(leaf->keys + half, leaf->keys + kLeafCap, right->keys);
+            std::copy(leaf->values + half, leaf->values + kLeafCap, right->values);
+            leaf->count = half;
+
+            right->prev = leaf;
+            right->next = leaf->next;
+            if (leaf->next)
+                leaf->next->prev = right;
+            else
+                last_ = right;
+            leaf->next = right;
+
+            split.key = right->keys[0];
+            split.right = right;
+
+            if (pos > half) {
+                leaf = right;
+                pos -= half;
+            }
+        }
+
+        std::copy_backward(leaf->keys + pos, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+        std::copy_backward(leaf->values + pos, leaf->values + leaf->count, leaf->values + leaf->count + 1);
+        leaf->keys[pos] = key;
+        leaf->values[pos] = value;
+        ++leaf->count;
+
+        where = leaf;
+        at = pos;
+        return true;
+    }
+
+    /**
+     * @brief Add the right half of a split child at position c + 1, splitting this node if full
+     */
+    void insert_child(Inner* inner, unsigned c, const Split& child, Split& split) {
+        std::size_t right_size = weight(child.right);
+        if (inner->count < kInnerCap) {
+            std::copy_backward(inner->keys + c, inner->keys + inner->count, inner->keys + inner->count + 1);
+            std::copy_backward(inner->children + c + 1, inner->children + inner->count + 1,
+                               inner->children + inner->count + 2);
+            std::copy_backward(inner->sizes + c + 1, inner->sizes + inner->count + 1, inner->sizes + inner->count + 2);
+            inner->keys[c] = child.key;
+            inner->children[c + 1] = child.right;
+            inner->sizes[c + 1] = right_size;
+            ++inner->count;
+            return;
+        }
+
+        // Full: lay out the kInnerCap + 1 keys in scratch space and cut around the middle key
+        Key keys[kInnerCap + 1];
+        Node* children[kInnerCap + 2];
+        std::size_t sizes[kInnerCap + 2];
+        std::copy(inner->keys, inner->keys + c, keys);
+        keys[c] = child.key;
+        std::copy(inner->keys + c, inner->keys + kInnerCap, keys + c + 1);
+        std::copy(inner->children, inner->children + c + 1, children);
+        children[c + 1] = child.right;
+        std::copy(inner->children + c + 1, inner->children + kInnerCap + 1, children + c + 2);
+        std::copy(inner->sizes, inner->sizes + c + 1, sizes);
+        sizes[c + 1] = right_size;
+        std::copy(inner->sizes + c + 1, inner->sizes + kInnerCap + 1, sizes + c + 2);
+
+        constexpr unsigned mid = (kInnerCap + 1) / 2;
+        Inner* right = new_inner();
+        inner->count = mid;
+        std::copy(keys, keys + mid, inner->keys);
+        std::copy(children, children + mid + 1, inner->children);
+        std::copy(sizes, sizes + mid + 1, inner->sizes);
+
+        right->count = static_cast<uint16_t>(kInnerCap - mid);
+        std::copy(keys + mid + 1, keys + kInnerCap + 1, right->keys);
+        std::copy(children + mid + 1, children + kInnerCap + 2, right->children);
+        std::copy(sizes + mid + 1, sizes + kInnerCap + 2, right->sizes);
+
+        split.key = keys[mid];
+        split.right = right;
+    }
+
+    bool erase_from(Node* node, const Key& key, Value* erased) {
+        if (node->leaf) {
+            Leaf* leaf = static_cast<Leaf*>(node);
+            unsigned pos = static_cast<unsigned>(std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys);
+            if (pos == leaf->count || key < leaf->keys[pos])
+                return false;
+            if (erased)
+                *erased = leaf->values[pos];
+            std::copy(leaf->keys + pos + 1, leaf->keys + leaf->count, leaf->keys + pos);
+            std::copy(leaf->values + pos + 1, leaf->values + leaf->count, leaf->values + pos);
+            --leaf->count;
+            return true;
+        }
+
+        Inner* inner = static_cast<Inner*>(node);
+        unsigned c = child_index(inner, key);
+        if (!erase_from(inner->children[c], key, erased))
+            return false;
+        --inner->sizes[c];
+
+        Node* child = inner->children[c];
+        if (child->count < (child->leaf ? kLeafMin : kInnerMin))
+            rebalance(inner, c);
+        return true;
+    }
+
+    /**
+     * @brief Restore the minimum fill of children[c] by merging with or borrowing from a sibling
+     */
+    void rebalance(Inner* parent, unsigned c) {
+        unsigned l = c > 0 ? c - 1 : c;  // separator parent->keys[l] sits between children l and l + 1
+        Node* left = parent->children[l];
+        Node* right = parent->children[l + 1];
+
+        if (left->leaf) {
+            Leaf* a = static_cast<Leaf*>(left);
+            Leaf* b = static_cast<Leaf*>(right);
+            unsigned total = a->count + b->count;
+            if (total <= kLeafCap) {
+                merge_leaves(a, b);
+                parent->sizes[l] = total;
+                remove_separator(parent, l);
+                return;
+            }
+            // Redistribute so both halves are at least half full
+            unsigned want_left = total / 2;
+            if (a->count > want_left) {
+                unsigned move = a->count - want_left;
+                std::copy_backward(b->keys, b->keys + b->count, b->keys + b->count + move);
+                std::copy_backward(b->values, b->values + b->count, b->values + b->count + move);
+                std::copy(a->keys + want_left, a->keys + a->count, b->keys);
+                std::copy(a->values + want_left, a->values + a->count, b->values);
+                a->count = static_cast<uint16_t>(want_left);
+                b->count = static_cast<uint16_t>(b->count + move);
+            } else {
+                unsigned move = want_left - a->count;
+                std::copy(b->keys, b->keys + move, a->keys + a->count);
+                std::copy(b->values, b->values + move, a->values + a->count);
+                std::copy(b->keys + move, b->keys + b->count, b->keys);
+                std::copy(b->values + move, b->values + b->count, b->values);
+                a->count = static_cast<uint16_t>(want_left);
+                b->count = static_cast<uint16_t>(b->count - move);
+            }
+            parent->keys[l] = b->keys[0];
+            parent->sizes[l] = a->count;
+            parent->sizes[l + 1] = b->count;
+            return;
+        }
+
+        Inner* a = static_cast<Inner*>(left);
+        Inner* b = static_cast<Inner*>(right);
+        unsigned total = a->count + 1u + b->count;  // keys including the separator pulled down
+        if (total <= kInnerCap) {
+            a->keys[a->count] = parent->keys[l];
+            std::copy(b->keys, b->keys + b->count, a->keys + a->count + 1);
+            std::copy(b->children, b->children + b->count + 1, a->children + a->count + 1);
+            std::copy(b->sizes, b->sizes + b->count + 1, a->sizes + a->count + 1);
+            a->count = static_cast<uint16_t>(total);
+            free_node(b);
+            parent->sizes[l] += parent->sizes[l + 1];
+            remove_separator(parent, l);
+            return;
+        }
+
+        // Rotate through the parent: concatenate, then cut around the new middle separator
+        Key keys[2 * kInnerCap + 1];
+        Node* children[2 * kInnerCap + 2];
+        std::size_t sizes[2 * kInnerCap + 2];
+        std::copy(a->keys, a->keys + a->count, keys);
+        keys[a->count] = parent->keys[l];
+        std::copy(b->keys, b->keys + b->count, keys + a->count + 1);
+        std::copy(a->children, a->children + a->count + 1, children);
+        std::copy(b->children, b->children + b->count + 1, children + a->count + 1);
+        std::copy(a->sizes, a->sizes + a->count + 1, sizes);
+        std::copy(b->sizes, b->sizes + b->count + 1, sizes + a->count + 1);
+
+        unsigned mid = total / 2;
+        a->count = static_cast<uint16_t>(mid);
+        std::copy(keys, keys + mid, a->keys);
+        std::copy(children, children + mid + 1, a->children);
+        std::copy(sizes, sizes + mid + 1, a->sizes);
+        b->count = static_cast<uint16_t>(total - mid - 1);
+        std::copy(keys + mid + 1, keys + total, b->keys);
+        std::copy(children + mid + 1, children + total + 1, b->children);
+        std::copy(sizes + mid + 1, sizes + total + 1, b->sizes);
+        parent->keys[l] = keys[mid];
+        parent->sizes[l] = weight(a);
+        parent->sizes[l + 1] = weight(b);
+    }
+
+    void merge_leaves(Leaf* a, Leaf* b) {
+        std::copy(b->keys, b->keys + b->count, a->keys + a->count);
+        std::copy(b->values, b->values + b->count, a->values + a->count);
+        a->count = static_cast<uint16_t>(a->count + b->count);
+        a->next = b->next;
+        if (b->next)
+            b->next->prev = a;
+        else
+            last_ = a;
+        free_node(b);
+    }
+
+    /**
+     * @brief Drop separator l and the child to its right after that child was merged away
+     */
+    static void remove_separator(Inner* parent, unsigned l) {
+        std::copy(parent->keys + l + 1, parent->keys + parent->count, parent->keys + l);
+        std::copy(parent->children + l + 2, parent->children + parent->count + 1, parent->children + l + 1);
+        std::copy(parent->sizes + l + 2, parent->sizes + parent->count + 1, parent->sizes + l + 1);
+        --parent->count;
+    }
+};
@@ -0,0 +1,103 @@
+// btree_index.h
+#pragma once
+
+#include "btree.h"
+#include "node_pool.h"
+#include "number_store.h"
+#include "timestamp_codec.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <optional>
+#include <utility>
+
+/**
+ * @brief Shard index backed by the cache-friendly B+tree (the default backend)
+ *
+ * @details Index interface expected by ShardedStore: insert, erase (returning the removed
+ *          timestamp), find, first and last (smallest and largest number), size, clear and
+ *          an ordered scan(from, fn) where fn(number, timestamp) returns false to stop, plus
+ *          allocator_stats() describing the memory behind the index. find, size and
+ *          allocator_stats must be safe to run concurrently with each other (they run under
+ *          a shared shard lock). Indexes may add rank and select (order statistics, also run
+ *          under a shared lock); this one answers both in O(log n).
+ *
+ *          Storage is columnar: every leaf holds a sorted number column and a separate
+ *          column of 32-bit timestamp offsets (TimestampCodec), which fits a third more
+ *          entries per node than full time_t values. scan_numbers() streams the number
+ *          column alone, one contiguous leaf span at a time.
+ */
+class BtreeIndex {
+public:
+    std::pair<time_t, bool> insert(uint64_t number, time_t ts) {
+        auto [it, inserted] = tree_.try_emplace(number, TimestampCodec::encode(ts));
+        return {TimestampCodec::decode(it.value()), inserted};
+    }
+
+    std::optional<time_t> erase(uint64_t number) {
+        uint32_t offset;
+        if (!tree_.erase(number, &offset))
+            return std::nullopt;
+        return TimestampCodec::decode(offset);
+    }
+
+    std::optional<time_t> find(uint64_t number) const {
+        auto it = tree_.find(number);
+        if (it == tree_.end())
+            return std::nullopt;
+        return TimestampCodec::decode(it.value());
+    }
+
+    std::optional<uint64_t> first() const {
+        auto it = tree_.begin();
+        return it == tree_.end() ? std::nullopt : std::optional<uint64_t>(it.key());
+    }
+
+    std::optional<uint64_t> last() const {
+        auto it = tree_.last();
+        return it == tree_.end() ? std::nullopt : std::optional<uint64_t>(it.key());
+    }
+
+    template <typename Fn>
+    void scan(uint64_t from, Fn&& fn) const {
+        tree_.scan_spans(from, [&](const uint64_t* numbers, const uint32_t* offsets, size_t n) {
+            for (size_t i = 0; i < n; ++i)
+                if (!fn(numbers[i], TimestampCodec::decode(offsets[i])))
+                    return false;
+            return true;
+        });
+    }
+
+    /**
+     * @brief Visit numbers >= from as contiguous sorted spans, without touching timestamps
+     * @param fn Callable fn(const uint64_t* numbers, size_t n) returning false to stop
+     */
+    template <typename Fn>
+    void scan_numbers(uint64_t from, Fn&& fn) const {
+        tree_.scan_spans(from, [&](const uint64_t* numbers, const uint32_t*, size_t n) { return fn(numbers, n); });
+    }
+
+    /**
+     * @brief Count of numbers below a number, from the tree's subtree counts
+     */
+    size_t rank(uint64_t number) const { return tree_.rank(number); }
+
+    /**
+     * @brief Entry at a position in number order (0 = smallest), or nullopt past the end
+     */
+    std::optional<StoreEntry> select(size_t k) const {
+        auto it = tree_.select(k);
+        if (it == tree_.end())
+            return std::nullopt;
+        return StoreEntry{it.key(), TimestampCodec::decode(it.value())};
+    }
+
+    size_t size() const { return tree_.size(); }
+    void clear() { tree_.clear(); }
+    bool release_some(size_t bytes) { return tree_.release_some(bytes); }
+    PoolStats allocator_stats() const { return tree_.allocator_stats(); }
+
+private:
+    BPlusTree<uint64_t, uint32_t> tree_;  // number -> TimestampCodec offset
+};
@@ -0,0 +1,82 @@
+// bulk_ingest.cpp
+#include "bulk_ingest.h"
+
+#include <algorithm>
+#include <ctime>
+#include <utility>
+
+void BulkIngest::Queue::push(std::vector<uint64_t> chunk) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return chunks_.size() < kQueueDepth; });
+    chunks_.push_back(std::move(chunk));
+    changed_.notify_all();
+}
+
+bool BulkIngest::Queue::pop(std::vector<uint64_t>& chunk) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return !chunks_.empty() || closed_; });
+    if (chunks_.empty())
+        return false;
+    chunk = std::move(chunks_.front());
+    chunks_.pop_front();
+    changed_.notify_all();
+    return true;
+}
+
+void BulkIngest::Queue::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    changed_.notify_all();
+}
+
+BulkIngest::BulkIngest(NumberStore& store, std::function<void()> commit)
+    : store_(store), commit_(std::move(commit)) {
+    sorter_ = std::thread(&BulkIngest::sort_stage, this);
+    merger_ = std::thread(&BulkIngest::merge_stage, this);
+}
+
+BulkIngest::~BulkIngest() {
+    finish();
+}
+
+void BulkIngest::push(std::vector<uint64_t> numbers) {
+    ++result_.chunks;
+    result_.received += numbers.size();
+    to_sort_.push(std::move(numbers));
+}
+
+BulkIngestResult BulkIngest::finish() {
+    if (!finished_) {
+        finished_ = true;
+        to_sort_.close();
+        sorter_.join();
+        merger_.join();
+    }
+    return result_;
+}
+
+void BulkIngest::sort_stage() {
+    std::vector<uint64_t> chunk;
+    while (to_sort_.pop(chunk)) {
+        size_t size = chunk.size();
+        chunk.erase(std::remove(chunk.begin(), chunk.end(), 0), chunk.end());
+        result_.rejected += size - chunk.size();
+        std::sort(chunk.begin(), chunk.end());
+        chunk.erase(std::unique(chunk.begin(), chunk.end()), chunk.end());
+        if (!chunk.empty())
+            to_merge_.push(std::move(chunk));
+        chunk.clear();
+    }
+    to_merge_.close();
+}
+
+void BulkIngest::merge_stage() {
+    std::vector<uint64_t> chunk;
+    std::vector<uint8_t> outcomes;
+    while (to_merge_.pop(chunk)) {
+        outcomes.resize((chunk.size() + 7) / 8);
+        result_.inserted += store_.insert_batch(chunk.data(), chunk.size(), time(nullptr), outcomes.data());
+    }
+    if (commit_)
+        commit_();
+}
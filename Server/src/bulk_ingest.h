@@ -0,0 +1,102 @@
+// bulk_ingest.h
+#pragma once
+
+#include "number_store.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Totals of one bulk ingest
+ */
+struct BulkIngestResult {
+    uint64_t chunks = 0;    // chunks pushed
+    uint64_t received = 0;  // numbers pushed, zeros and duplicates included
+    uint64_t rejected = 0;  // zeros, which are not valid numbers
+    uint64_t inserted = 0;  // numbers that were new to the store
+};
+
+/**
+ * @brief Three-stage pipeline that merges a stream of number chunks into a store
+ *
+ * @details The producer (the RPC thread reading the stream) decodes each chunk and push()es
+ *          it. A sort stage drops zeros, sorts the chunk and removes duplicates; a merge
+ *          stage applies the sorted chunk with NumberStore::insert_batch, which then takes
+ *          each shard lock once for a contiguous run. Receiving, sorting and merging run on
+ *          different threads and overlap, so a bulk load is bound by the slowest stage
+ *          instead of the sum of all three. Each stage hands over through a queue of at
+ *          most kQueueDepth chunks, so memory stays bounded and push() blocks (and with it
+ *          the stream's flow control) while the store falls behind.
+ *
+ *          Every chunk is stamped with the time it is merged. The commit callback runs on
+ *          the merge thread after the last chunk, which is the thread that appended the
+ *          log records (WriteAheadLog::commit waits for the calling thread's records).
+ *
+ * @note push() and finish() must be called from one thread.
+ */
+class BulkIngest {
+public:
+    static constexpr size_t kQueueDepth = 4;
+
+    /**
+     * @brief Start the sort and merge stages
+     * @param store Store to insert into
+     * @param commit Called on the merge thread once everything is applied, or empty
+     */
+    BulkIngest(NumberStore& store, std::function<void()> commit);
+
+    /**
+     * @brief Finish (applying whatever was pushed) if finish() was not called
+     */
+    ~BulkIngest();
+
+    BulkIngest(const BulkIngest&) = delete;
+    BulkIngest& operator=(const BulkIngest&) = delete;
+
+    /**
+     * @brief Hand over one chunk; blocks while the sort stage is kQueueDepth chunks behind
+     * @param numbers Numbers in any order, duplicates and zeros allowed
+     */
+    void push(std::vector<uint64_t> numbers);
+
+    /**
+     * @brief Wait until every pushed chunk is applied and committed
+     * @return Totals of the whole ingest
+     */
+    BulkIngestResult finish();
+
+private:
+    /**
+     * @brief Bounded single-producer, single-consumer hand-over between two stages
+     */
+    class Queue {
+    public:
+        void push(std::vector<uint64_t> chunk);
+        bool pop(std::vector<uint64_t>& chunk);  // false once closed and drained
+        void close();
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable changed_;
+        std::deque<std::vector<uint64_t>> chunks_;
+        bool closed_ = false;
+    };
+
+    NumberStore& store_;
+    std::function<void()> commit_;
+    Queue to_sort_;
+    Queue to_merge_;
+    BulkIngestResult result_;  // chunks and received: producer; rejected: sort; inserted: merge
+    bool finished_ = false;
+    std::thread sorter_;
+    std::thread merger_;
+
+    void sort_stage();
+    void merge_stage();
+};
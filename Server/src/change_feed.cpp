@@ -0,0 +1,117 @@
+// change_feed.cpp
+#include "change_feed.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+
+namespace {
+
+size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+uint64_t make_feed_id() {
+    std::random_device random;
+    uint64_t id = (uint64_t{random()} << 32) ^ random() ^
+                  static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    return id ? id : 1;  // 0 means "no feed" to clients
+}
+
+}  // namespace
+
+ChangeFeed::ChangeFeed(size_t capacity, MutationObserver* next)
+    : next_observer_(next),
+      id_(make_feed_id()),
+      mask_(round_up_pow2(std::max<size_t>(capacity, 2)) - 1),
+      slots_(new Slot[mask_ + 1]) {}
+
+void ChangeFeed::on_insert(uint64_t number, time_t ts) {
+    if (next_observer_)
+        next_observer_->on_insert(number, ts);
+    publish(ChangeEvent::Kind::Insert, number, number, ts);
+}
+
+void ChangeFeed::on_erase(uint64_t number) {
+    if (next_observer_)
+        next_observer_->on_erase(number);
+    publish(ChangeEvent::Kind::Erase, number, number, 0);
+}
+
+void ChangeFeed::on_clear_range(uint64_t lo, uint64_t hi) {
+    if (next_observer_)
+        next_observer_->on_clear_range(lo, hi);
+    publish(ChangeEvent::Kind::ClearRange, lo, hi, 0);
+}
+
+void ChangeFeed::publish(ChangeEvent::Kind kind, uint64_t number, uint64_t last, time_t ts) {
+    uint64_t sequence = next_.fetch_add(1, std::memory_order_acq_rel) + 1;
+    Slot& slot = slots_[sequence & mask_];
+
+    // Claim the slot from the change capacity() before this one. A writer that far behind
+    // finds a newer stamp and drops its change: every reader still at it has been lapped.
+    uint64_t stamp = slot.stamp.load(std::memory_order_acquire);
+    for (;;) {
+        if (stamp >= 2 * sequence + 1)
+            return;
+        if (stamp & 1) {
+            std::this_thread::yield();  // the previous occupant is mid-write
+            stamp = slot.stamp.load(std::memory_order_acquire);
+            continue;
+        }
+        if (slot.stamp.compare_exchange_weak(stamp, 2 * sequence + 1, std::memory_order_acquire))
+            break;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.kind.store(static_cast<uint8_t>(kind), std::memory_order_relaxed);
+    slot.number.store(number, std::memory_order_relaxed);
+    slot.last.store(last, std::memory_order_relaxed);
+    slot.ts.store(static_cast<int64_t>(ts), std::memory_order_relaxed);
+    slot.stamp.store(2 * sequence + 2, std::memory_order_release);
+
+    // Pairs with the fence in wait(): either the sleeper sees this change, or we see the sleeper
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) != 0) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_.notify_all();
+    }
+}
+
+bool ChangeFeed::read(uint64_t after, std::vector<ChangeEvent>& out, size_t max) const {
+    uint64_t head = next_.load(std::memory_order_acquire);
+    if (head > after && head - after > capacity())
+        return false;
+    for (uint64_t sequence = after + 1; sequence <= head && max > 0; ++sequence, --max) {
+        const Slot& slot = slots_[sequence & mask_];
+        uint64_t want = 2 * sequence + 2;
+        uint64_t stamp = slot.stamp.load(std::memory_order_acquire);
+        if (stamp > want)
+            return false;  // overwritten by a later lap
+        if (stamp != want)
+            return true;  // not written yet; the caller waits for it
+        ChangeEvent event;
+        event.sequence = sequence;
+        event.kind = static_cast<ChangeEvent::Kind>(slot.kind.load(std::memory_order_relaxed));
+        event.number = slot.number.load(std::memory_order_relaxed);
+        event.last = slot.last.load(std::memory_order_relaxed);
+        event.ts = static_cast<time_t>(slot.ts.load(std::memory_order_relaxed));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.stamp.load(std::memory_order_relaxed) != want)
+            return false;  // overwritten while copying
+        out.push_back(event);
+    }
+    return true;
+}
+
+void ChangeFeed::wait(uint64_t after, std::chrono::milliseconds timeout) const {
+    const Slot& slot = slots_[(after + 1) & mask_];
+    auto published = [&] { return slot.stamp.load(std::memory_order_acquire) >= 2 * (after + 1) + 2; };
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    sleepers_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    wake_.wait_for(lock, timeout, published);
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,112 @@
+// change_feed.h
+#pragma once
+
+#include "number_store.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief One published mutation of the store
+ */
+struct ChangeEvent {
+    enum class Kind : uint8_t { Insert, Erase, ClearRange };
+
+    uint64_t sequence;  // position in the feed, starting at 1
+    Kind kind;
+    uint64_t number;    // inserted or erased number; first number of a cleared range
+    uint64_t last;      // ClearRange: last number of the range
+    time_t ts;          // Insert: stored timestamp
+};
+
+/**
+ * @brief Bounded in-memory history of store mutations, numbered in the order they happened
+ *
+ * @details Attached as the store's observer in front of the write-ahead log (which it
+ *          forwards every call to), the feed gives each mutation the next sequence number and
+ *          writes it into a ring of `capacity` slots, overwriting the oldest. Writers never
+ *          lock: a sequence comes from one atomic counter and each slot is guarded by its own
+ *          sequence stamp, odd while being written and 2 * sequence + 2 once complete. Readers
+ *          check the stamp before and after copying a slot, so they never see a torn event and
+ *          notice when the ring has lapped them. Because the store calls its observer while it
+ *          still serializes the key, sequence order matches the order of changes to any one
+ *          number.
+ *
+ *          Readers poll with read() and block in wait() until something newer is published.
+ *          Writers only touch the wake-up mutex while a reader is actually asleep.
+ */
+class ChangeFeed final : public MutationObserver {
+public:
+    /**
+     * @brief Create an empty feed
+     * @param capacity Changes kept for late readers; rounded up to a power of two
+     * @param next Observer every change is forwarded to first (the write-ahead log), or null
+     */
+    ChangeFeed(size_t capacity, MutationObserver* next);
+
+    ChangeFeed(const ChangeFeed&) = delete;
+    ChangeFeed& operator=(const ChangeFeed&) = delete;
+
+    void on_insert(uint64_t number, time_t ts) override;
+    void on_erase(uint64_t number) override;
+    void on_clear_range(uint64_t lo, uint64_t hi) override;
+
+    /**
+     * @brief Identifies this feed; sequences from another feed (an earlier run) are meaningless
+     */
+    uint64_t id() const { return id_; }
+
+    /**
+     * @brief Changes the ring holds
+     */
+    size_t capacity() const { return mask_ + 1; }
+
+    /**
+     * @brief Sequence of the latest change handed out, 0 before the first
+     * @details The change itself may still be being written; read() stops in front of it.
+     */
+    uint64_t head() const { return next_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Append the published changes after a sequence, in order
+     * @param after Last sequence the caller has seen
+     * @param out Receives up to max changes
+     * @param max Most changes to append
+     * @return false if the change after `after` has been overwritten (the caller lagged by
+     *         more than capacity() changes) and the history cannot be continued
+     */
+    bool read(uint64_t after, std::vector<ChangeEvent>& out, size_t max) const;
+
+    /**
+     * @brief Block until the change after `after` is published, or the timeout expires
+     */
+    void wait(uint64_t after, std::chrono::milliseconds timeout) const;
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> stamp{0};  // 2 * sequence + 1 while written, 2 * sequence + 2 once complete
+        std::atomic<uint8_t> kind{0};
+        std::atomic<uint64_t> number{0};
+        std::atomic<uint64_t> last{0};
+        std::atomic<int64_t> ts{0};
+    };
+
+    MutationObserver* next_observer_;
+    uint64_t id_;
+    uint64_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> next_{0};  // last sequence handed out
+
+    mutable std::mutex wake_mutex_;
+    mutable std::condition_variable wake_;
+    mutable std::atomic<uint32_t> sleepers_{0};  // readers inside wait()
+
+    void publish(ChangeEvent::Kind kind, uint64_t number, uint64_t last, time_t ts);
+};
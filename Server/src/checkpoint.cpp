@@ -0,0 +1,69 @@
+// checkpoint.cpp
+#include "checkpoint.h"
+
+#include "snapshot_file.h"
+
+#include <exception>
+#include <iostream>
+#include <utility>
+
+Checkpointer::Checkpointer(NumberStore& store, WriteAheadLog& wal, std::string directory,
+                           std::chrono::seconds interval, bool use_io_uring)
+    : store_(store), wal_(wal), directory_(std::move(directory)), interval_(interval),
+      writer_(make_file_writer(use_io_uring)) {
+    if (interval_.count() > 0)
+        thread_ = std::thread(&Checkpointer::run, this);
+}
+
+Checkpointer::~Checkpointer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+size_t Checkpointer::checkpoint() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t records = wal_.appended();
+    uint64_t seq = wal_.rotate();
+    size_t count;
+    if (store_.persistent()) {
+        // Everything before the rotation is in the store's files once the flush returns
+        store_.flush_to_disk();
+        count = store_.size();
+    } else {
+        count = SnapshotFile::write(snapshot_path(directory_), *store_.snapshot(), seq, *writer_);
+    }
+    wal_.remove_segments_before(seq);
+    checkpointed_records_ = records;
+    return count;
+}
+
+std::string Checkpointer::snapshot_path(const std::string& directory) {
+    return directory + "/snapshot.dat";
+}
+
+void Checkpointer::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait_for(lock, interval_, [this] { return stopping_; });
+        if (stopping_)
+            return;
+        if (wal_.appended() == checkpointed_records_)
+            continue;
+
+        lock.unlock();
+        auto start = std::chrono::steady_clock::now();
+        try {
+            size_t count = checkpoint();
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+            std::cout << "checkpoint: wrote " << count << " numbers in " << ms.count() << " ms" << std::endl;
+        } catch (const std::exception& e) {
+            std::cout << "checkpoint failed: " << e.what() << std::endl;
+        }
+        lock.lock();
+    }
+}
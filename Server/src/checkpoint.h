@@ -0,0 +1,76 @@
+// checkpoint.h
+#pragma once
+
+#include "file_writer.h"
+#include "number_store.h"
+#include "wal.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Periodically writes the store to a SnapshotFile and trims the write-ahead log
+ *
+ * @details A checkpoint first rotates the log, then streams a snapshot of the store to
+ *          <directory>/snapshot.dat. The dump may include changes made after the rotation;
+ *          replaying them again on top of it is harmless because every log record sets a
+ *          number's final state, so recovery only needs the segments from the rotation on.
+ *          The older segments are deleted once the new file is durable. Checkpoints are
+ *          skipped while nothing has been logged since the previous one. A persistent store
+ *          (see NumberStore::persistent) is flushed to its own files instead of being dumped.
+ */
+class Checkpointer {
+public:
+    /**
+     * @brief Start checkpointing every interval
+     * @param store Store to dump (or flush, if persistent)
+     * @param wal Log attached to the store
+     * @param directory Data directory (shared with the log)
+     * @param interval Time between checkpoints; zero disables the background thread
+     * @param use_io_uring Write through io_uring when available
+     */
+    Checkpointer(NumberStore& store, WriteAheadLog& wal, std::string directory,
+                 std::chrono::seconds interval, bool use_io_uring = true);
+
+    /**
+     * @brief Stop the background thread (an in-progress checkpoint completes first)
+     */
+    ~Checkpointer();
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    /**
+     * @brief Write a checkpoint now
+     * @return Number of entries in the checkpoint
+     * @throws std::system_error on I/O errors; the log is left untouched
+     */
+    size_t checkpoint();
+
+    /**
+     * @brief Location of the snapshot file inside a data directory
+     */
+    static std::string snapshot_path(const std::string& directory);
+
+private:
+    NumberStore& store_;
+    WriteAheadLog& wal_;
+    std::string directory_;
+    std::chrono::seconds interval_;
+
+    std::unique_ptr<FileWriter> writer_;
+
+    std::mutex mutex_;  // serializes checkpoints (and use of writer_) and guards stopping_
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    uint64_t checkpointed_records_ = 0;  // wal_.appended() covered by the last checkpoint
+    std::thread thread_;
+
+    void run();
+};
@@ -0,0 +1,34 @@
+// crc32c.h
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief CRC-32C (Castagnoli) checksum, table driven
+ *
+ * @details Used to detect torn or corrupted records in the on-disk log and snapshot files.
+ * @param data Bytes to checksum
+ * @param size Number of bytes
+ * @param crc Running checksum to extend (0 to start)
+ * @return Updated checksum
+ */
+inline uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    const auto* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
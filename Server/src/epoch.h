@@ -0,0 +1,213 @@
+// epoch.h
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+/**
+ * @brief Epoch-based memory reclamation for lock-free data structures
+ *
+ * @details Readers pin the current global epoch for the duration of an operation. Memory
+ *          that has been unlinked is retired with the epoch it was retired in and only
+ *          freed once the global epoch has advanced twice past it, which guarantees that
+ *          every thread that could still hold a pointer to it has unpinned since.
+ *
+ *          One process-wide domain is shared by every structure. Each thread registers a
+ *          slot on first use; slots are recycled when threads exit, and memory still
+ *          waiting in an exiting thread's limbo list is handed to a shared orphan list.
+ */
+class EpochDomain {
+public:
+    using Deleter = void (*)(void*);
+
+    /**
+     * @brief RAII pin of the current epoch; pointers read while it is alive stay valid
+     */
+    class Guard {
+    public:
+        explicit Guard(EpochDomain& domain) : domain_(domain) { domain_.enter(); }
+        ~Guard() { domain_.exit(); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        EpochDomain& domain_;
+    };
+
+    /**
+     * @brief The process-wide domain
+     */
+    static EpochDomain& global() {
+        static EpochDomain* domain = new EpochDomain;  // intentionally leaked: outlives thread_local slots
+        return *domain;
+    }
+
+    Guard pin() { return Guard(*this); }
+
+    /**
+     * @brief Schedule memory for release once no pinned thread can reference it
+     * @param ptr Unlinked object
+     * @param deleter Function releasing the object
+     */
+    void retire(void* ptr, Deleter deleter) {
+        Slot& slot = local_slot();
+        std::atomic_thread_fence(std::memory_order_seq_cst);  // pairs with the fence in enter()
+        slot.limbo.push_back({ptr, deleter, epoch_.load(std::memory_order_relaxed)});
+        if (++slot.retires_since_collect >= kCollectInterval) {
+            slot.retires_since_collect = 0;
+            try_advance();
+            collect(slot.limbo);
+            collect_orphans();
+        }
+    }
+
+    /**
+     * @brief Epoch to pass to synchronized() for memory unlinked before this call
+     */
+    uint64_t retire_epoch() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);  // pairs with the fence in enter()
+        return epoch_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Whether memory unlinked at `epoch` is out of reach of every pinned thread
+     * @details Advances the global epoch when every pinned thread has caught up, so a thread
+     *          that never calls retire() (the Reclaimer) can still wait out a grace period
+     *          by polling.
+     */
+    bool synchronized(uint64_t epoch) {
+        try_advance();
+        return epoch_.load(std::memory_order_acquire) >= epoch + 2;
+    }
+
+private:
+    static constexpr uint64_t kIdle = ~uint64_t{0};
+    static constexpr unsigned kCollectInterval = 64;
+
+    struct Retired {
+        void* ptr;
+        Deleter deleter;
+        uint64_t epoch;
+    };
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> announced{kIdle};  // pinned epoch, or kIdle
+        std::atomic<bool> in_use{false};
+        Slot* next = nullptr;                    // registry chain, immutable once published
+
+        // Owner-thread only
+        unsigned nesting = 0;
+        unsigned retires_since_collect = 0;
+        std::deque<Retired> limbo;
+    };
+
+    /**
+     * @brief Releases the slot and hands leftover garbage to the orphan list at thread exit
+     */
+    struct ThreadHandle {
+        EpochDomain* domain = nullptr;
+        Slot* slot = nullptr;
+
+        ~ThreadHandle() {
+            if (!slot)
+                return;
+            {
+                std::lock_guard<std::mutex> lock(domain->orphan_mutex_);
+                domain->orphans_.insert(domain->orphans_.end(), slot->limbo.begin(), slot->limbo.end());
+            }
+            slot->limbo.clear();
+            slot->in_use.store(false, std::memory_order_release);
+        }
+    };
+
+    std::atomic<uint64_t> epoch_{0};
+    std::atomic<Slot*> slots_{nullptr};
+    std::mutex orphan_mutex_;
+    std::deque<Retired> orphans_;
+
+    EpochDomain() = default;
+
+    Slot& local_slot() {
+        thread_local ThreadHandle handle;
+        if (!handle.slot) {
+            handle.domain = this;
+            handle.slot = acquire_slot();
+        }
+        return *handle.slot;
+    }
+
+    Slot* acquire_slot() {
+        for (Slot* s = slots_.load(std::memory_order_acquire); s; s = s->next) {
+            bool expected = false;
+            if (!s->in_use.load(std::memory_order_relaxed) &&
+                s->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                return s;
+        }
+        Slot* s = new Slot;
+        s->in_use.store(true, std::memory_order_relaxed);
+        Slot* head = slots_.load(std::memory_order_relaxed);
+        do {
+            s->next = head;
+        } while (!slots_.compare_exchange_weak(head, s, std::memory_order_release, std::memory_order_relaxed));
+        return s;
+    }
+
+    void enter() {
+        Slot& slot = local_slot();
+        if (slot.nesting++ == 0) {
+            slot.announced.store(epoch_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            // The announcement must be visible before any shared pointer is read
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void exit() {
+        Slot& slot = local_slot();
+        if (--slot.nesting == 0)
+            slot.announced.store(kIdle, std::memory_order_release);
+    }
+
+    /**
+     * @brief Advance the global epoch if every pinned thread has observed the current one
+     */
+    void try_advance() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t current = epoch_.load(std::memory_order_relaxed);
+        for (Slot* s = slots_.load(std::memory_order_acquire); s; s = s->next) {
+            uint64_t announced = s->announced.load(std::memory_order_acquire);
+            if (announced != kIdle && announced != current)
+                return;
+        }
+        epoch_.compare_exchange_strong(current, current + 1, std::memory_order_acq_rel);
+    }
+
+    /**
+     * @brief Free every entry retired at least two epochs ago (entries are in epoch order)
+     */
+    void collect(std::deque<Retired>& list) {
+        uint64_t current = epoch_.load(std::memory_order_acquire);
+        while (!list.empty() && list.front().epoch + 2 <= current) {
+            Retired r = list.front();
+            list.pop_front();
+            r.deleter(r.ptr);
+        }
+    }
+
+    void collect_orphans() {
+        std::unique_lock<std::mutex> lock(orphan_mutex_, std::try_to_lock);
+        if (lock.owns_lock() && !orphans_.empty()) {
+            // Orphans arrive from different threads, so they are not globally epoch ordered
+            uint64_t current = epoch_.load(std::memory_order_acquire);
+            std::deque<Retired> keep;
+            for (const Retired& r : orphans_) {
+                if (r.epoch + 2 <= current)
+                    r.deleter(r.ptr);
+                else
+                    keep.push_back(r);
+            }
+            orphans_.swap(keep);
+        }
+    }
+};
@@ -0,0 +1,273 @@
+// file_writer.cpp
+#include "file_writer.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+namespace {
+
+std::system_error errno_error(int err, const char* what) {
+    return std::system_error(err, std::generic_category(), what);
+}
+
+/**
+ * @brief pwrite()/fdatasync(); write() goes to the kernel immediately
+ */
+class PwriteWriter final : public FileWriter {
+public:
+    void write(int fd, const void* data, size_t size, uint64_t offset) override {
+        const auto* p = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+            ssize_t n = ::pwrite(fd, p, size, static_cast<off_t>(offset));
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw errno_error(errno, "pwrite");
+            }
+            p += n;
+            size -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+    }
+
+    void sync(int fd) override {
+        if (::fdatasync(fd) != 0)
+            throw errno_error(errno, "fdatasync");
+    }
+
+    const char* name() const override { return "pwrite"; }
+};
+
+/**
+ * @brief io_uring through the raw system calls, with registered write buffers
+ *
+ * @details write() copies into the next free registered buffer and queues a WRITE_FIXED;
+ *          only when every buffer holds queued data does it submit them and wait. sync()
+ *          queues an fsync flagged IOSQE_IO_DRAIN (so it runs after every queued write) and
+ *          submits the whole batch with a single io_uring_enter().
+ */
+class IoUringWriter final : public FileWriter {
+public:
+    static constexpr unsigned kBuffers = 8;
+    static constexpr size_t kBufferBytes = 256 * 1024;
+
+    /**
+     * @throws std::system_error if io_uring is unavailable or the buffers cannot be registered
+     */
+    IoUringWriter() {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, kBuffers * 2, &params));
+        if (ring_fd_ < 0)
+            throw errno_error(errno, "io_uring_setup");
+
+        try {
+            map_rings(params);
+            buffer_memory_ = static_cast<uint8_t*>(::mmap(nullptr, kBuffers * kBufferBytes, PROT_READ | PROT_WRITE,
+                                                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+            if (buffer_memory_ == MAP_FAILED) {
+                buffer_memory_ = nullptr;
+                throw errno_error(errno, "mmap io_uring buffers");
+            }
+            iovec iov[kBuffers];
+            for (unsigned i = 0; i < kBuffers; ++i)
+                iov[i] = {buffer_memory_ + i * kBufferBytes, kBufferBytes};
+            if (::syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS, iov, kBuffers) != 0)
+                throw errno_error(errno, "io_uring_register buffers");
+        } catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    ~IoUringWriter() override { release(); }
+
+    void write(int fd, const void* data, size_t size, uint64_t offset) override {
+        const auto* p = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+            if (used_ == kBuffers)
+                submit_and_wait();
+            size_t chunk = size < kBufferBytes ? size : kBufferBytes;
+            unsigned buffer = used_++;
+            std::memcpy(buffer_memory_ + buffer * kBufferBytes, p, chunk);
+
+            io_uring_sqe* sqe = next_sqe();
+            sqe->opcode = IORING_OP_WRITE_FIXED;
+            sqe->fd = fd;
+            sqe->addr = reinterpret_cast<uint64_t>(buffer_memory_ + buffer * kBufferBytes);
+            sqe->len = static_cast<uint32_t>(chunk);
+            sqe->off = offset;
+            sqe->buf_index = static_cast<uint16_t>(buffer);
+            sqe->user_data = chunk;  // expected result
+
+            p += chunk;
+            size -= chunk;
+            offset += chunk;
+        }
+    }
+
+    void sync(int fd) override {
+        io_uring_sqe* sqe = next_sqe();
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->flags = IOSQE_IO_DRAIN;
+        sqe->fd = fd;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe->user_data = 0;
+        submit_and_wait();
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+private:
+    int ring_fd_ = -1;
+    void* sq_ring_ = MAP_FAILED;
+    size_t sq_ring_bytes_ = 0;
+    void* cq_ring_ = MAP_FAILED;
+    size_t cq_ring_bytes_ = 0;
+    io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_bytes_ = 0;
+
+    std::atomic<unsigned>* sq_head_ = nullptr;
+    std::atomic<unsigned>* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* sq_array_ = nullptr;
+    std::atomic<unsigned>* cq_head_ = nullptr;
+    std::atomic<unsigned>* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    uint8_t* buffer_memory_ = nullptr;
+    unsigned used_ = 0;     // registered buffers holding queued writes
+    unsigned queued_ = 0;   // sqes not yet submitted
+
+    template <typename T>
+    static T* at(void* base, uint32_t offset) {
+        return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+    }
+
+    void map_rings(const io_uring_params& params) {
+        sq_ring_bytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_bytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+            sq_ring_bytes_ = cq_ring_bytes_ = std::max(sq_ring_bytes_, cq_ring_bytes_);
+
+        sq_ring_ = ::mmap(nullptr, sq_ring_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                          IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED)
+            throw errno_error(errno, "mmap io_uring sq");
+        if (single) {
+            cq_ring_ = sq_ring_;
+        } else {
+            cq_ring_ = ::mmap(nullptr, cq_ring_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                              IORING_OFF_CQ_RING);
+            if (cq_ring_ == MAP_FAILED)
+                throw errno_error(errno, "mmap io_uring cq");
+        }
+        sqes_bytes_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(::mmap(nullptr, sqes_bytes_, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED)
+            throw errno_error(errno, "mmap io_uring sqes");
+
+        sq_head_ = at<std::atomic<unsigned>>(sq_ring_, params.sq_off.head);
+        sq_tail_ = at<std::atomic<unsigned>>(sq_ring_, params.sq_off.tail);
+        sq_mask_ = *at<unsigned>(sq_ring_, params.sq_off.ring_mask);
+        sq_array_ = at<unsigned>(sq_ring_, params.sq_off.array);
+        cq_head_ = at<std::atomic<unsigned>>(cq_ring_, params.cq_off.head);
+        cq_tail_ = at<std::atomic<unsigned>>(cq_ring_, params.cq_off.tail);
+        cq_mask_ = *at<unsigned>(cq_ring_, params.cq_off.ring_mask);
+        cqes_ = at<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+    }
+
+    void release() {
+        if (buffer_memory_)
+            ::munmap(buffer_memory_, kBuffers * kBufferBytes);
+        if (sqes_ != MAP_FAILED)
+            ::munmap(sqes_, sqes_bytes_);
+        if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+            ::munmap(cq_ring_, cq_ring_bytes_);
+        if (sq_ring_ != MAP_FAILED)
+            ::munmap(sq_ring_, sq_ring_bytes_);
+        if (ring_fd_ >= 0)
+            ::close(ring_fd_);
+        buffer_memory_ = nullptr;
+        sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+        cq_ring_ = sq_ring_ = MAP_FAILED;
+        ring_fd_ = -1;
+    }
+
+    /**
+     * @brief Claim and zero the next submission slot (the ring holds twice kBuffers)
+     */
+    io_uring_sqe* next_sqe() {
+        unsigned tail = sq_tail_->load(std::memory_order_relaxed) + queued_;
+        unsigned index = tail & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[index] = index;
+        ++queued_;
+        return sqe;
+    }
+
+    /**
+     * @brief Submit every queued sqe, wait for all of them and check their results
+     */
+    void submit_and_wait() {
+        unsigned pending = queued_;
+        if (pending == 0)
+            return;
+        sq_tail_->store(sq_tail_->load(std::memory_order_relaxed) + pending, std::memory_order_release);
+        queued_ = 0;
+        used_ = 0;
+
+        unsigned to_submit = pending;
+        int error = 0;
+        while (pending > 0) {
+            long n = ::syscall(__NR_io_uring_enter, ring_fd_, to_submit, pending, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw errno_error(errno, "io_uring_enter");
+            }
+            to_submit -= std::min(static_cast<unsigned>(n), to_submit);
+
+            unsigned head = cq_head_->load(std::memory_order_relaxed);
+            unsigned tail = cq_tail_->load(std::memory_order_acquire);
+            for (; head != tail && pending > 0; ++head, --pending) {
+                const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                if (cqe.res < 0 && error == 0)
+                    error = -cqe.res;
+                else if (cqe.res >= 0 && static_cast<uint64_t>(cqe.res) != cqe.user_data && cqe.user_data != 0 &&
+                         error == 0)
+                    error = EIO;  // short write to a regular file: out of space or a failing device
+            }
+            cq_head_->store(head, std::memory_order_release);
+        }
+        if (error != 0)
+            throw errno_error(error, "io_uring write");
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<FileWriter> make_file_writer(bool use_io_uring, std::string* fallback_reason) {
+    if (use_io_uring) {
+        try {
+            return std::make_unique<IoUringWriter>();
+        } catch (const std::system_error& e) {
+            if (fallback_reason)
+                *fallback_reason = e.what();
+        }
+    }
+    return std::make_unique<PwriteWriter>();
+}
@@ -0,0 +1,48 @@
+// file_writer.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Positional file writes with explicit durability points
+ *
+ * @details write() copies the data and may only queue it; sync() completes every queued
+ *          write and then makes the file's data durable, like fdatasync(). Two
+ *          implementations exist: io_uring, which copies into a few buffers registered with
+ *          the kernel and submits a whole batch of writes plus the fsync in one system
+ *          call, and plain pwrite()/fdatasync() for kernels or sandboxes without io_uring.
+ *
+ * @note Not thread-safe; each writer belongs to one thread.
+ */
+class FileWriter {
+public:
+    virtual ~FileWriter() = default;
+
+    /**
+     * @brief Write size bytes at offset; the caller may reuse data as soon as this returns
+     * @throws std::system_error on I/O errors (of this or an earlier queued write)
+     */
+    virtual void write(int fd, const void* data, size_t size, uint64_t offset) = 0;
+
+    /**
+     * @brief Complete every queued write and fdatasync the file
+     * @throws std::system_error on I/O errors
+     */
+    virtual void sync(int fd) = 0;
+
+    /**
+     * @brief Implementation name for logs ("io_uring" or "pwrite")
+     */
+    virtual const char* name() const = 0;
+};
+
+/**
+ * @brief Create a writer, preferring io_uring
+ * @param use_io_uring false to force the pwrite implementation
+ * @param fallback_reason Set to why io_uring could not be used, if it was wanted but failed
+ * @return The writer; never null
+ */
+std::unique_ptr<FileWriter> make_file_writer(bool use_io_uring, std::string* fallback_reason = nullptr);
@@ -0,0 +1,303 @@
+// hash_index.h
+#pragma once
+
+#include "node_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Shard index with O(1) point operations and a lazily rebuilt sorted view
+ *
+ * @details Membership lives in an open-addressing hash table (linear probing, backward-shift
+ *          deletion, so there are no tombstones). Ordered output comes from a sorted array
+ *          that is only brought up to date when scan() is called:
+ *            - keys touched since the last scan are recorded in a small delta, and the view
+ *              is refreshed by merging the sorted delta into it;
+ *            - once the delta outgrows a quarter of the view it is dropped and the next scan
+ *              rebuilds the view from the table with a parallel sort.
+ *
+ *          The smallest and largest number come from a min-heap and a max-heap of keys with
+ *          lazy deletion: erase() leaves its key in them, first() and last() pop keys the
+ *          table no longer holds, and both heaps are rebuilt once they are mostly stale.
+ *
+ *          Suited to write-heavy, list-rare workloads. The view costs a second copy of every
+ *          entry and the heaps another two words per number. scan(), first() and last()
+ *          mutate them, so callers must serialize those with writers (the shard lock does).
+ */
+class HashIndex {
+public:
+    static constexpr bool kLazySortedView = true;  // scan() mutates; see HasLazySortedView
+
+    std::pair<time_t, bool> insert(uint64_t number, time_t ts) {
+        if ((size_ + 1) * kMaxLoadDen > slots_.size() * kMaxLoadNum)
+            grow();
+        for (size_t i = home(number);; i = (i + 1) & mask_) {
+            if (!used_[i]) {
+                used_[i] = 1;
+                slots_[i] = {number, ts};
+                ++size_;
+                touch(number);
+                push_edges(number);
+                return {ts, true};
+            }
+            if (slots_[i].key == number)
+                return {slots_[i].ts, false};
+        }
+    }
+
+    std::optional<time_t> erase(uint64_t number) {
+        size_t hole = find_slot(number);
+        if (hole == kNotFound)
+            return std::nullopt;
+        time_t erased = slots_[hole].ts;
+
+        // Shift later members of the probe run back so lookups never stop early
+        for (size_t j = (hole + 1) & mask_; used_[j]; j = (j + 1) & mask_) {
+            size_t h = home(slots_[j].key);
+            if (((j - h) & mask_) >= ((j - hole) & mask_)) {
+                slots_[hole] = slots_[j];
+                hole = j;
+            }
+        }
+        used_[hole] = 0;
+        --size_;
+        touch(number);
+        return erased;
+    }
+
+    std::optional<time_t> find(uint64_t number) const {
+        size_t slot = find_slot(number);
+        if (slot == kNotFound)
+            return std::nullopt;
+        return slots_[slot].ts;
+    }
+
+    /**
+     * @brief Smallest stored number; amortized O(log n), popping erased keys off the min-heap
+     */
+    std::optional<uint64_t> first() const { return edge(low_, std::greater<uint64_t>()); }
+
+    /**
+     * @brief Largest stored number; amortized O(log n), popping erased keys off the max-heap
+     */
+    std::optional<uint64_t> last() const { return edge(high_, std::less<uint64_t>()); }
+
+    template <typename Fn>
+    void scan(uint64_t from, Fn&& fn) const {
+        materialize();
+        auto it = std::lower_bound(view_.begin(), view_.end(), from,
+                                   [](const Entry& e, uint64_t key) { return e.key < key; });
+        for (; it != view_.end(); ++it)
+            if (!fn(it->key, it->ts))
+                return;
+    }
+
+    size_t size() const { return size_; }
+
+    /**
+     * @brief Table and view memory: one "block" per slot, free blocks are empty slots
+     */
+    PoolStats allocator_stats() const {
+        constexpr size_t kSlotBytes = sizeof(Entry) + sizeof(uint8_t);
+        PoolStats stats;
+        stats.slabs = slots_.empty() ? 0 : 1;
+        size_t heap_bytes = (low_.capacity() + high_.capacity()) * sizeof(uint64_t);
+        stats.reserved_bytes = slots_.size() * kSlotBytes + view_.capacity() * sizeof(Entry) + heap_bytes;
+        stats.live_blocks = size_;
+        stats.live_bytes = size_ * kSlotBytes + view_.size() * sizeof(Entry) + 2 * size_ * sizeof(uint64_t);
+        stats.free_blocks = slots_.size() - size_;
+        return stats;
+    }
+
+    void clear() {
+        std::vector<Entry>().swap(slots_);
+        std::vector<uint8_t>().swap(used_);
+        std::vector<Entry>().swap(view_);
+        std::vector<uint64_t>().swap(touched_);
+        std::vector<uint64_t>().swap(low_);
+        std::vector<uint64_t>().swap(high_);
+        mask_ = 0;
+        size_ = 0;
+        stale_ = false;
+    }
+
+private:
+    struct Entry {
+        uint64_t key;
+        time_t ts;
+    };
+
+    static constexpr size_t kNotFound = ~size_t{0};
+    static constexpr size_t kMinCapacity = 16;
+    static constexpr size_t kMaxLoadNum = 7;  // grow above 70% occupancy
+    static constexpr size_t kMaxLoadDen = 10;
+    static constexpr size_t kMinDelta = 1024;             // delta always tracked up to this size
+    static constexpr size_t kParallelSortGrain = 1 << 18;  // entries per sorting thread
+
+    std::vector<Entry> slots_;
+    std::vector<uint8_t> used_;
+    size_t mask_ = 0;
+    size_t size_ = 0;
+
+    // Sorted view, refreshed by scan()
+    mutable std::vector<Entry> view_;
+    mutable std::vector<uint64_t> touched_;  // keys changed since the view was refreshed
+    mutable bool stale_ = false;             // delta dropped; view needs a full rebuild
+
+    // Edge heaps, refreshed by first() / last(); may hold erased or repeated keys
+    mutable std::vector<uint64_t> low_;   // min-heap
+    mutable std::vector<uint64_t> high_;  // max-heap
+
+    static uint64_t mix(uint64_t x) {
+        // splitmix64 finalizer: sequential ids spread over the whole table
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ull;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    size_t home(uint64_t key) const { return static_cast<size_t>(mix(key)) & mask_; }
+
+    /**
+     * @brief Add a new key to both edge heaps, rebuilding them from the table once stale keys
+     *        make up most of them
+     */
+    void push_edges(uint64_t key) {
+        if (low_.size() > 2 * size_ + kMinDelta) {
+            low_.clear();
+            for (size_t i = 0; i < slots_.size(); ++i)
+                if (used_[i])
+                    low_.push_back(slots_[i].key);
+            high_ = low_;
+            std::make_heap(low_.begin(), low_.end(), std::greater<uint64_t>());
+            std::make_heap(high_.begin(), high_.end(), std::less<uint64_t>());
+            return;  // key is in the table already
+        }
+        low_.push_back(key);
+        std::push_heap(low_.begin(), low_.end(), std::greater<uint64_t>());
+        high_.push_back(key);
+        std::push_heap(high_.begin(), high_.end(), std::less<uint64_t>());
+    }
+
+    /**
+     * @brief Top of an edge heap after popping keys the table no longer holds
+     */
+    template <typename Compare>
+    std::optional<uint64_t> edge(std::vector<uint64_t>& heap, Compare compare) const {
+        while (!heap.empty() && find_slot(heap.front()) == kNotFound) {
+            std::pop_heap(heap.begin(), heap.end(), compare);
+            heap.pop_back();
+        }
+        return heap.empty() ? std::nullopt : std::optional<uint64_t>(heap.front());
+    }
+
+    size_t find_slot(uint64_t key) const {
+        if (size_ == 0)
+            return kNotFound;
+        for (size_t i = home(key); used_[i]; i = (i + 1) & mask_)
+            if (slots_[i].key == key)
+                return i;
+        return kNotFound;
+    }
+
+    void grow() {
+        size_t capacity = std::max(kMinCapacity, slots_.size() * 2);
+        std::vector<Entry> old_slots = std::move(slots_);
+        std::vector<uint8_t> old_used = std::move(used_);
+        slots_.assign(capacity, Entry{});
+        used_.assign(capacity, 0);
+        mask_ = capacity - 1;
+        for (size_t i = 0; i < old_slots.size(); ++i) {
+            if (!old_used[i])
+                continue;
+            size_t j = home(old_slots[i].key);
+            while (used_[j])
+                j = (j + 1) & mask_;
+            used_[j] = 1;
+            slots_[j] = old_slots[i];
+        }
+    }
+
+    void touch(uint64_t key) {
+        if (stale_)
+            return;
+        touched_.push_back(key);
+        if (touched_.size() > std::max(kMinDelta, view_.size() / 4)) {
+            stale_ = true;
+            std::vector<uint64_t>().swap(touched_);
+        }
+    }
+
+    /**
+     * @brief Bring the sorted view up to date with the table
+     */
+    void materialize() const {
+        if (stale_) {
+            view_.clear();
+            view_.reserve(size_);
+            for (size_t i = 0; i < slots_.size(); ++i)
+                if (used_[i])
+                    view_.push_back(slots_[i]);
+            sort_entries(view_);
+            stale_ = false;
+            return;
+        }
+        if (touched_.empty())
+            return;
+
+        std::sort(touched_.begin(), touched_.end());
+        touched_.erase(std::unique(touched_.begin(), touched_.end()), touched_.end());
+
+        // Untouched keys keep their view entry; touched ones take their current table state
+        std::vector<Entry> merged;
+        merged.reserve(view_.size() + touched_.size());
+        size_t v = 0;
+        for (uint64_t key : touched_) {
+            while (v < view_.size() && view_[v].key < key)
+                merged.push_back(view_[v++]);
+            if (v < view_.size() && view_[v].key == key)
+                ++v;
+            size_t slot = find_slot(key);
+            if (slot != kNotFound)
+                merged.push_back(slots_[slot]);
+        }
+        merged.insert(merged.end(), view_.begin() + v, view_.end());
+        view_.swap(merged);
+        touched_.clear();
+    }
+
+    /**
+     * @brief Sort by key, splitting large inputs across threads and merging the slices
+     */
+    static void sort_entries(std::vector<Entry>& entries) {
+        auto by_key = [](const Entry& a, const Entry& b) { return a.key < b.key; };
+        size_t threads = std::min<size_t>(std::thread::hardware_concurrency(), entries.size() / kParallelSortGrain);
+        if (threads < 2) {
+            std::sort(entries.begin(), entries.end(), by_key);
+            return;
+        }
+
+        std::vector<size_t> bounds(threads + 1);
+        for (size_t t = 0; t <= threads; ++t)
+            bounds[t] = entries.size() * t / threads;
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t)
+            workers.emplace_back([&, t] { std::sort(entries.begin() + bounds[t], entries.begin() + bounds[t + 1], by_key); });
+        for (auto& w : workers)
+            w.join();
+
+        for (size_t width = 1; width < threads; width *= 2)
+            for (size_t t = 0; t + width < threads; t += 2 * width)
+                std::inplace_merge(entries.begin() + bounds[t], entries.begin() + bounds[t + width],
+                                   entries.begin() + bounds[std::min(t + 2 * width, threads)], by_key);
+    }
+};
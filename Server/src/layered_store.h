@@ -0,0 +1,356 @@
+// layered_store.h
+#pragma once
+
+#include "number_store.h"
+#include "snapshot_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Serves a memory-mapped checkpoint at once while loading it into a writable store
+ *
+ * @details The store starts out as two layers: the read-only SnapshotFile and an empty
+ *          writable backend. A loader thread copies the snapshot into the backend in
+ *          ascending chunks and advances a watermark behind each one. Numbers below the
+ *          watermark live only in the backend and go straight to it. For numbers at or above
+ *          it, operations take the layer lock and consult both layers: an insert of a number
+ *          still in the snapshot is a duplicate, and erasing one leaves a tombstone that the
+ *          loader honors when it reaches that number. Once the loader finishes, the snapshot
+ *          is unmapped and every call is a plain forward to the backend.
+ *
+ *          The backend's own mutation notifications are forwarded to this store's observer,
+ *          except those caused by the loader, so a write-ahead log sees only real changes.
+ *          Until loading finishes, snapshot() falls back to reading the live layers. stats()
+ *          adds the snapshot entries still pending to the backend's own stats: their count
+ *          comes from the load position and the tombstones, their bounds from the first and
+ *          last entry not erased, and their time range from the snapshot header, which covers
+ *          the whole checkpoint and so bounds the pending part.
+ */
+class LayeredStore final : public NumberStore {
+public:
+    /**
+     * @brief Start serving base and loading it into live
+     * @param live Empty writable backend
+     * @param base Checkpoint to serve and load
+     */
+    LayeredStore(std::unique_ptr<NumberStore> live, std::shared_ptr<const SnapshotFile> base)
+        : live_(std::move(live)), base_(std::move(base)), forwarder_(*this) {
+        live_->set_observer(&forwarder_);
+        if (base_->size() == 0) {
+            finish_loading();
+            return;
+        }
+        watermark_.store(base_->number(0), std::memory_order_relaxed);
+        loader_ = std::thread(&LayeredStore::load, this);
+    }
+
+    ~LayeredStore() override {
+        stopping_.store(true, std::memory_order_relaxed);
+        if (loader_.joinable())
+            loader_.join();
+    }
+
+    LayeredStore(const LayeredStore&) = delete;
+    LayeredStore& operator=(const LayeredStore&) = delete;
+
+    std::pair<time_t, bool> insert(uint64_t number, time_t ts) override {
+        if (settled(number))
+            return live_->insert(number, ts);
+        std::lock_guard<std::mutex> lock(layer_mutex_);
+        time_t base_ts;
+        if (pending(number) && base_->find(number, base_ts))
+            return {base_ts, false};
+        return live_->insert(number, ts);
+    }
+
+    bool erase(uint64_t number) override {
+        if (settled(number))
+            return live_->erase(number);
+        std::lock_guard<std::mutex> lock(layer_mutex_);
+        time_t base_ts;
+        if (pending(number) && base_->find(number, base_ts)) {
+            tombstones_.insert(number);
+            if (observer_)
+                observer_->on_erase(number);
+            return true;
+        }
+        return live_->erase(number);
+    }
+
+    std::optional<time_t> find(uint64_t number) const override {
+        if (settled(number))
+            return live_->find(number);
+        std::lock_guard<std::mutex> lock(layer_mutex_);
+        time_t base_ts;
+        if (pending(number) && base_->find(number, base_ts))
+            return base_ts;
+        return live_->find(number);
+    }
+
+    StoreStats stats() const override {
+        if (loaded_.load(std::memory_order_acquire))
+            return live_->stats();
+        std::lock_guard<std::mutex> lock(layer_mutex_);
+        StoreStats stats = live_->stats();
+        size_t pending = loaded_.load(std::memory_order_relaxed) ? 0 : pending_count();
+        if (pending == 0)
+            return stats;
+
+        // Tombstones only cover pending entries, so both scans stop within pending entries
+        size_t first = next_index_;
+        while (tombstones_.count(base_->number(first)))
+            ++first;
+        size_t last = base_->size() - 1;
+        while (tombstones_.count(base_->number(last)))
+            --last;
+        time_t oldest;
+        time_t newest;
+        base_time_range(oldest, newest);
+        bool empty = stats.count == 0;
+        stats.count += pending;
+        stats.min = empty ? base_->number(first) : std::min(stats.min, base_->number(first));
+        stats.max = empty ? base_->number(last) : std::max(stats.max, base_->number(last));
+        stats.oldest = empty ? oldest : std::min(stats.oldest, oldest);
+        stats.newest = empty ? newest : std::max(stats.newest, newest);
+        return stats;
+    }
+
+    size_t find_batch(const uint64_t* numbers, size_t count, time_t* timestamps, uint8_t* found) const override {
+        if (loaded_.load(std::memory_order_acquire))
+            return live_->find_batch(numbers, count, timestamps, found);
+        return NumberStore::find_batch(numbers, count, timestamps, found);
+    }
+
+    size_t rank(uint64_t number) const override {
+        if (loaded_.load(std::memory_order_acquire))
+            return live_->rank(number);
+        return NumberStore::rank(number);
+    }
+
+    std::optional<StoreEntry> select(uint64_t k) const override {
+        if (loaded_.load(std::memory_order_acquire))
+            return live_->select(k);
+        return NumberStore::select(k);
+    }
+
+    size_t insert_batch(const uint64_t* numbers, size_t count, time_t ts, uint8_t* inserted) override {
+        if (loaded_.load(std::memory_order_acquire))
+            return live_->insert_batch(numbers, count, ts, inserted);
+        return NumberStore::insert_batch(numbers, count, ts, inserted);
+    }
+
+    size_t erase_batch(const uint64_t* numbers, size_t count, uint8_t* erased) override {
+        if (loaded_.load(std::memory_order_acquire))
+            return live_->erase_batch(numbers, count, erased);
+        return NumberStore::erase_batch(numbers, count, erased);
+    }
+
+    size_t erase_range(uint64_t lo, uint64_t hi) override {
+        if (loaded_.load(std::memory_order_acquire))
+            return live_->erase_range(lo, hi);
+        return NumberStore::erase_range(lo, hi);
+    }
+
+    size_t erase_inserted_before(time_t ts) override {
+        if (loaded_.load(std::memory_order_acquire))
+            return live_->erase_inserted_before(ts);
+        return NumberStore::erase_inserted_before(ts);
+    }
+
+    size_t read(uint64_t from, StoreEntry* out, size_t max) const override {
+        if (loaded_.load(std::memory_order_acquire))
+            return live_->read(from, out, max);
+        std::lock_guard<std::mutex> lock(layer_mutex_);
+        if (loaded_.load(std::memory_order_relaxed))
+            return live_->read(from, out, max);
+
+        // Merge the backend with the part of the snapshot not loaded yet; the two never overlap
+        std::vector<StoreEntry> live(max);
+        size_t live_count = live_->read(from, live.data(), max);
+        size_t i = base_->lower_bound(std::max(from, watermark_.load(std::memory_order_relaxed)));
+        size_t j = 0;
+        size_t n = 0;
+        while (n < max) {
+            while (i < base_->size() && tombstones_.count(base_->number(i)))
+                ++i;
+            bool have_base = i < base_->size();
+            if (j < live_count && (!have_base || live[j].number < base_->number(i)))
+                out[n++] = live[j++];
+            else if (have_base)
+                out[n++] = {base_->number(i), base_->timestamp(i++)};
+            else
+                break;
+        }
+        return n;
+    }
+
+    size_t read_numbers(uint64_t from, uint64_t* out, size_t max) const override {
+        if (loaded_.load(std::memory_order_acquire))
+            return live_->read_numbers(from, out, max);
+        return NumberStore::read_numbers(from, out, max);
+    }
+
+    size_t clear() override {
+        size_t removed = 0;
+        {
+            std::lock_guard<std::mutex> lock(layer_mutex_);
+            if (!loaded_.load(std::memory_order_relaxed)) {
+                removed = pending_count();
+                if (observer_)
+                    observer_->on_clear_range(watermark_.load(std::memory_order_relaxed),
+                                              std::numeric_limits<uint64_t>::max());
+                finish_loading();
+            }
+        }
+        return removed + live_->clear();
+    }
+
+    size_t size() const override {
+        if (loaded_.load(std::memory_order_acquire))
+            return live_->size();
+        std::lock_guard<std::mutex> lock(layer_mutex_);
+        return live_->size() + (loaded_.load(std::memory_order_relaxed) ? 0 : pending_count());
+    }
+
+    std::unique_ptr<StoreSnapshot> snapshot() const override {
+        if (loaded_.load(std::memory_order_acquire))
+            return live_->snapshot();
+        return NumberStore::snapshot();
+    }
+
+    PoolStats allocator_stats() const override { return live_->allocator_stats(); }
+
+    /**
+     * @brief Whether the whole snapshot has been loaded into the backend
+     */
+    bool loaded() const { return loaded_.load(std::memory_order_acquire); }
+
+private:
+    static constexpr size_t kLoadChunk = 4096;
+
+    /**
+     * @brief Passes the backend's notifications on, except the loader's own inserts
+     */
+    class Forwarder final : public MutationObserver {
+    public:
+        explicit Forwarder(LayeredStore& owner) : owner_(owner) {}
+
+        void on_insert(uint64_t number, time_t ts) override {
+            if (!loading_thread_ && owner_.observer_)
+                owner_.observer_->on_insert(number, ts);
+        }
+
+        void on_erase(uint64_t number) override {
+            if (owner_.observer_)
+                owner_.observer_->on_erase(number);
+        }
+
+        void on_clear_range(uint64_t lo, uint64_t hi) override {
+            if (owner_.observer_)
+                owner_.observer_->on_clear_range(lo, hi);
+        }
+
+    private:
+        LayeredStore& owner_;
+    };
+
+    static inline thread_local bool loading_thread_ = false;
+
+    std::unique_ptr<NumberStore> live_;
+    std::shared_ptr<const SnapshotFile> base_;  // released once loaded
+    Forwarder forwarder_;
+
+    mutable std::mutex layer_mutex_;              // guards the fields below and base_
+    std::atomic<bool> loaded_{false};
+    std::atomic<uint64_t> watermark_{0};          // snapshot numbers below it are in live_
+    size_t next_index_ = 0;                       // first snapshot entry not loaded yet
+    std::unordered_set<uint64_t> tombstones_;     // snapshot numbers erased before being loaded
+    mutable bool base_times_scanned_ = false;     // format 1 snapshots: range computed on first use
+    mutable time_t base_oldest_ = 0;
+    mutable time_t base_newest_ = 0;
+
+    std::atomic<bool> stopping_{false};
+    std::thread loader_;
+
+    /**
+     * @brief Whether number can bypass the layer lock (it is below the watermark)
+     */
+    bool settled(uint64_t number) const {
+        return loaded_.load(std::memory_order_acquire) || number < watermark_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Whether the snapshot still speaks for number (caller holds the layer lock)
+     */
+    bool pending(uint64_t number) const {
+        return !loaded_.load(std::memory_order_relaxed) && number >= watermark_.load(std::memory_order_relaxed) &&
+               !tombstones_.count(number);
+    }
+
+    /**
+     * @brief Snapshot entries not loaded and not erased (caller holds the layer lock)
+     */
+    size_t pending_count() const { return base_->size() - next_index_ - tombstones_.size(); }
+
+    /**
+     * @brief Insertion-time range of the snapshot (caller holds the layer lock)
+     * @details Read from the header; a format 1 snapshot does not record it, so its
+     *          timestamps are scanned once, on the first call.
+     */
+    void base_time_range(time_t& oldest, time_t& newest) const {
+        if (base_->time_range(oldest, newest))
+            return;
+        if (!base_times_scanned_) {
+            for (size_t i = 0; i < base_->size(); ++i) {
+                time_t ts = base_->timestamp(i);
+                base_oldest_ = i ? std::min(base_oldest_, ts) : ts;
+                base_newest_ = i ? std::max(base_newest_, ts) : ts;
+            }
+            base_times_scanned_ = true;
+        }
+        oldest = base_oldest_;
+        newest = base_newest_;
+    }
+
+    /**
+     * @brief Drop the snapshot layer (caller holds the layer lock, or is the constructor)
+     */
+    void finish_loading() {
+        tombstones_.clear();
+        base_.reset();
+        loaded_.store(true, std::memory_order_release);
+    }
+
+    void load() {
+        loading_thread_ = true;
+        size_t total = base_->size();
+        while (!stopping_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(layer_mutex_);
+            if (loaded_.load(std::memory_order_relaxed))
+                return;
+            size_t end = std::min(next_index_ + kLoadChunk, total);
+            for (size_t i = next_index_; i < end; ++i) {
+                uint64_t number = base_->number(i);
+                if (tombstones_.erase(number) == 0)
+                    live_->insert(number, base_->timestamp(i));
+            }
+            next_index_ = end;
+            if (end == total) {
+                finish_loading();
+                return;
+            }
+            watermark_.store(base_->number(end), std::memory_order_release);
+        }
+    }
+};
@@ -0,0 +1,268 @@
+// lsm_run.cpp
+#include "lsm_run.h"
+
+#include "crc32c.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+struct LsmRun::Header {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t block_entries;
+    uint64_t count;
+    uint64_t block_count;
+    uint64_t index_offset;
+    uint64_t bloom_offset;
+    uint64_t bloom_bits;
+    uint32_t index_crc;   // over the index and the filter
+    uint32_t header_crc;  // over every byte before it
+};
+
+namespace {
+
+constexpr char kMagic[8] = {'N', 'U', 'M', 'R', 'U', 'N', '0', '1'};
+
+std::system_error errno_error(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+size_t round_up8(size_t n) { return (n + 7) / 8 * 8; }
+
+/**
+ * @brief Bytes of a block holding n entries: numbers, tombstone words, timestamps
+ */
+size_t block_bytes(size_t n) { return n * sizeof(uint64_t) + (n + 63) / 64 * sizeof(uint64_t) + n * sizeof(uint32_t); }
+
+size_t data_bytes(uint64_t count, size_t block_entries) {
+    return count / block_entries * block_bytes(block_entries) + block_bytes(count % block_entries);
+}
+
+uint64_t bloom_bits_for(size_t entries) {
+    uint64_t bits = std::max<uint64_t>(64, uint64_t{entries} * LsmRun::kBloomBitsPerKey);
+    return (bits + 63) / 64 * 64;
+}
+
+/**
+ * @brief Calls fn(bit) for every filter bit of a number (double hashing)
+ */
+template <typename Fn>
+void for_each_probe(uint64_t number, uint64_t bits, Fn&& fn) {
+    uint64_t h = LsmRun::hash(number);
+    uint64_t delta = (h >> 17) | (h << 47);
+    for (unsigned i = 0; i < LsmRun::kBloomHashes; ++i) {
+        if (!fn(h % bits))
+            return;
+        h += delta;
+    }
+}
+
+}  // namespace
+
+LsmRun::Writer::Writer(std::string path, FileWriter& io, size_t expected_entries)
+    : path_(std::move(path)), io_(io), offset_(sizeof(Header)), bloom_(bloom_bits_for(expected_entries) / 64) {
+    static_assert(sizeof(Header) == 64, "run header must stay 64 bytes");
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+        throw errno_error("create " + path_);
+    numbers_.reserve(kBlockEntries);
+    offsets_.reserve(kBlockEntries);
+    tombstones_.reserve(kBlockEntries / 64);
+}
+
+LsmRun::Writer::~Writer() {
+    if (fd_ >= 0) {
+        // Abandoned before finish(): leave no partial run behind
+        ::close(fd_);
+        ::unlink(path_.c_str());
+    }
+}
+
+void LsmRun::Writer::add(uint64_t number, time_t ts, bool deleted) {
+    size_t at = numbers_.size();
+    if (at % 64 == 0)
+        tombstones_.push_back(0);
+    if (deleted)
+        tombstones_.back() |= uint64_t{1} << (at % 64);
+    numbers_.push_back(number);
+    offsets_.push_back(TimestampCodec::encode(ts));
+    uint64_t bits = bloom_.size() * 64;
+    for_each_probe(number, bits, [&](uint64_t bit) {
+        bloom_[bit / 64] |= uint64_t{1} << (bit % 64);
+        return true;
+    });
+    ++count_;
+    if (numbers_.size() == kBlockEntries)
+        write_block();
+}
+
+size_t LsmRun::Writer::finish() {
+    if (!numbers_.empty())
+        write_block();
+
+    uint64_t padding = 0;
+    append(&padding, round_up8(offset_) - offset_);
+    uint64_t index_offset = offset_;
+    append(first_numbers_.data(), first_numbers_.size() * sizeof(uint64_t));
+    append(block_crcs_.data(), block_crcs_.size() * sizeof(uint32_t));
+    append(&padding, round_up8(offset_) - offset_);
+    uint64_t bloom_offset = offset_;
+    append(bloom_.data(), bloom_.size() * sizeof(uint64_t));
+
+    uint32_t index_crc = crc32c(first_numbers_.data(), first_numbers_.size() * sizeof(uint64_t));
+    index_crc = crc32c(block_crcs_.data(), block_crcs_.size() * sizeof(uint32_t), index_crc);
+    index_crc = crc32c(bloom_.data(), bloom_.size() * sizeof(uint64_t), index_crc);
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.format_version = kFormatVersion;
+    header.block_entries = kBlockEntries;
+    header.count = count_;
+    header.block_count = first_numbers_.size();
+    header.index_offset = index_offset;
+    header.bloom_offset = bloom_offset;
+    header.bloom_bits = bloom_.size() * 64;
+    header.index_crc = index_crc;
+    header.header_crc = crc32c(&header, offsetof(Header, header_crc));
+    io_.write(fd_, &header, sizeof(header), 0);
+    io_.sync(fd_);
+    ::close(fd_);
+    fd_ = -1;
+    return count_;
+}
+
+void LsmRun::Writer::append(const void* data, size_t size) {
+    if (size == 0)
+        return;
+    io_.write(fd_, data, size, offset_);
+    offset_ += size;
+}
+
+void LsmRun::Writer::write_block() {
+    size_t n = numbers_.size();
+    uint32_t crc = crc32c(numbers_.data(), n * sizeof(uint64_t));
+    crc = crc32c(tombstones_.data(), tombstones_.size() * sizeof(uint64_t), crc);
+    crc = crc32c(offsets_.data(), n * sizeof(uint32_t), crc);
+    append(numbers_.data(), n * sizeof(uint64_t));
+    append(tombstones_.data(), tombstones_.size() * sizeof(uint64_t));
+    append(offsets_.data(), n * sizeof(uint32_t));
+    first_numbers_.push_back(numbers_.front());
+    block_crcs_.push_back(crc);
+    numbers_.clear();
+    tombstones_.clear();
+    offsets_.clear();
+}
+
+std::shared_ptr<const LsmRun> LsmRun::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw errno_error("open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw errno_error("stat " + path);
+    }
+    size_t length = static_cast<size_t>(st.st_size);
+    if (length < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error(path + ": too short for a run");
+    }
+    void* data = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        throw errno_error("mmap " + path);
+
+    std::shared_ptr<LsmRun> run(new LsmRun());
+    run->path_ = path;
+    run->data_ = static_cast<const uint8_t*>(data);
+    run->length_ = length;
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0)
+        throw std::runtime_error(path + ": not a run file");
+    if (header.header_crc != crc32c(&header, offsetof(Header, header_crc)))
+        throw std::runtime_error(path + ": header checksum mismatch");
+    if (header.format_version != kFormatVersion)
+        throw std::runtime_error(path + ": unsupported format version " + std::to_string(header.format_version));
+    size_t index_bytes = header.block_count * (sizeof(uint64_t) + sizeof(uint32_t));
+    if (header.block_entries == 0 || header.block_entries % 64 != 0 ||
+        header.block_count != (header.count + header.block_entries - 1) / header.block_entries ||
+        header.index_offset != round_up8(sizeof(Header) + data_bytes(header.count, header.block_entries)) ||
+        header.bloom_offset != round_up8(header.index_offset + index_bytes) || header.bloom_bits == 0 ||
+        header.bloom_bits % 64 != 0 || length != header.bloom_offset + header.bloom_bits / 8)
+        throw std::runtime_error(path + ": inconsistent header");
+
+    const uint8_t* index = run->data_ + header.index_offset;
+    uint32_t crc = crc32c(index, index_bytes);
+    crc = crc32c(run->data_ + header.bloom_offset, header.bloom_bits / 8, crc);
+    if (crc != header.index_crc)
+        throw std::runtime_error(path + ": index checksum mismatch");
+
+    run->count_ = header.count;
+    run->block_entries_ = header.block_entries;
+    run->block_count_ = header.block_count;
+    run->first_numbers_ = reinterpret_cast<const uint64_t*>(index);
+    run->block_crcs_ = reinterpret_cast<const uint32_t*>(index + header.block_count * sizeof(uint64_t));
+    run->bloom_ = reinterpret_cast<const uint64_t*>(run->data_ + header.bloom_offset);
+    run->bloom_bits_ = header.bloom_bits;
+    run->verified_.reset(new std::atomic<bool>[header.block_count]());
+    return run;
+}
+
+LsmRun::~LsmRun() {
+    if (data_)
+        ::munmap(const_cast<uint8_t*>(data_), length_);
+}
+
+size_t LsmRun::lower_bound(uint64_t key) const {
+    const uint64_t* next = std::upper_bound(first_numbers_, first_numbers_ + block_count_, key);
+    if (next == first_numbers_)
+        return 0;
+    size_t b = static_cast<size_t>(next - first_numbers_) - 1;
+    const uint64_t* numbers = block(b);
+    size_t n = block_size(b);
+    return b * block_entries_ + static_cast<size_t>(std::lower_bound(numbers, numbers + n, key) - numbers);
+}
+
+bool LsmRun::find(uint64_t key, Entry& out) const {
+    if (count_ == 0 || !may_contain(key))
+        return false;
+    size_t i = lower_bound(key);
+    if (i == count_ || number(i) != key)
+        return false;
+    out = entry(i);
+    return true;
+}
+
+bool LsmRun::may_contain(uint64_t key) const {
+    bool found = true;
+    for_each_probe(key, bloom_bits_, [&](uint64_t bit) {
+        found = (bloom_[bit / 64] >> (bit % 64)) & 1;
+        return found;
+    });
+    return found;
+}
+
+size_t LsmRun::block_offset(size_t b) const {
+    return sizeof(Header) + b * block_bytes(block_entries_);
+}
+
+void LsmRun::verify_block(size_t b) const {
+    if (crc32c(data_ + block_offset(b), block_bytes(block_size(b))) != block_crcs_[b]) {
+        std::cerr << "lsm: " << path_ << " block " << b << " failed its checksum; aborting" << std::endl;
+        std::abort();
+    }
+    verified_[b].store(true, std::memory_order_release);
+}
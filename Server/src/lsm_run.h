@@ -0,0 +1,181 @@
+// lsm_run.h
+#pragma once
+
+#include "file_writer.h"
+#include "timestamp_codec.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One sorted, immutable run of an LSM tree, memory-mapped from disk
+ *
+ * @details File layout (little-endian):
+ *
+ *            header   64 bytes: magic "NUMRUN01", format version, entries per block, entry
+ *                     count, block count, index offset, Bloom filter offset and size, CRC-32C
+ *                     of index plus filter and of the header itself
+ *            blocks   per block of up to kBlockEntries entries: the sorted numbers (uint64),
+ *                     a tombstone bitmap (one uint64 word per 64 entries), then the timestamps
+ *                     (uint32 offsets, see TimestampCodec)
+ *            index    8-byte aligned: first number of every block, then the CRC-32C of every
+ *                     block
+ *            filter   8-byte aligned Bloom filter over every number, kBloomBitsPerKey bits per
+ *                     entry and kBloomHashes probes
+ *
+ *          A tombstone records that the number was deleted after older runs were written; it
+ *          shadows them until compaction into the bottom level drops it. Lookups consult the
+ *          Bloom filter first, so a run that does not hold a number rarely costs a block read.
+ *          Like SnapshotFile, blocks are checksummed on first access and a mismatch aborts.
+ */
+class LsmRun {
+public:
+    static constexpr uint32_t kFormatVersion = 1;
+    static constexpr uint32_t kBlockEntries = 4096;
+    static constexpr unsigned kBloomBitsPerKey = 10;
+    static constexpr unsigned kBloomHashes = 7;
+
+    /**
+     * @brief One entry of a run
+     */
+    struct Entry {
+        uint64_t number;
+        time_t timestamp;
+        bool deleted;  // tombstone
+    };
+
+    /**
+     * @brief Streams ascending entries into a new run file
+     */
+    class Writer {
+    public:
+        /**
+         * @param path File to create (replaced if it exists)
+         * @param io I/O implementation
+         * @param expected_entries Upper bound on the entries that will be added (sizes the filter)
+         * @throws std::system_error if the file cannot be created
+         */
+        Writer(std::string path, FileWriter& io, size_t expected_entries);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        /**
+         * @brief Append an entry; numbers must be strictly ascending
+         */
+        void add(uint64_t number, time_t ts, bool deleted);
+
+        /**
+         * @brief Write the index, filter and header and fsync the file
+         * @return Entries written
+         * @throws std::system_error on I/O errors
+         */
+        size_t finish();
+
+    private:
+        std::string path_;
+        FileWriter& io_;
+        int fd_;
+        uint64_t offset_;
+        size_t count_ = 0;
+        std::vector<uint64_t> numbers_;
+        std::vector<uint64_t> tombstones_;
+        std::vector<uint32_t> offsets_;
+        std::vector<uint64_t> first_numbers_;
+        std::vector<uint32_t> block_crcs_;
+        std::vector<uint64_t> bloom_;
+
+        void append(const void* data, size_t size);
+        void write_block();
+    };
+
+    /**
+     * @brief Map a run file
+     * @throws std::system_error if the file cannot be mapped, std::runtime_error if it is invalid
+     */
+    static std::shared_ptr<const LsmRun> open(const std::string& path);
+
+    ~LsmRun();
+
+    LsmRun(const LsmRun&) = delete;
+    LsmRun& operator=(const LsmRun&) = delete;
+
+    size_t size() const { return count_; }
+    const std::string& path() const { return path_; }
+
+    /**
+     * @brief Bytes of the file, for level sizing
+     */
+    size_t bytes() const { return length_; }
+
+    Entry entry(size_t i) const {
+        size_t b = i / block_entries_;
+        size_t at = i % block_entries_;
+        const uint64_t* numbers = block(b);
+        size_t n = block_size(b);
+        const uint64_t* tombstones = numbers + n;
+        const auto* offsets = reinterpret_cast<const uint32_t*>(tombstones + (n + 63) / 64);
+        return {numbers[at], TimestampCodec::decode(offsets[at]), ((tombstones[at / 64] >> (at % 64)) & 1) != 0};
+    }
+
+    uint64_t number(size_t i) const { return block(i / block_entries_)[i % block_entries_]; }
+
+    /**
+     * @brief Position of the first entry with number >= key (size() if none)
+     */
+    size_t lower_bound(uint64_t key) const;
+
+    /**
+     * @brief Look up one number, tombstones included
+     * @return true if the run has an entry (live or tombstone) for the number
+     */
+    bool find(uint64_t key, Entry& out) const;
+
+    /**
+     * @brief Bloom filter hash shared by the writer and the reader
+     */
+    static uint64_t hash(uint64_t number) {
+        uint64_t z = number + 0x9E3779B97F4A7C15ull;  // splitmix64 finalizer
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+private:
+    struct Header;
+
+    std::string path_;
+    const uint8_t* data_ = nullptr;
+    size_t length_ = 0;
+    size_t count_ = 0;
+    size_t block_entries_ = 0;
+    size_t block_count_ = 0;
+    const uint64_t* first_numbers_ = nullptr;
+    const uint32_t* block_crcs_ = nullptr;
+    const uint64_t* bloom_ = nullptr;
+    uint64_t bloom_bits_ = 0;
+    std::unique_ptr<std::atomic<bool>[]> verified_;
+
+    LsmRun() = default;
+
+    size_t block_size(size_t b) const {
+        return b + 1 == block_count_ ? count_ - b * block_entries_ : block_entries_;
+    }
+
+    const uint64_t* block(size_t b) const {
+        const auto* numbers = reinterpret_cast<const uint64_t*>(data_ + block_offset(b));
+        if (!verified_[b].load(std::memory_order_acquire))
+            verify_block(b);
+        return numbers;
+    }
+
+    bool may_contain(uint64_t key) const;
+    size_t block_offset(size_t b) const;
+    void verify_block(size_t b) const;
+};
@@ -0,0 +1,668 @@
+// lsm_store.cpp
+#include "lsm_store.h"
+
+#include "reclaimer.h"
+#include "timestamp_codec.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+
+constexpr const char* kManifestTag = "lsm-manifest";
+constexpr unsigned kManifestVersion = 2;  // 2 added the "times" line
+
+[[noreturn]] void fatal(const std::string& what) {
+    std::cerr << "lsm: " << what << "; aborting" << std::endl;
+    std::abort();
+}
+
+}  // namespace
+
+/**
+ * @brief Merges memtables and runs into one ascending stream, newest entry per number
+ *
+ * @details Sources are added newest first; on equal numbers the source added earliest wins
+ *          and the older entries are skipped. Tombstones are passed through so compaction can
+ *          keep them; readers filter them out.
+ */
+class LsmStore::MergeReader {
+public:
+    void add(const Memtable& table, uint64_t from) {
+        Source source;
+        source.table = &table;
+        source.it = table.lower_bound(from);
+        push(std::move(source));
+    }
+
+    void add(const LsmRun& run, uint64_t from) {
+        Source source;
+        source.run = &run;
+        source.pos = run.lower_bound(from);
+        push(std::move(source));
+    }
+
+    /**
+     * @brief Produce the next number and its newest entry
+     * @return false once every source is exhausted
+     */
+    bool next(LsmRun::Entry& out) {
+        if (heap_.empty())
+            return false;
+        out = sources_[heap_.front().second].current;
+        do {
+            std::pop_heap(heap_.begin(), heap_.end(), std::greater<>());
+            size_t index = heap_.back().second;
+            heap_.pop_back();
+            if (advance(sources_[index]))
+                push_heap(index);
+        } while (!heap_.empty() && heap_.front().first == out.number);
+        return true;
+    }
+
+private:
+    struct Source {
+        const Memtable* table = nullptr;
+        Memtable::iterator it;
+        const LsmRun* run = nullptr;
+        size_t pos = 0;
+        LsmRun::Entry current{};
+    };
+
+    std::vector<Source> sources_;
+    std::vector<std::pair<uint64_t, size_t>> heap_;  // (number, source); min-heap, older source last
+
+    void push(Source source) {
+        sources_.push_back(std::move(source));
+        if (load(sources_.back()))
+            push_heap(sources_.size() - 1);
+    }
+
+    void push_heap(size_t index) {
+        heap_.emplace_back(sources_[index].current.number, index);
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<>());
+    }
+
+    static bool load(Source& source) {
+        if (source.table) {
+            if (source.it == source.table->end())
+                return false;
+            const MemValue& value = source.it.value();
+            source.current = {source.it.key(), TimestampCodec::decode(value.timestamp), value.deleted != 0};
+            return true;
+        }
+        if (source.pos == source.run->size())
+            return false;
+        source.current = source.run->entry(source.pos);
+        return true;
+    }
+
+    static bool advance(Source& source) {
+        if (source.table)
+            ++source.it;
+        else
+            ++source.pos;
+        return load(source);
+    }
+};
+
+LsmStore::LsmStore(LsmOptions options) : options_(std::move(options)), version_(std::make_shared<Version>()) {
+    std::filesystem::create_directories(options_.directory);
+    load_manifest();
+    worker_ = std::thread(&LsmStore::run_worker, this);
+}
+
+LsmStore::~LsmStore() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!active_.empty())
+            freeze_locked();
+        stopping_ = true;
+    }
+    work_.notify_all();
+    worker_.join();
+}
+
+std::pair<time_t, bool> LsmStore::insert(uint64_t number, time_t ts) {
+    std::lock_guard<std::mutex> stripe(stripe_for(number));
+    time_t existing;
+    if (lookup(number, existing) == Found::Live)
+        return {existing, false};
+    uint32_t offset = TimestampCodec::encode(ts);
+    write_memtable(number, {offset, 0}, +1);
+    return {TimestampCodec::decode(offset), true};
+}
+
+bool LsmStore::erase(uint64_t number) {
+    std::lock_guard<std::mutex> stripe(stripe_for(number));
+    time_t existing;
+    if (lookup(number, existing) != Found::Live)
+        return false;
+    write_memtable(number, {0, 1}, -1);
+    return true;
+}
+
+size_t LsmStore::read(uint64_t from, StoreEntry* out, size_t max) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    MergeReader merge;
+    merge.add(active_, from);
+    for (const Frozen& frozen : version_->frozen)
+        merge.add(*frozen.table, from);
+    for (const auto& run : version_->level0)
+        merge.add(*run, from);
+    for (const auto& run : version_->levels)
+        if (run)
+            merge.add(*run, from);
+
+    size_t n = 0;
+    LsmRun::Entry entry;
+    while (n < max && merge.next(entry))
+        if (!entry.deleted)
+            out[n++] = {entry.number, entry.timestamp};
+    return n;
+}
+
+size_t LsmStore::clear() {
+    // Hold every stripe so no insert or erase sits between its lookup and its memtable write;
+    // otherwise it would apply a count change and a notification decided before the clear.
+    std::unique_ptr<std::unique_lock<std::mutex>[]> stripes(new std::unique_lock<std::mutex>[kStripes]);
+    for (size_t i = 0; i < kStripes; ++i)
+        stripes[i] = std::unique_lock<std::mutex>(stripes_[i].mutex);
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t removed = count_;
+    std::shared_ptr<const Version> old = version_;
+    Reclaimer::global().retire(std::make_unique<Memtable>(std::move(active_)));
+    active_delta_ = 0;
+    version_ = std::make_shared<Version>();
+    count_ = 0;
+    flushed_count_ = 0;
+    oldest_ = newest_ = 0;
+    flushed_seq_ = frozen_seq_;  // the dropped memtables no longer need flushing
+    ++generation_;
+    write_manifest(*version_);
+    // Readers still holding the old version keep the mappings alive
+    for (const auto& run : old->level0)
+        ::unlink(run->path().c_str());
+    for (const auto& run : old->levels)
+        if (run)
+            ::unlink(run->path().c_str());
+    if (observer_)
+        observer_->on_clear_range(0, std::numeric_limits<uint64_t>::max());
+    changed_.notify_all();
+    // Frozen memtables go with the old version unless a reader still holds it
+    Reclaimer::global().retire(std::make_unique<std::shared_ptr<const Version>>(std::move(old)));
+    return removed;
+}
+
+size_t LsmStore::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
+
+StoreStats LsmStore::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StoreStats stats;
+    stats.count = count_;
+    stats.memory_bytes = allocator_stats_locked().reserved_bytes;
+    if (count_ == 0)
+        return stats;
+    stats.min = edge_locked(false).value_or(0);
+    stats.max = edge_locked(true).value_or(0);
+    stats.oldest = oldest_;
+    stats.newest = newest_;
+    return stats;
+}
+
+/**
+ * @brief Smallest (or largest) live number, without merging the layers
+ * @details Takes the extreme key of every layer past an exclusive limit, then resolves the
+ *          winner through the layers newest first; if its newest entry is a tombstone the
+ *          limit moves past it and the search repeats. Caller holds mutex_.
+ */
+std::optional<uint64_t> LsmStore::edge_locked(bool largest) const {
+    const Version& version = *version_;
+    std::optional<uint64_t> limit;
+    for (;;) {
+        std::optional<uint64_t> best;
+        auto offer = [&](uint64_t key) {
+            if (!best || (largest ? key > *best : key < *best))
+                best = key;
+        };
+        auto from_table = [&](const Memtable& table) {
+            if (largest) {
+                size_t k = limit ? table.rank(*limit) : table.size();
+                if (k > 0)
+                    offer(table.select(k - 1).key());
+                return;
+            }
+            auto it = limit ? table.lower_bound(*limit) : table.begin();
+            if (it != table.end() && limit && it.key() == *limit)
+                ++it;
+            if (it != table.end())
+                offer(it.key());
+        };
+        auto from_run = [&](const LsmRun& run) {
+            if (largest) {
+                size_t i = limit ? run.lower_bound(*limit) : run.size();
+                if (i > 0)
+                    offer(run.number(i - 1));
+                return;
+            }
+            size_t i = limit ? run.lower_bound(*limit) : 0;
+            if (i < run.size() && limit && run.number(i) == *limit)
+                ++i;
+            if (i < run.size())
+                offer(run.number(i));
+        };
+        from_table(active_);
+        for (const Frozen& frozen : version.frozen)
+            from_table(*frozen.table);
+        for (const auto& run : version.level0)
+            from_run(*run);
+        for (const auto& run : version.levels)
+            if (run)
+                from_run(*run);
+        if (!best)
+            return std::nullopt;
+
+        // The newest layer holding the candidate decides whether it is live
+        std::optional<bool> deleted;
+        auto in_table = [&](const Memtable& table) {
+            auto it = table.find(*best);
+            if (it != table.end())
+                deleted = it.value().deleted != 0;
+        };
+        LsmRun::Entry entry;
+        in_table(active_);
+        for (size_t i = 0; !deleted && i < version.frozen.size(); ++i)
+            in_table(*version.frozen[i].table);
+        for (size_t i = 0; !deleted && i < version.level0.size(); ++i)
+            if (version.level0[i]->find(*best, entry))
+                deleted = entry.deleted;
+        for (size_t i = 0; !deleted && i < version.levels.size(); ++i)
+            if (version.levels[i] && version.levels[i]->find(*best, entry))
+                deleted = entry.deleted;
+        if (!*deleted)
+            return best;
+        limit = best;
+    }
+}
+
+PoolStats LsmStore::allocator_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return allocator_stats_locked();
+}
+
+PoolStats LsmStore::allocator_stats_locked() const {
+    PoolStats total = active_.allocator_stats();
+    for (const Frozen& frozen : version_->frozen)
+        total += frozen.table->allocator_stats();
+    return total;
+}
+
+void LsmStore::flush_to_disk() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!active_.empty())
+        freeze_locked();
+    uint64_t target = frozen_seq_;
+    changed_.wait(lock, [&] { return flushed_seq_ >= target; });
+}
+
+std::optional<time_t> LsmStore::find(uint64_t number) const {
+    // Point lookup through the memtables and the Bloom filters of the runs, no merge
+    time_t ts;
+    if (lookup(number, ts) == Found::Live)
+        return ts;
+    return std::nullopt;
+}
+
+LsmStore::Found LsmStore::lookup(uint64_t number, time_t& ts) const {
+    std::shared_ptr<const Version> version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = active_.find(number);
+        if (it != active_.end()) {
+            ts = TimestampCodec::decode(it.value().timestamp);
+            return it.value().deleted ? Found::Deleted : Found::Live;
+        }
+        version = version_;
+    }
+    // Frozen tables and runs are immutable, so the rest of the search runs unlocked
+    for (const Frozen& frozen : version->frozen) {
+        auto it = frozen.table->find(number);
+        if (it != frozen.table->end()) {
+            ts = TimestampCodec::decode(it.value().timestamp);
+            return it.value().deleted ? Found::Deleted : Found::Live;
+        }
+    }
+    LsmRun::Entry entry;
+    auto probe = [&](const LsmRun& run) {
+        if (!run.find(number, entry))
+            return false;
+        ts = entry.timestamp;
+        return true;
+    };
+    for (const auto& run : version->level0)
+        if (probe(*run))
+            return entry.deleted ? Found::Deleted : Found::Live;
+    for (const auto& run : version->levels)
+        if (run && probe(*run))
+            return entry.deleted ? Found::Deleted : Found::Live;
+    return Found::Absent;
+}
+
+void LsmStore::write_memtable(uint64_t number, MemValue value, int64_t delta) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Back-pressure: wait for the flusher rather than queueing memtables without bound
+    changed_.wait(lock, [this] { return version_->frozen.size() < options_.max_immutable; });
+    auto slot = active_.try_emplace(number, value);
+    if (!slot.second)
+        slot.first.value() = value;
+    active_delta_ += delta;
+    if (!value.deleted) {
+        time_t ts = TimestampCodec::decode(value.timestamp);
+        oldest_ = count_ == 0 ? ts : std::min(oldest_, ts);
+        newest_ = count_ == 0 ? ts : std::max(newest_, ts);
+    }
+    count_ += delta;
+    if (count_ == 0)
+        oldest_ = newest_ = 0;
+    if (observer_) {
+        if (value.deleted)
+            observer_->on_erase(number);
+        else
+            observer_->on_insert(number, TimestampCodec::decode(value.timestamp));
+    }
+    if (active_.size() >= options_.memtable_entries)
+        freeze_locked();
+}
+
+void LsmStore::freeze_locked() {
+    auto next = std::make_shared<Version>(*version_);
+    next->frozen.insert(next->frozen.begin(),
+                        Frozen{std::make_shared<const Memtable>(std::move(active_)), active_delta_, ++frozen_seq_});
+    active_delta_ = 0;
+    version_ = std::move(next);
+    work_.notify_one();
+}
+
+void LsmStore::run_worker() {
+    std::unique_ptr<FileWriter> io = make_file_writer(options_.use_io_uring);
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        size_t level = 0;
+        work_.wait(lock, [&] {
+            return stopping_ || !version_->frozen.empty() || compaction_due(*version_, level);
+        });
+        std::shared_ptr<const Version> version = version_;
+        uint64_t generation = generation_;
+        uint64_t seq = next_run_;
+
+        // Compactions go first so level 0 stays short; writers queue up to max_immutable
+        // memtables meanwhile. On shutdown only the pending flushes are finished.
+        bool compacting = !stopping_ && compaction_due(*version, level);
+        if (!compacting) {
+            if (version->frozen.empty())
+                return;
+            Frozen oldest = version->frozen.back();
+            ++next_run_;
+            lock.unlock();
+            std::shared_ptr<const LsmRun> run;
+            try {
+                run = flush(*oldest.table, seq, *io);
+            } catch (const std::exception& e) {
+                fatal(std::string("flush failed: ") + e.what());
+            }
+            lock.lock();
+            if (generation != generation_) {
+                if (run)
+                    ::unlink(run->path().c_str());
+                continue;
+            }
+            // Only this thread removes frozen tables, so the oldest is still last
+            auto next = std::make_shared<Version>(*version_);
+            next->frozen.pop_back();
+            if (run)
+                next->level0.insert(next->level0.begin(), run);
+            flushed_count_ += oldest.delta;
+            flushed_seq_ = oldest.seq;
+            write_manifest(*next);
+            version_ = std::move(next);
+            changed_.notify_all();
+            continue;
+        }
+
+        // Compact level `level` into the level below it
+        std::vector<std::shared_ptr<const LsmRun>> inputs;
+        if (level == 0)
+            inputs = version->level0;
+        else
+            inputs.push_back(version->levels[level - 1]);
+        std::shared_ptr<const LsmRun> target = level < version->levels.size() ? version->levels[level] : nullptr;
+        if (target)
+            inputs.push_back(target);
+        bool bottom = true;
+        for (size_t i = level + 1; i < version->levels.size(); ++i)
+            bottom = bottom && !version->levels[i];
+        ++next_run_;
+        lock.unlock();
+        std::shared_ptr<const LsmRun> run;
+        try {
+            run = compact(inputs, bottom, seq, *io);
+        } catch (const std::exception& e) {
+            fatal(std::string("compaction failed: ") + e.what());
+        }
+        lock.lock();
+        if (generation != generation_) {
+            if (run)
+                ::unlink(run->path().c_str());
+            continue;
+        }
+        // Flushes only ever happen on this thread, so the levels are as we left them
+        auto next = std::make_shared<Version>(*version_);
+        if (level == 0)
+            next->level0.clear();
+        else
+            next->levels[level - 1] = nullptr;
+        if (next->levels.size() <= level)
+            next->levels.resize(level + 1);
+        next->levels[level] = run;
+        while (!next->levels.empty() && !next->levels.back())
+            next->levels.pop_back();
+        write_manifest(*next);
+        version_ = std::move(next);
+        for (const auto& input : inputs)
+            ::unlink(input->path().c_str());
+        changed_.notify_all();
+    }
+}
+
+bool LsmStore::compaction_due(const Version& version, size_t& level) const {
+    if (version.level0.size() >= options_.level0_runs) {
+        level = 0;
+        return true;
+    }
+    size_t limit = options_.level1_bytes;
+    for (size_t i = 0; i < version.levels.size(); ++i, limit *= options_.level_ratio) {
+        if (version.levels[i] && version.levels[i]->bytes() > limit) {
+            level = i + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<const LsmRun> LsmStore::flush(const Memtable& table, uint64_t seq, FileWriter& io) {
+    if (table.empty())
+        return nullptr;
+    std::string path = run_path(seq);
+    LsmRun::Writer writer(path, io, table.size());
+    for (auto it = table.begin(); it != table.end(); ++it)
+        writer.add(it.key(), TimestampCodec::decode(it.value().timestamp), it.value().deleted != 0);
+    writer.finish();
+    return LsmRun::open(path);
+}
+
+std::shared_ptr<const LsmRun> LsmStore::compact(const std::vector<std::shared_ptr<const LsmRun>>& inputs,
+                                                bool bottom, uint64_t seq, FileWriter& io) {
+    size_t expected = 0;
+    MergeReader merge;
+    for (const auto& run : inputs) {
+        expected += run->size();
+        merge.add(*run, 0);
+    }
+    std::string path = run_path(seq);
+    LsmRun::Writer writer(path, io, expected);
+    size_t written = 0;
+    LsmRun::Entry entry;
+    while (merge.next(entry)) {
+        // Nothing lies below the bottom level for a tombstone to hide
+        if (entry.deleted && bottom)
+            continue;
+        writer.add(entry.number, entry.timestamp, entry.deleted);
+        ++written;
+    }
+    if (written == 0)
+        return nullptr;  // the writer removes the empty file
+    writer.finish();
+    return LsmRun::open(path);
+}
+
+void LsmStore::write_manifest(const Version& version) const {
+    std::ostringstream text;
+    text << kManifestTag << ' ' << kManifestVersion << '\n';
+    text << "next-run " << next_run_ << '\n';
+    text << "count " << flushed_count_ << '\n';
+    text << "times " << oldest_ << ' ' << newest_ << '\n';
+    for (const auto& run : version.level0)
+        text << "run 0 " << std::filesystem::path(run->path()).filename().string() << '\n';
+    for (size_t i = 0; i < version.levels.size(); ++i)
+        if (version.levels[i])
+            text << "run " << i + 1 << ' ' << std::filesystem::path(version.levels[i]->path()).filename().string()
+                 << '\n';
+    std::string data = text.str();
+
+    // A torn MANIFEST would lose the whole store, so replace it atomically
+    std::string tmp = manifest_path() + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        fatal("create " + tmp + ": " + std::strerror(errno));
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            fatal("write " + tmp + ": " + std::strerror(errno));
+        done += static_cast<size_t>(n);
+    }
+    if (::fdatasync(fd) != 0)
+        fatal("fsync " + tmp + ": " + std::strerror(errno));
+    ::close(fd);
+    if (::rename(tmp.c_str(), manifest_path().c_str()) != 0)
+        fatal("rename " + tmp + ": " + std::strerror(errno));
+    int dir = ::open(options_.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir >= 0) {
+        ::fsync(dir);
+        ::close(dir);
+    }
+}
+
+void LsmStore::load_manifest() {
+    std::ifstream in(manifest_path());
+    std::vector<std::string> referenced;
+    if (in) {
+        std::string tag;
+        unsigned format = 0;
+        if (!(in >> tag >> format) || tag != kManifestTag)
+            throw std::runtime_error(manifest_path() + ": not an LSM manifest");
+        if (format != kManifestVersion && format != 1)
+            throw std::runtime_error(manifest_path() + ": unsupported manifest version " + std::to_string(format));
+        auto next = std::make_shared<Version>();
+        bool have_times = false;
+        std::string key;
+        while (in >> key) {
+            if (key == "next-run") {
+                in >> next_run_;
+            } else if (key == "count") {
+                in >> flushed_count_;
+            } else if (key == "times") {
+                in >> oldest_ >> newest_;
+                have_times = true;
+            } else if (key == "run") {
+                size_t level;
+                std::string name;
+                if (!(in >> level >> name))
+                    break;
+                auto run = LsmRun::open(options_.directory + "/" + name);
+                if (level == 0) {
+                    next->level0.push_back(std::move(run));
+                } else {
+                    if (next->levels.size() < level)
+                        next->levels.resize(level);
+                    next->levels[level - 1] = std::move(run);
+                }
+                referenced.push_back(name);
+            } else {
+                throw std::runtime_error(manifest_path() + ": unexpected '" + key + "'");
+            }
+            if (!in)
+                throw std::runtime_error(manifest_path() + ": malformed '" + key + "' line");
+        }
+        version_ = std::move(next);
+        if (!have_times && flushed_count_ > 0)
+            scan_times();  // version 1 manifests did not record the range
+    }
+    count_ = flushed_count_;
+    if (count_ == 0)
+        oldest_ = newest_ = 0;
+
+    // Runs written by an interrupted flush or compaction never made it into the manifest
+    for (const auto& file : std::filesystem::directory_iterator(options_.directory)) {
+        std::string name = file.path().filename().string();
+        bool is_run = name.rfind("run-", 0) == 0 && file.path().extension() == ".lsm";
+        if ((is_run && std::find(referenced.begin(), referenced.end(), name) == referenced.end()) ||
+            name == "MANIFEST.tmp")
+            std::filesystem::remove(file.path());
+    }
+}
+
+void LsmStore::scan_times() {
+    bool any = false;
+    auto visit = [&](const LsmRun& run) {
+        for (size_t i = 0; i < run.size(); ++i) {
+            LsmRun::Entry entry = run.entry(i);
+            if (entry.deleted)
+                continue;
+            oldest_ = any ? std::min(oldest_, entry.timestamp) : entry.timestamp;
+            newest_ = any ? std::max(newest_, entry.timestamp) : entry.timestamp;
+            any = true;
+        }
+    };
+    for (const auto& run : version_->level0)
+        visit(*run);
+    for (const auto& run : version_->levels)
+        if (run)
+            visit(*run);
+}
+
+std::string LsmStore::run_path(uint64_t seq) const {
+    char name[40];
+    std::snprintf(name, sizeof(name), "/run-%020llu.lsm", static_cast<unsigned long long>(seq));
+    return options_.directory + name;
+}
@@ -0,0 +1,169 @@
+// lsm_store.h
+#pragma once
+
+#include "btree.h"
+#include "lsm_run.h"
+#include "number_store.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Tuning knobs of the LSM-tree backend
+ */
+struct LsmOptions {
+    std::string directory;                       // where runs and the manifest live
+    size_t memtable_entries = size_t{1} << 20;   // freeze the memtable at this many entries
+    size_t max_immutable = 4;                    // writers stall while this many await flushing
+    size_t level0_runs = 4;                      // compact level 0 into level 1 at this many runs
+    size_t level1_bytes = size_t{64} << 20;      // size limit of level 1
+    size_t level_ratio = 10;                     // each deeper level may be this much larger
+    bool use_io_uring = true;
+};
+
+/**
+ * @brief Log-structured merge tree for sets larger than memory
+ *
+ * @details Mutations go to an in-memory B+tree memtable; deletes are recorded as tombstones.
+ *          A full memtable is frozen and a background thread writes it out as a sorted
+ *          LsmRun (block index, Bloom filter) in level 0. The same thread compacts leveled:
+ *          each level from 1 down is a single sorted run, level 0 is merged into level 1 once
+ *          it holds level0_runs runs, and level i into level i+1 once it outgrows its limit
+ *          (level1_bytes times level_ratio^(i-1)). Tombstones are dropped when they reach
+ *          the deepest level. Runs are memory-mapped, so the page cache, not the heap, holds
+ *          the data.
+ *
+ *          Insert and Delete must know whether the number exists, so each one looks it up
+ *          from the newest layer to the oldest (the Bloom filters skip most runs) under a
+ *          per-number stripe lock, then writes the memtable under the store lock; clear()
+ *          takes every stripe lock so it never lands between the two. read() is a k-way
+ *          merge over the memtables and every run, where the newest entry for a number wins
+ *          and tombstones hide older entries. There are no range tombstones: erase_range()
+ *          is the default read-then-erase loop, one tombstone per number removed.
+ *
+ *          The set of runs is recorded in a MANIFEST file rewritten atomically after every
+ *          flush and compaction, so the store reopens with everything flushed; memtable
+ *          contents are only as durable as the write-ahead log in front of the store.
+ *
+ *          stats() never merges the layers: the count is kept up to date, the number bounds
+ *          are the edge keys of each layer checked against the newer ones (one more step per
+ *          tombstoned edge still awaiting compaction), and the insertion-time range is widened
+ *          by every insert, kept in the manifest and only reset when the store empties, so it
+ *          bounds the stored times rather than matching them exactly.
+ */
+class LsmStore final : public NumberStore {
+public:
+    /**
+     * @brief Open (or create) the store in options.directory
+     * @throws std::system_error or std::runtime_error if the directory or a run cannot be read
+     */
+    explicit LsmStore(LsmOptions options);
+
+    /**
+     * @brief Flush the memtable and stop the background thread
+     */
+    ~LsmStore() override;
+
+    LsmStore(const LsmStore&) = delete;
+    LsmStore& operator=(const LsmStore&) = delete;
+
+    std::pair<time_t, bool> insert(uint64_t number, time_t ts) override;
+    bool erase(uint64_t number) override;
+    std::optional<time_t> find(uint64_t number) const override;
+    size_t read(uint64_t from, StoreEntry* out, size_t max) const override;
+    size_t clear() override;
+    size_t size() const override;
+    StoreStats stats() const override;
+    PoolStats allocator_stats() const override;
+    bool persistent() const override { return true; }
+    void flush_to_disk() override;
+
+private:
+    static constexpr size_t kStripes = 64;
+
+    /**
+     * @brief Memtable value: encoded timestamp plus tombstone flag
+     */
+    struct MemValue {
+        uint32_t timestamp;
+        uint32_t deleted;
+    };
+    using Memtable = BPlusTree<uint64_t, MemValue>;
+
+    /**
+     * @brief A frozen memtable waiting to be flushed
+     */
+    struct Frozen {
+        std::shared_ptr<const Memtable> table;
+        int64_t delta;  // change in live entries it carries
+        uint64_t seq;   // freeze order
+    };
+
+    /**
+     * @brief Immutable description of every layer below the active memtable
+     */
+    struct Version {
+        std::vector<Frozen> frozen;                          // newest first
+        std::vector<std::shared_ptr<const LsmRun>> level0;   // newest first
+        std::vector<std::shared_ptr<const LsmRun>> levels;   // levels[i] is level i+1; may be null
+    };
+
+    /**
+     * @brief State of a number in some layer
+     */
+    enum class Found { Absent, Live, Deleted };
+
+    struct alignas(64) Stripe {
+        std::mutex mutex;
+    };
+
+    class MergeReader;
+
+    LsmOptions options_;
+
+    mutable std::mutex mutex_;  // guards everything below
+    std::condition_variable work_;     // wakes the background thread
+    std::condition_variable changed_;  // a flush or compaction finished
+    Memtable active_;
+    int64_t active_delta_ = 0;
+    std::shared_ptr<const Version> version_;
+    size_t count_ = 0;           // live entries
+    size_t flushed_count_ = 0;   // live entries as of the runs alone
+    time_t oldest_ = 0;          // insertion-time bounds of every insert since the store was empty
+    time_t newest_ = 0;
+    uint64_t next_run_ = 1;      // sequence number of the next run file
+    uint64_t frozen_seq_ = 0;    // memtables frozen so far
+    uint64_t flushed_seq_ = 0;   // memtables flushed so far
+    uint64_t generation_ = 0;    // bumped by clear(); stale background output is discarded
+    bool stopping_ = false;
+
+    std::unique_ptr<Stripe[]> stripes_{new Stripe[kStripes]};
+    std::thread worker_;
+
+    std::mutex& stripe_for(uint64_t number) { return stripes_[(number * 0x9E3779B97F4A7C15ull) >> 58].mutex; }
+
+    Found lookup(uint64_t number, time_t& ts) const;
+    std::optional<uint64_t> edge_locked(bool largest) const;
+    PoolStats allocator_stats_locked() const;
+    void write_memtable(uint64_t number, MemValue value, int64_t delta);
+    void freeze_locked();
+    void run_worker();
+    bool compaction_due(const Version& version, size_t& level) const;
+    std::shared_ptr<const LsmRun> flush(const Memtable& table, uint64_t seq, FileWriter& io);
+    std::shared_ptr<const LsmRun> compact(const std::vector<std::shared_ptr<const LsmRun>>& inputs, bool bottom,
+                                          uint64_t seq, FileWriter& io);
+    void write_manifest(const Version& version) const;
+    void load_manifest();
+    void scan_times();
+    std::string run_path(uint64_t seq) const;
+    std::string manifest_path() const { return options_.directory + "/MANIFEST"; }
+};
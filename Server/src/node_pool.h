@@ -0,0 +1,197 @@
+// node_pool.h
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Allocation statistics of one or more node pools
+ */
+struct PoolStats {
+    std::size_t slabs = 0;           // slabs obtained from the system allocator
+    std::size_t reserved_bytes = 0;  // bytes held in those slabs
+    std::size_t live_blocks = 0;     // blocks currently handed out
+    std::size_t live_bytes = 0;      // bytes of the live blocks
+    std::size_t free_blocks = 0;     // blocks carved out of slabs and waiting on free lists
+
+    PoolStats& operator+=(const PoolStats& other) {
+        slabs += other.slabs;
+        reserved_bytes += other.reserved_bytes;
+        live_blocks += other.live_blocks;
+        live_bytes += other.live_bytes;
+        free_blocks += other.free_blocks;
+        return *this;
+    }
+
+    /**
+     * @brief Share of reserved memory occupied by live blocks (1.0 = no fragmentation)
+     */
+    double utilization() const {
+        return reserved_bytes ? static_cast<double>(live_bytes) / static_cast<double>(reserved_bytes) : 1.0;
+    }
+};
+
+/**
+ * @brief Fixed-size block allocator for tree nodes
+ *
+ * @details Blocks are carved from slabs and recycled through an intrusive free list, so
+ *          steady-state inserts and erases never reach the global allocator. Slabs start at a
+ *          few blocks and double up to the slab size, keeping small pools small. Slabs are
+ *          only returned to the system by release(), which drops every block at once; owners
+ *          use it to clear a whole structure without visiting its nodes. Retired pools can
+ *          also be returned a few slabs at a time with release_some().
+ *
+ * @note Not thread-safe; each pool belongs to one structure guarded by its owner's lock.
+ */
+class NodePool {
+public:
+    static constexpr std::size_t kDefaultSlabBytes = 64 * 1024;
+    static constexpr std::size_t kFirstSlabBlocks = 4;
+
+    /**
+     * @brief Construct an empty pool
+     * @param block_size Bytes per block
+     * @param block_align Alignment of every block
+     * @param slab_bytes Largest slab size; a slab always holds at least one block
+     */
+    explicit NodePool(std::size_t block_size, std::size_t block_align = alignof(std::max_align_t),
+                      std::size_t slab_bytes = kDefaultSlabBytes)
+        : align_(std::max(block_align, alignof(FreeBlock))),
+          block_size_(round_up(std::max(block_size, sizeof(FreeBlock)), align_)),
+          blocks_per_slab_(std::max<std::size_t>(slab_bytes / block_size_, 1)) {}
+
+    ~NodePool() { release(); }
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    void swap(NodePool& other) noexcept {
+        std::swap(align_, other.align_);
+        std::swap(block_size_, other.block_size_);
+        std::swap(blocks_per_slab_, other.blocks_per_slab_);
+        std::swap(next_slab_blocks_, other.next_slab_blocks_);
+        std::swap(reserved_, other.reserved_);
+        slabs_.swap(other.slabs_);
+        std::swap(free_, other.free_);
+        std::swap(free_count_, other.free_count_);
+        std::swap(bump_, other.bump_);
+        std::swap(bump_left_, other.bump_left_);
+        std::swap(live_, other.live_);
+    }
+
+    /**
+     * @brief Hand out one uninitialized block
+     */
+    void* allocate() {
+        ++live_;
+        if (free_) {
+            FreeBlock* block = free_;
+            free_ = block->next;
+            --free_count_;
+            return block;
+        }
+        if (!bump_left_) {
+            std::size_t blocks = std::min(next_slab_blocks_, blocks_per_slab_);
+            bump_ = static_cast<char*>(::operator new(blocks * block_size_, std::align_val_t(align_)));
+            bump_left_ = blocks;
+            slabs_.push_back(bump_);
+            reserved_ += blocks * block_size_;
+            next_slab_blocks_ = blocks * 2;
+        }
+        void* block = bump_;
+        bump_ += block_size_;
+        --bump_left_;
+        return block;
+    }
+
+    /**
+     * @brief Return a block obtained from allocate(); the object in it must already be destroyed
+     */
+    void deallocate(void* p) {
+        FreeBlock* block = static_cast<FreeBlock*>(p);
+        block->next = free_;
+        free_ = block;
+        ++free_count_;
+        --live_;
+    }
+
+    /**
+     * @brief Give every slab back to the system; all outstanding blocks become invalid
+     */
+    void release() {
+        for (void* slab : slabs_)
+            ::operator delete(slab, std::align_val_t(align_));
+        slabs_.clear();
+        slabs_.shrink_to_fit();
+        free_ = nullptr;
+        free_count_ = 0;
+        bump_ = nullptr;
+        bump_left_ = 0;
+        live_ = 0;
+        reserved_ = 0;
+        next_slab_blocks_ = kFirstSlabBlocks;
+    }
+
+    /**
+     * @brief Give back the newest slabs until about `bytes` were released
+     * @details For retired pools freed in the background (see Reclaimer): outstanding blocks
+     *          become invalid and the pool must not allocate again, only be released further.
+     * @return Bytes released; less than requested means the pool holds no slabs any more
+     */
+    std::size_t release_some(std::size_t bytes) {
+        std::size_t released = 0;
+        while (released < bytes && !slabs_.empty()) {
+            std::size_t size = slab_blocks(slabs_.size() - 1) * block_size_;
+            ::operator delete(slabs_.back(), std::align_val_t(align_));
+            slabs_.pop_back();
+            released += size;
+            reserved_ -= size;
+        }
+        free_ = nullptr;
+        free_count_ = 0;
+        bump_ = nullptr;
+        bump_left_ = 0;
+        live_ = 0;
+        return released;
+    }
+
+    PoolStats stats() const {
+        PoolStats s;
+        s.slabs = slabs_.size();
+        s.reserved_bytes = reserved_;
+        s.live_blocks = live_;
+        s.live_bytes = live_ * block_size_;
+        s.free_blocks = free_count_;
+        return s;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    std::size_t align_;
+    std::size_t block_size_;
+    std::size_t blocks_per_slab_;
+    std::size_t next_slab_blocks_ = kFirstSlabBlocks;
+    std::size_t reserved_ = 0;
+    std::vector<void*> slabs_;
+    FreeBlock* free_ = nullptr;
+    std::size_t free_count_ = 0;
+    char* bump_ = nullptr;  // uncarved tail of the newest slab
+    std::size_t bump_left_ = 0;
+    std::size_t live_ = 0;
+
+    static std::size_t round_up(std::size_t n, std::size_t align) { return (n + align - 1) / align * align; }
+
+    // Blocks in slab i: sizes double from kFirstSlabBlocks up to blocks_per_slab_
+    std::size_t slab_blocks(std::size_t i) const {
+        std::size_t blocks = kFirstSlabBlocks;
+        while (i-- > 0 && blocks < blocks_per_slab_)
+            blocks *= 2;
+        return std::min(blocks, blocks_per_slab_);
+    }
+};
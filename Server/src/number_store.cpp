@@ -0,0 +1,181 @@
+// number_store.cpp
+#include "number_store.h"
+
+#include "art_index.h"
+#include "hash_index.h"
+#include "lsm_store.h"
+#include "roaring_index.h"
+#include "sharded_store.h"
+#include "skiplist_store.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+/**
+ * @brief Snapshot fallback that reads through to the live store
+ */
+class LiveSnapshot final : public StoreSnapshot {
+public:
+    explicit LiveSnapshot(const NumberStore& store) : store_(store) {}
+
+    size_t read(uint64_t from, StoreEntry* out, size_t max) const override { return store_.read(from, out, max); }
+    uint64_t version() const override { return 0; }
+
+private:
+    const NumberStore& store_;
+};
+
+}  // namespace
+
+std::unique_ptr<StoreSnapshot> NumberStore::snapshot() const {
+    return std::make_unique<LiveSnapshot>(*this);
+}
+
+size_t NumberStore::insert_batch(const uint64_t* numbers, size_t count, time_t ts, uint8_t* inserted) {
+    std::fill(inserted, inserted + (count + 7) / 8, 0);
+    size_t n = 0;
+    for (uint32_t i : batch_order(numbers, count)) {
+        if (insert(numbers[i], ts).second) {
+            inserted[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+            ++n;
+        }
+    }
+    return n;
+}
+
+size_t NumberStore::erase_batch(const uint64_t* numbers, size_t count, uint8_t* erased) {
+    std::fill(erased, erased + (count + 7) / 8, 0);
+    size_t n = 0;
+    for (uint32_t i : batch_order(numbers, count)) {
+        if (erase(numbers[i])) {
+            erased[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+            ++n;
+        }
+    }
+    return n;
+}
+
+size_t NumberStore::erase_range(uint64_t lo, uint64_t hi) {
+    uint64_t chunk[kReadChunk];
+    size_t removed = 0;
+    while (lo <= hi) {
+        size_t n = read_numbers(lo, chunk, kReadChunk);
+        for (size_t i = 0; i < n && chunk[i] <= hi; ++i)
+            removed += erase(chunk[i]);
+        if (n < kReadChunk || chunk[n - 1] >= hi)
+            break;
+        lo = chunk[n - 1] + 1;
+    }
+    return removed;
+}
+
+size_t NumberStore::erase_inserted_before(time_t ts) {
+    StoreEntry chunk[kReadChunk];
+    uint64_t from = 0;
+    size_t removed = 0;
+    for (;;) {
+        size_t n = read(from, chunk, kReadChunk);
+        for (size_t i = 0; i < n; ++i)
+            if (chunk[i].timestamp < ts)
+                removed += erase(chunk[i].number);
+        if (n < kReadChunk || chunk[n - 1].number == std::numeric_limits<uint64_t>::max())
+            return removed;
+        from = chunk[n - 1].number + 1;
+    }
+}
+
+std::optional<time_t> NumberStore::find(uint64_t number) const {
+    StoreEntry entry;
+    if (read(number, &entry, 1) == 1 && entry.number == number)
+        return entry.timestamp;
+    return std::nullopt;
+}
+
+size_t NumberStore::find_batch(const uint64_t* numbers, size_t count, time_t* timestamps, uint8_t* found) const {
+    std::fill(found, found + (count + 7) / 8, 0);
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+        std::optional<time_t> ts = find(numbers[i]);
+        timestamps[i] = ts.value_or(0);
+        if (ts) {
+            found[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+            ++n;
+        }
+    }
+    return n;
+}
+
+size_t NumberStore::rank(uint64_t number) const {
+    uint64_t chunk[kReadChunk];
+    uint64_t from = 0;
+    size_t below = 0;
+    for (;;) {
+        size_t n = read_numbers(from, chunk, kReadChunk);
+        size_t i = std::lower_bound(chunk, chunk + n, number) - chunk;
+        below += i;
+        if (i < n || n < kReadChunk)
+            return below;
+        from = chunk[n - 1] + 1;
+    }
+}
+
+std::optional<StoreEntry> NumberStore::select(uint64_t k) const {
+    StoreEntry chunk[kReadChunk];
+    uint64_t from = 0;
+    for (;;) {
+        size_t n = read(from, chunk, kReadChunk);
+        if (k < n)
+            return chunk[k];
+        if (n < kReadChunk || chunk[n - 1].number == std::numeric_limits<uint64_t>::max())
+            return std::nullopt;
+        k -= n;
+        from = chunk[n - 1].number + 1;
+    }
+}
+
+StoreStats NumberStore::stats() const {
+    StoreStats stats;
+    for_each_entry(*this, [&](uint64_t number, time_t ts) {
+        stats.min = stats.count ? stats.min : number;
+        stats.max = number;
+        stats.oldest = stats.count ? std::min(stats.oldest, ts) : ts;
+        stats.newest = stats.count ? std::max(stats.newest, ts) : ts;
+        ++stats.count;
+    });
+    stats.memory_bytes = allocator_stats().reserved_bytes;
+    return stats;
+}
+
+std::vector<uint32_t> batch_order(const uint64_t* numbers, size_t count) {
+    std::vector<uint32_t> order(count);
+    for (size_t i = 0; i < count; ++i)
+        order[i] = static_cast<uint32_t>(i);
+    if (std::is_sorted(numbers, numbers + count))
+        return order;  // presorted batches (e.g. from BulkIngest) skip the sort
+    std::stable_sort(order.begin(), order.end(), [numbers](uint32_t a, uint32_t b) { return numbers[a] < numbers[b]; });
+    return order;
+}
+
+std::unique_ptr<NumberStore> make_number_store(const StoreOptions& options) {
+    // The index would more than triple roaring's footprint, so roaring only builds it on request
+    bool expiry_index = options.expiry_index.value_or(options.backend != "roaring");
+    if (options.backend == "btree")
+        return std::make_unique<ShardedStore<BtreeIndex>>(options.shard_count, options.key_space, expiry_index);
+    if (options.backend == "roaring")
+        return std::make_unique<ShardedStore<RoaringIndex>>(options.shard_count, options.key_space, expiry_index);
+    if (options.backend == "art")
+        return std::make_unique<ShardedStore<ArtIndex>>(options.shard_count, options.key_space, expiry_index);
+    if (options.backend == "hash")
+        return std::make_unique<ShardedStore<HashIndex>>(options.shard_count, options.key_space, expiry_index);
+    if (options.backend == "skiplist")
+        return std::make_unique<SkipListStore>();
+    if (options.backend == "lsm") {
+        LsmOptions lsm;
+        lsm.directory = options.directory;
+        lsm.use_io_uring = options.use_io_uring;
+        return std::make_unique<LsmStore>(std::move(lsm));
+    }
+    return nullptr;
+}
@@ -0,0 +1,384 @@
+// number_store.h
+#pragma once
+
+#include "node_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief One stored number with its insertion timestamp
+ */
+struct StoreEntry {
+    uint64_t number;
+    time_t timestamp;
+};
+
+/**
+ * @brief Summary of a store's contents (see NumberStore::stats)
+ */
+struct StoreStats {
+    uint64_t count = 0;
+    uint64_t min = 0;          // smallest stored number, 0 when empty
+    uint64_t max = 0;          // largest stored number, 0 when empty
+    time_t oldest = 0;         // earliest insertion time of a stored number, 0 when empty
+    time_t newest = 0;         // latest insertion time of a stored number, 0 when empty
+    size_t memory_bytes = 0;   // bytes reserved by the backend's allocators
+};
+
+/**
+ * @brief Entries per chunk when walking a whole set through read()
+ */
+constexpr size_t kStoreReadChunk = 1024;
+
+/**
+ * @brief Visit every entry of a chunked reader in ascending order
+ * @param reader Anything with read(from, out, max) (NumberStore, StoreSnapshot)
+ * @param fn Callable invoked as fn(number, timestamp)
+ */
+template <typename Reader, typename Fn>
+void for_each_entry(const Reader& reader, Fn&& fn) {
+    StoreEntry chunk[kStoreReadChunk];
+    uint64_t from = 0;
+    for (;;) {
+        size_t n = reader.read(from, chunk, kStoreReadChunk);
+        for (size_t i = 0; i < n; ++i)
+            fn(chunk[i].number, chunk[i].timestamp);
+        if (n < kStoreReadChunk || chunk[n - 1].number == std::numeric_limits<uint64_t>::max())
+            return;
+        from = chunk[n - 1].number + 1;
+    }
+}
+
+/**
+ * @brief Read-only point-in-time view of a NumberStore
+ *
+ * @details Reads see exactly the entries present when the snapshot was taken, however the
+ *          store changes meanwhile, and never block writers for longer than one chunk.
+ *          Release the snapshot promptly: the store keeps the history it needs until then.
+ */
+class StoreSnapshot {
+public:
+    virtual ~StoreSnapshot() = default;
+
+    /**
+     * @brief Copy entries with number >= from in ascending order, as of the snapshot
+     * @param from Smallest number of interest
+     * @param out Destination buffer
+     * @param max Capacity of out
+     * @return Entries written; fewer than max means the end of the set was reached
+     */
+    virtual size_t read(uint64_t from, StoreEntry* out, size_t max) const = 0;
+
+    /**
+     * @brief Store version the snapshot reflects (number of mutations applied before it)
+     */
+    virtual uint64_t version() const = 0;
+
+    /**
+     * @brief Visit every entry of the snapshot in ascending order
+     * @param fn Callable invoked as fn(number, timestamp)
+     */
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        for_each_entry(*this, std::forward<Fn>(fn));
+    }
+};
+
+/**
+ * @brief Receives every successful mutation of a NumberStore
+ *
+ * @details Called synchronously while the store still serializes the affected keys (under
+ *          the shard lock, or a key stripe lock for the skip list), so the observed order of
+ *          changes to any one number matches the order they were applied in. Implementations
+ *          must be quick and must not call back into the store.
+ */
+class MutationObserver {
+public:
+    virtual ~MutationObserver() = default;
+
+    /**
+     * @brief A new number was stored
+     * @param number Inserted number
+     * @param ts Timestamp as stored
+     */
+    virtual void on_insert(uint64_t number, time_t ts) = 0;
+
+    /**
+     * @brief A number was removed
+     * @param number Removed number
+     */
+    virtual void on_erase(uint64_t number) = 0;
+
+    /**
+     * @brief Every number in [lo, hi] was removed
+     * @param lo Smallest removed number
+     * @param hi Largest removed number
+     */
+    virtual void on_clear_range(uint64_t lo, uint64_t hi) = 0;
+};
+
+/**
+ * @brief Storage backend behind NumberServiceImpl
+ *
+ * @details Every implementation is internally synchronized and keeps numbers unique and
+ *          ordered. Ordered reads are chunked: read() copies a bounded run of entries
+ *          starting at a given number, so callers never need a lock spanning the whole set.
+ */
+class NumberStore {
+public:
+    virtual ~NumberStore() = default;
+
+    /**
+     * @brief Insert a number unless it already exists
+     * @param number Number to insert
+     * @param ts Timestamp stored when the number is new
+     * @return Stored timestamp (existing one on duplicates) and whether an insertion happened
+     */
+    virtual std::pair<time_t, bool> insert(uint64_t number, time_t ts) = 0;
+
+    /**
+     * @brief Remove a number
+     * @param number Number to remove
+     * @return true if the number was present
+     */
+    virtual bool erase(uint64_t number) = 0;
+
+    /**
+     * @brief Insert many numbers with one timestamp
+     * @details Numbers are applied in ascending order (a repeated number counts once, for its
+     *          first occurrence). The default runs insert() per number; sharded backends lock
+     *          each shard once per batch.
+     * @param numbers Numbers to insert, in any order
+     * @param count Length of numbers
+     * @param ts Timestamp stored for the new numbers
+     * @param inserted Bitmap of (count + 7) / 8 bytes; bit i (LSB first) is set if numbers[i]
+     *                 was inserted
+     * @return Number of insertions
+     */
+    virtual size_t insert_batch(const uint64_t* numbers, size_t count, time_t ts, uint8_t* inserted);
+
+    /**
+     * @brief Remove many numbers
+     * @param numbers Numbers to remove, in any order
+     * @param count Length of numbers
+     * @param erased Bitmap of (count + 7) / 8 bytes; bit i is set if numbers[i] was removed
+     * @return Number of removals
+     */
+    virtual size_t erase_batch(const uint64_t* numbers, size_t count, uint8_t* erased);
+
+    /**
+     * @brief Remove every number in [lo, hi]
+     * @details The default reads the range chunk by chunk and erases what it finds, so it
+     *          costs O(removed * log n). Sharded backends drop shards that lie wholly inside
+     *          the range by swapping in an empty index, like clear().
+     * @param lo Smallest number to remove
+     * @param hi Largest number to remove
+     * @return Number of entries removed
+     */
+    virtual size_t erase_range(uint64_t lo, uint64_t hi);
+
+    /**
+     * @brief Remove every number inserted strictly before ts
+     * @details The default walks the whole store. Sharded backends skip shards with nothing
+     *          old enough and drop wholly expired ones; with the expiry index (on by default
+     *          except for roaring) they visit only the numbers that expire, without it they
+     *          walk every shard that expires in part.
+     * @param ts Cutoff; numbers whose timestamp is older are removed
+     * @return Number of entries removed
+     */
+    virtual size_t erase_inserted_before(time_t ts);
+
+    /**
+     * @brief Look up one number without changing the store
+     * @details Never takes a lock exclusively: sharded backends hold the shard lock shared,
+     *          so lookups run in parallel with each other and only wait for writers. The
+     *          default goes through read().
+     * @param number Number to look up
+     * @return Its timestamp, or nullopt if it is not stored
+     */
+    virtual std::optional<time_t> find(uint64_t number) const;
+
+    /**
+     * @brief Look up many numbers
+     * @details Sharded backends look the batch up in ascending order, holding each shard's
+     *          lock shared once for its part of the batch.
+     * @param numbers Numbers to look up, in any order
+     * @param count Length of numbers
+     * @param timestamps count entries; timestamps[i] is set if numbers[i] is stored, else 0
+     * @param found Bitmap of (count + 7) / 8 bytes; bit i is set if numbers[i] is stored
+     * @return Number of lookups that found their number
+     */
+    virtual size_t find_batch(const uint64_t* numbers, size_t count, time_t* timestamps, uint8_t* found) const;
+
+    /**
+     * @brief Count the stored numbers smaller than a number
+     * @details The btree backend answers from subtree counts in O(shards + log n); other
+     *          sharded backends count within the one shard the number falls in. The default
+     *          walks the store up to the number.
+     * @param number Any number, stored or not
+     */
+    virtual size_t rank(uint64_t number) const;
+
+    /**
+     * @brief Entry at a position in ascending order
+     * @details Found like rank(): whole shards are skipped by their size. The default walks
+     *          the store.
+     * @param k Position, 0 for the smallest number
+     * @return The entry, or nullopt if k >= size()
+     */
+    virtual std::optional<StoreEntry> select(uint64_t k) const;
+
+    /**
+     * @brief Copy entries with number >= from in ascending order
+     * @param from Smallest number of interest
+     * @param out Destination buffer
+     * @param max Capacity of out
+     * @return Entries written; fewer than max means the end of the set was reached
+     */
+    virtual size_t read(uint64_t from, StoreEntry* out, size_t max) const = 0;
+
+    /**
+     * @brief Copy numbers >= from in ascending order, without their timestamps
+     * @details Backends with a columnar layout override this to stream the number column
+     *          alone; the default goes through read().
+     * @param from Smallest number of interest
+     * @param out Destination buffer
+     * @param max Capacity of out
+     * @return Numbers written; fewer than max means the end of the set was reached
+     */
+    virtual size_t read_numbers(uint64_t from, uint64_t* out, size_t max) const {
+        StoreEntry chunk[kReadChunk];
+        size_t n = 0;
+        while (n < max) {
+            size_t want = std::min(max - n, kReadChunk);
+            size_t got = read(from, chunk, want);
+            for (size_t i = 0; i < got; ++i)
+                out[n++] = chunk[i].number;
+            if (got < want || chunk[got - 1].number == std::numeric_limits<uint64_t>::max())
+                break;
+            from = chunk[got - 1].number + 1;
+        }
+        return n;
+    }
+
+    /**
+     * @brief Remove every number
+     * @return Number of entries removed
+     */
+    virtual size_t clear() = 0;
+
+    /**
+     * @brief Number of stored entries
+     */
+    virtual size_t size() const = 0;
+
+    /**
+     * @brief Take a point-in-time view of the store
+     * @details The default serves reads straight from the live store, which is consistent
+     *          per chunk only; backends with multi-version support override it.
+     * @return Snapshot valid until released; must not outlive the store
+     */
+    virtual std::unique_ptr<StoreSnapshot> snapshot() const;
+
+    /**
+     * @brief Count, number bounds, insertion-time range and memory of the store
+     * @details The sharded backends keep these up to date on every mutation and answer in
+     *          O(shards) without taking a lock; skiplist, lsm and a loading LayeredStore keep
+     *          their own counters and report an insertion-time range that may be wider than
+     *          the stored times. The default walks the whole store.
+     */
+    virtual StoreStats stats() const;
+
+    /**
+     * @brief Memory statistics of the backend's node allocators
+     * @return Totals over every pool; all zero for backends using the global allocator
+     */
+    virtual PoolStats allocator_stats() const { return {}; }
+
+    /**
+     * @brief Whether the backend keeps its own data on disk
+     * @details A persistent store is checkpointed by flush_to_disk() instead of a snapshot file.
+     */
+    virtual bool persistent() const { return false; }
+
+    /**
+     * @brief Make every mutation applied so far durable in the backend's own files
+     * @details Only meaningful for persistent stores; blocks until the data is on disk.
+     */
+    virtual void flush_to_disk() {}
+
+    /**
+     * @brief Attach the observer told about every later mutation
+     * @param observer Observer, or nullptr to detach; must be set before the store is shared
+     */
+    void set_observer(MutationObserver* observer) { observer_ = observer; }
+
+    /**
+     * @brief Visit every entry in ascending order, one read() chunk at a time
+     * @param fn Callable invoked as fn(number, timestamp)
+     */
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        for_each_entry(*this, std::forward<Fn>(fn));
+    }
+
+    /**
+     * @brief Visit every number in ascending order, one read_numbers() chunk at a time
+     * @param fn Callable invoked as fn(number)
+     */
+    template <typename Fn>
+    void for_each_number(Fn&& fn) const {
+        uint64_t chunk[kReadChunk];
+        uint64_t from = 0;
+        for (;;) {
+            size_t n = read_numbers(from, chunk, kReadChunk);
+            for (size_t i = 0; i < n; ++i)
+                fn(chunk[i]);
+            if (n < kReadChunk || chunk[n - 1] == std::numeric_limits<uint64_t>::max())
+                return;
+            from = chunk[n - 1] + 1;
+        }
+    }
+
+    static constexpr size_t kReadChunk = kStoreReadChunk;
+
+protected:
+    MutationObserver* observer_ = nullptr;
+};
+
+/**
+ * @brief Backend selection and tuning knobs
+ */
+struct StoreOptions {
+    std::string backend = "btree";  // btree | skiplist | roaring | art | hash | lsm
+    size_t shard_count = 16;
+    uint64_t key_space = std::numeric_limits<uint64_t>::max();
+    std::optional<bool> expiry_index;  // sharded: list numbers by insertion second for erase_inserted_before;
+                                       // unset = on, except for roaring
+    std::string directory;          // lsm: where runs are kept (required)
+    bool use_io_uring = true;       // lsm: write runs through io_uring when available
+};
+
+/**
+ * @brief Positions of a batch sorted by number, ties in input order
+ * @details Shared by the batch implementations: walking a batch in this order touches each
+ *          shard once and each index in key order. Already sorted batches cost one pass.
+ */
+std::vector<uint32_t> batch_order(const uint64_t* numbers, size_t count);
+
+/**
+ * @brief Build the backend named in the options
+ * @param options Store configuration
+ * @return The store, or nullptr if the backend name is unknown
+ * @throws std::system_error or std::runtime_error if an lsm directory cannot be opened
+ */
+std::unique_ptr<NumberStore> make_number_store(const StoreOptions& options);
@@ -0,0 +1,111 @@
+// ordered_lanes.h
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Runs keyed operations on a few worker threads, in order per key
+ *
+ * @details Each operation goes to the lane its key hashes to. A lane handles its operations
+ *          strictly in submission order, so two operations on the same key never overtake
+ *          each other, while operations on different lanes run in parallel. A lane drains
+ *          everything queued at once and passes it to the handler as one batch, which lets
+ *          the handler amortize per-batch work such as a log commit. Each lane queues at most
+ *          `depth` operations; submit() blocks while the target lane is full.
+ *
+ * @note submit() and finish() must be called from one thread.
+ */
+template <typename Op>
+class OrderedLanes {
+public:
+    using Handler = std::function<void(std::vector<Op>& batch)>;
+
+    /**
+     * @brief Start the lane threads
+     * @param lanes Number of lanes (threads), at least one
+     * @param depth Most operations queued per lane
+     * @param handler Called on a lane thread with the lane's next batch, in order
+     */
+    OrderedLanes(size_t lanes, size_t depth, Handler handler)
+        : depth_(depth), handler_(std::move(handler)) {
+        lanes_.reserve(lanes);
+        for (size_t i = 0; i < std::max<size_t>(lanes, 1); ++i)
+            lanes_.push_back(std::make_unique<Lane>());
+        for (auto& lane : lanes_)
+            lane->thread = std::thread(&OrderedLanes::run, this, lane.get());
+    }
+
+    /**
+     * @brief Handle every queued operation, then stop the lanes
+     */
+    ~OrderedLanes() { finish(); }
+
+    OrderedLanes(const OrderedLanes&) = delete;
+    OrderedLanes& operator=(const OrderedLanes&) = delete;
+
+    /**
+     * @brief Queue an operation behind every earlier operation with the same key
+     * @param key Ordering key
+     * @param op Operation
+     */
+    void submit(uint64_t key, Op op) {
+        // Fibonacci hashing spreads runs of consecutive keys over all lanes
+        Lane& lane = *lanes_[((key * 0x9E3779B97F4A7C15ull) >> 32) % lanes_.size()];
+        std::unique_lock<std::mutex> lock(lane.mutex);
+        lane.changed.wait(lock, [&] { return lane.queue.size() < depth_; });
+        lane.queue.push_back(std::move(op));
+        lane.changed.notify_all();
+    }
+
+    /**
+     * @brief Wait until every submitted operation is handled and stop the lanes
+     */
+    void finish() {
+        for (auto& lane : lanes_) {
+            std::lock_guard<std::mutex> lock(lane->mutex);
+            lane->closed = true;
+            lane->changed.notify_all();
+        }
+        for (auto& lane : lanes_)
+            if (lane->thread.joinable())
+                lane->thread.join();
+    }
+
+private:
+    struct Lane {
+        std::mutex mutex;  // guards queue and closed
+        std::condition_variable changed;
+        std::vector<Op> queue;
+        bool closed = false;
+        std::thread thread;
+    };
+
+    size_t depth_;
+    Handler handler_;
+    std::vector<std::unique_ptr<Lane>> lanes_;
+
+    void run(Lane* lane) {
+        std::vector<Op> batch;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(lane->mutex);
+                lane->changed.wait(lock, [&] { return !lane->queue.empty() || lane->closed; });
+                if (lane->queue.empty())
+                    return;
+                batch.swap(lane->queue);
+                lane->changed.notify_all();
+            }
+            handler_(batch);
+            batch.clear();
+        }
+    }
+};
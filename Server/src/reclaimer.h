@@ -0,0 +1,123 @@
+// reclaimer.h
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Detects structures that can be released a piece at a time (release_some)
+ */
+template <typename T, typename = void>
+struct HasPartialRelease : std::false_type {};
+
+template <typename T>
+struct HasPartialRelease<T, std::void_t<decltype(std::declval<T&>().release_some(std::size_t{}))>>
+    : std::true_type {};
+
+/**
+ * @brief Background thread that frees retired data structures at a bounded rate
+ *
+ * @details Clearing a large structure in place frees every node or slab on the caller's
+ *          thread, stalling whoever waits on it and hitting the allocator with one burst.
+ *          Instead, owners swap in an empty structure and retire() the old one. The reclaimer
+ *          frees about kStepBytes per step and sleeps kPause between steps, so a multi-GiB
+ *          structure is returned over a few seconds without latency or allocator spikes.
+ *
+ *          Types with `bool release_some(size_t bytes)` (free roughly that many bytes, return
+ *          true once nothing is left) are freed incrementally; anything else is destroyed in
+ *          a single step. Retired objects must no longer be reachable by any other thread.
+ *
+ *          One process-wide instance is shared by every store.
+ */
+class Reclaimer {
+public:
+    static constexpr std::size_t kStepBytes = std::size_t{4} << 20;
+    static constexpr std::chrono::microseconds kPause{1000};
+
+    /**
+     * @brief The process-wide reclaimer
+     */
+    static Reclaimer& global() {
+        static Reclaimer* reclaimer = new Reclaimer;  // intentionally leaked: may run until exit
+        return *reclaimer;
+    }
+
+    /**
+     * @brief Take ownership of a structure and free it in the background
+     */
+    template <typename T>
+    void retire(std::unique_ptr<T> garbage) {
+        if (!garbage)
+            return;
+        auto item = std::make_unique<Holder<T>>(std::move(garbage));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(item));
+            if (!thread_.joinable())
+                thread_ = std::thread(&Reclaimer::run, this);
+        }
+        wake_.notify_one();
+    }
+
+    /**
+     * @brief Structures retired but not yet completely freed
+     */
+    std::size_t pending() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size() + (busy_ ? 1 : 0);
+    }
+
+private:
+    struct Item {
+        virtual ~Item() = default;
+        virtual bool step(std::size_t bytes) = 0;  // true once the object is gone
+    };
+
+    template <typename T>
+    struct Holder final : Item {
+        explicit Holder(std::unique_ptr<T> object) : object(std::move(object)) {}
+
+        bool step(std::size_t bytes) override {
+            if constexpr (HasPartialRelease<T>::value) {
+                if (!object->release_some(bytes))
+                    return false;
+            }
+            object.reset();
+            return true;
+        }
+
+        std::unique_ptr<T> object;
+    };
+
+    mutable std::mutex mutex_;  // guards queue_ and busy_
+    std::condition_variable wake_;
+    std::deque<std::unique_ptr<Item>> queue_;
+    bool busy_ = false;
+    std::thread thread_;
+
+    Reclaimer() = default;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wake_.wait(lock, [this] { return !queue_.empty(); });
+            std::unique_ptr<Item> item = std::move(queue_.front());
+            queue_.pop_front();
+            busy_ = true;
+            lock.unlock();
+            while (!item->step(kStepBytes))
+                std::this_thread::sleep_for(kPause);
+            item.reset();
+            std::this_thread::sleep_for(kPause);
+            lock.lock();
+            busy_ = false;
+        }
+    }
+};
@@ -0,0 +1,475 @@
+// roaring_index.h
+#pragma once
+
+#include "btree.h"
+#include "timestamp_codec.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Set of 16-bit values stored as a Roaring array, bitmap or run container
+ *
+ * @details The representation follows the cardinality and number of runs: sparse values
+ *          live in a sorted array (2 bytes each), dense ones in a 65536-bit bitmap (8 KiB)
+ *          and long consecutive runs as (start, length) pairs (4 bytes per run). The run
+ *          count is maintained on every update, so switching to the smallest representation
+ *          never requires a scan; a hysteresis margin stops conversions from flapping.
+ *
+ *          Every operation reports the rank of the value (members smaller than it), which is
+ *          its position in the owner's parallel timestamp column.
+ */
+class RoaringContainer {
+public:
+    uint32_t cardinality() const { return card_; }
+
+    /**
+     * @brief Add a value
+     * @param v Value to add
+     * @param rank Set to the position of v among the members
+     * @return false if v was already present
+     */
+    bool add(uint16_t v, uint32_t& rank) {
+        rank = rank_of(v);
+        if (contains(v))
+            return false;
+
+        bool left = v > 0 && contains(static_cast<uint16_t>(v - 1));
+        bool right = v < kMaxValue && contains(static_cast<uint16_t>(v + 1));
+        switch (kind_) {
+        case Kind::Array: array_.insert(array_.begin() + rank, v); break;
+        case Kind::Bitmap: bitmap_[v >> 6] |= uint64_t{1} << (v & 63); break;
+        case Kind::Run: run_add(v); break;
+        }
+        ++card_;
+        run_count_ = run_count_ + 1 - left - right;
+        optimize();
+        return true;
+    }
+
+    /**
+     * @brief Remove a value
+     * @param v Value to remove
+     * @param rank Set to the position v had among the members
+     * @return false if v was not present
+     */
+    bool remove(uint16_t v, uint32_t& rank) {
+        if (!contains(v))
+            return false;
+        rank = rank_of(v);
+
+        bool left = v > 0 && contains(static_cast<uint16_t>(v - 1));
+        bool right = v < kMaxValue && contains(static_cast<uint16_t>(v + 1));
+        switch (kind_) {
+        case Kind::Array: array_.erase(array_.begin() + rank); break;
+        case Kind::Bitmap: bitmap_[v >> 6] &= ~(uint64_t{1} << (v & 63)); break;
+        case Kind::Run: run_remove(v); break;
+        }
+        --card_;
+        run_count_ = run_count_ + left + right - 1;
+        optimize();
+        return true;
+    }
+
+    /**
+     * @brief Position of v if present
+     * @return true if v is a member; rank is then its position
+     */
+    bool find(uint16_t v, uint32_t& rank) const {
+        if (!contains(v))
+            return false;
+        rank = rank_of(v);
+        return true;
+    }
+
+    /**
+     * @brief Visit members >= from in ascending order
+     * @param from Smallest value of interest
+     * @param fn Callable fn(value, rank) returning false to stop
+     * @return false if fn stopped the iteration
+     */
+    template <typename Fn>
+    bool for_each_from(uint16_t from, Fn&& fn) const {
+        uint32_t rank = rank_of(from);
+        switch (kind_) {
+        case Kind::Array:
+            for (size_t i = rank; i < array_.size(); ++i)
+                if (!fn(array_[i], static_cast<uint32_t>(i)))
+                    return false;
+            return true;
+        case Kind::Bitmap:
+            for (size_t w = from >> 6; w < kBitmapWords; ++w) {
+                uint64_t word = bitmap_[w];
+                if (w == static_cast<size_t>(from >> 6))
+                    word &= ~uint64_t{0} << (from & 63);
+                while (word) {
+                    uint16_t v = static_cast<uint16_t>(w * 64 + __builtin_ctzll(word));
+                    if (!fn(v, rank++))
+                        return false;
+                    word &= word - 1;
+                }
+            }
+            return true;
+        case Kind::Run:
+            for (const Run& r : runs_) {
+                uint32_t end = uint32_t{r.start} + r.length;
+                for (uint32_t v = std::max<uint32_t>(r.start, from); v <= end; ++v)
+                    if (!fn(static_cast<uint16_t>(v), rank++))
+                        return false;
+            }
+            return true;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Smallest or largest member of a non-empty container
+     */
+    uint16_t edge(bool largest) const {
+        switch (kind_) {
+        case Kind::Array:
+            return largest ? array_.back() : array_.front();
+        case Kind::Bitmap:
+            if (largest) {
+                for (size_t w = kBitmapWords; w-- > 0;)
+                    if (bitmap_[w])
+                        return static_cast<uint16_t>(w * 64 + 63 - __builtin_clzll(bitmap_[w]));
+            } else {
+                for (size_t w = 0; w < kBitmapWords; ++w)
+                    if (bitmap_[w])
+                        return static_cast<uint16_t>(w * 64 + __builtin_ctzll(bitmap_[w]));
+            }
+            return 0;
+        case Kind::Run:
+            return largest ? static_cast<uint16_t>(runs_.back().start + runs_.back().length) : runs_.front().start;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Heap bytes held by the current representation
+     */
+    size_t memory_bytes() const {
+        return array_.capacity() * sizeof(uint16_t) + bitmap_.capacity() * sizeof(uint64_t) +
+               runs_.capacity() * sizeof(Run);
+    }
+
+private:
+    enum class Kind : uint8_t { Array, Bitmap, Run };
+
+    struct Run {
+        uint16_t start;
+        uint16_t length;  // covers [start, start + length]
+    };
+
+    static constexpr uint32_t kMaxValue = 0xFFFF;
+    static constexpr size_t kBitmapWords = 65536 / 64;
+    static constexpr size_t kBitmapBytes = kBitmapWords * sizeof(uint64_t);
+
+    Kind kind_ = Kind::Array;
+    uint32_t card_ = 0;
+    uint32_t run_count_ = 0;
+    std::vector<uint16_t> array_;
+    std::vector<uint64_t> bitmap_;
+    std::vector<Run> runs_;
+
+    bool contains(uint16_t v) const {
+        switch (kind_) {
+        case Kind::Array: return std::binary_search(array_.begin(), array_.end(), v);
+        case Kind::Bitmap: return (bitmap_[v >> 6] >> (v & 63)) & 1;
+        case Kind::Run: {
+            auto it = run_after(v);
+            return it != runs_.begin() && v <= uint32_t{std::prev(it)->start} + std::prev(it)->length;
+        }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Number of members smaller than v
+     */
+    uint32_t rank_of(uint16_t v) const {
+        switch (kind_) {
+        case Kind::Array:
+            return static_cast<uint32_t>(std::lower_bound(array_.begin(), array_.end(), v) - array_.begin());
+        case Kind::Bitmap: {
+            uint32_t rank = 0;
+            size_t w = v >> 6;
+            for (size_t i = 0; i < w; ++i)
+                rank += static_cast<uint32_t>(__builtin_popcountll(bitmap_[i]));
+            uint64_t below = (uint64_t{1} << (v & 63)) - 1;
+            return rank + static_cast<uint32_t>(__builtin_popcountll(bitmap_[w] & below));
+        }
+        case Kind::Run: {
+            uint32_t rank = 0;
+            for (const Run& r : runs_) {
+                if (r.start >= v)
+                    break;
+                uint32_t end = uint32_t{r.start} + r.length;
+                rank += (v > end) ? r.length + 1u : uint32_t{v} - r.start;
+            }
+            return rank;
+        }
+        }
+        return 0;
+    }
+
+    // First run starting after v
+    std::vector<Run>::const_iterator run_after(uint16_t v) const {
+        return std::upper_bound(runs_.begin(), runs_.end(), v, [](uint16_t x, const Run& r) { return x < r.start; });
+    }
+
+    void run_add(uint16_t v) {
+        auto next = runs_.begin() + (run_after(v) - runs_.cbegin());
+        bool joins_prev = next != runs_.begin() && uint32_t{std::prev(next)->start} + std::prev(next)->length + 1 == v;
+        bool joins_next = next != runs_.end() && uint32_t{v} + 1 == next->start;
+        if (joins_prev && joins_next) {
+            auto prev = std::prev(next);
+            prev->length = static_cast<uint16_t>(prev->length + next->length + 2);
+            runs_.erase(next);
+        } else if (joins_prev) {
+            ++std::prev(next)->length;
+        } else if (joins_next) {
+            --next->start;
+            ++next->length;
+        } else {
+            runs_.insert(next, Run{v, 0});
+        }
+    }
+
+    void run_remove(uint16_t v) {
+        auto it = std::prev(runs_.begin() + (run_after(v) - runs_.cbegin()));
+        uint32_t end = uint32_t{it->start} + it->length;
+        if (it->length == 0) {
+            runs_.erase(it);
+        } else if (v == it->start) {
+            ++it->start;
+            --it->length;
+        } else if (v == end) {
+            --it->length;
+        } else {
+            Run tail{static_cast<uint16_t>(v + 1), static_cast<uint16_t>(end - v - 1)};
+            it->length = static_cast<uint16_t>(v - it->start - 1);
+            runs_.insert(it + 1, tail);
+        }
+    }
+
+    size_t bytes_as(Kind kind) const {
+        switch (kind) {
+        case Kind::Array: return card_ * sizeof(uint16_t);
+        case Kind::Bitmap: return kBitmapBytes;
+        case Kind::Run: return run_count_ * sizeof(Run);
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Switch to the smallest representation once the current one is clearly worse
+     */
+    void optimize() {
+        Kind best = Kind::Array;
+        for (Kind k : {Kind::Bitmap, Kind::Run})
+            if (bytes_as(k) < bytes_as(best))
+                best = k;
+        if (best == kind_ || bytes_as(kind_) <= bytes_as(best) + bytes_as(best) / 4 + 32)
+            return;
+
+        std::vector<uint16_t> values;
+        values.reserve(card_);
+        for_each_from(0, [&](uint16_t v, uint32_t) {
+            values.push_back(v);
+            return true;
+        });
+
+        std::vector<uint16_t>().swap(array_);
+        std::vector<uint64_t>().swap(bitmap_);
+        std::vector<Run>().swap(runs_);
+        kind_ = best;
+        switch (best) {
+        case Kind::Array:
+            array_ = std::move(values);
+            break;
+        case Kind::Bitmap:
+            bitmap_.assign(kBitmapWords, 0);
+            for (uint16_t v : values)
+                bitmap_[v >> 6] |= uint64_t{1} << (v & 63);
+            break;
+        case Kind::Run:
+            runs_.reserve(run_count_);
+            for (uint16_t v : values) {
+                if (!runs_.empty() && uint32_t{runs_.back().start} + runs_.back().length + 1 == v)
+                    ++runs_.back().length;
+                else
+                    runs_.push_back(Run{v, 0});
+            }
+            break;
+        }
+    }
+};
+
+/**
+ * @brief Shard index for dense number sets: Roaring-style compressed membership
+ *
+ * @details Numbers are split into a 48-bit chunk key and a 16-bit low part. Each chunk holds
+ *          a RoaringContainer for membership and a parallel column of 32-bit timestamps
+ *          (see TimestampCodec) indexed by rank, so a long run of consecutive numbers costs
+ *          a few bytes per chunk for membership plus 4 bytes per number for its timestamp.
+ *          Chunks are found through a B+tree keyed by the chunk key.
+ *
+ *          Best for dense data; a chunk with a single member costs far more than a B+tree
+ *          entry, so sparse sets should use the btree backend.
+ */
+class RoaringIndex {
+public:
+    RoaringIndex() = default;
+    ~RoaringIndex() { clear(); }
+
+    RoaringIndex(const RoaringIndex&) = delete;
+    RoaringIndex& operator=(const RoaringIndex&) = delete;
+
+    std::pair<time_t, bool> insert(uint64_t number, time_t ts) {
+        auto [it, created] = chunks_.try_emplace(number >> 16, nullptr);
+        if (created)
+            it.value() = new Chunk;
+        Chunk* chunk = it.value();
+        size_t before = created ? 0 : chunk_bytes(*chunk);
+
+        uint32_t rank;
+        if (!chunk->members.add(low(number), rank))
+            return {TimestampCodec::decode(chunk->timestamps[rank]), false};
+
+        uint32_t encoded = TimestampCodec::encode(ts);
+        chunk->timestamps.insert(chunk->timestamps.begin() + rank, encoded);
+        ++size_;
+        heap_bytes_ += chunk_bytes(*chunk) - before;
+        return {TimestampCodec::decode(encoded), true};
+    }
+
+    std::optional<time_t> erase(uint64_t number) {
+        auto it = chunks_.find(number >> 16);
+        if (it == chunks_.end())
+            return std::nullopt;
+
+        Chunk* chunk = it.value();
+        size_t before = chunk_bytes(*chunk);
+        uint32_t rank;
+        if (!chunk->members.remove(low(number), rank))
+            return std::nullopt;
+
+        time_t erased = TimestampCodec::decode(chunk->timestamps[rank]);
+        chunk->timestamps.erase(chunk->timestamps.begin() + rank);
+        --size_;
+        heap_bytes_ -= before;
+        if (chunk->members.cardinality() == 0) {
+            delete chunk;
+            chunks_.erase(number >> 16);
+        } else {
+            heap_bytes_ += chunk_bytes(*chunk);
+        }
+        return erased;
+    }
+
+    std::optional<time_t> find(uint64_t number) const {
+        auto it = chunks_.find(number >> 16);
+        if (it == chunks_.end())
+            return std::nullopt;
+        const Chunk* chunk = it.value();
+        uint32_t rank;
+        if (!chunk->members.find(low(number), rank))
+            return std::nullopt;
+        return TimestampCodec::decode(chunk->timestamps[rank]);
+    }
+
+    std::optional<uint64_t> first() const {
+        auto it = chunks_.begin();
+        if (it == chunks_.end())
+            return std::nullopt;
+        return (it.key() << 16) | it.value()->members.edge(false);
+    }
+
+    std::optional<uint64_t> last() const {
+        auto it = chunks_.last();
+        if (it == chunks_.end())
+            return std::nullopt;
+        return (it.key() << 16) | it.value()->members.edge(true);
+    }
+
+    template <typename Fn>
+    void scan(uint64_t from, Fn&& fn) const {
+        for (auto it = chunks_.lower_bound(from >> 16); it != chunks_.end(); ++it) {
+            uint64_t high = it.key() << 16;
+            const Chunk* chunk = it.value();
+            uint16_t start = it.key() == (from >> 16) ? low(from) : 0;
+            bool more = chunk->members.for_each_from(start, [&](uint16_t v, uint32_t rank) {
+                return fn(high | v, TimestampCodec::decode(chunk->timestamps[rank]));
+            });
+            if (!more)
+                return;
+        }
+    }
+
+    size_t size() const { return size_; }
+
+    /**
+     * @brief Node memory of the chunk directory, plus the heap held by the chunks
+     * @details Containers and timestamp columns use the heap directly; their bytes, kept
+     *          current by every insert and erase, count as reserved and live.
+     */
+    PoolStats allocator_stats() const {
+        PoolStats stats = chunks_.allocator_stats();
+        stats.reserved_bytes += heap_bytes_;
+        stats.live_bytes += heap_bytes_;
+        return stats;
+    }
+
+    void clear() {
+        for (auto it = chunks_.begin(); it != chunks_.end(); ++it)
+            delete it.value();
+        chunks_.clear();
+        size_ = 0;
+        heap_bytes_ = 0;
+    }
+
+    /**
+     * @brief Free about `bytes` of a retired index, lowest chunks first (see Reclaimer)
+     * @return true once every chunk and the directory are gone
+     */
+    bool release_some(size_t bytes) {
+        size_t released = 0;
+        while (released < bytes && !chunks_.empty()) {
+            auto it = chunks_.begin();
+            uint64_t key = it.key();
+            Chunk* chunk = it.value();
+            released += chunk_bytes(*chunk);
+            heap_bytes_ -= chunk_bytes(*chunk);
+            size_ -= chunk->members.cardinality();
+            delete chunk;
+            chunks_.erase(key);
+        }
+        return released < bytes && chunks_.release_some(bytes - released);
+    }
+
+private:
+    struct Chunk {
+        RoaringContainer members;
+        std::vector<uint32_t> timestamps;  // parallel to members, indexed by rank
+    };
+
+    BPlusTree<uint64_t, Chunk*> chunks_;  // chunk key (number >> 16) -> chunk
+    size_t size_ = 0;
+    size_t heap_bytes_ = 0;               // sum of chunk_bytes() over every chunk
+
+    /**
+     * @brief Heap bytes a chunk holds: the chunk itself, its container and its timestamp column
+     */
+    static size_t chunk_bytes(const Chunk& chunk) {
+        return sizeof(Chunk) + chunk.members.memory_bytes() + chunk.timestamps.capacity() * sizeof(uint32_t);
+    }
+
+    static uint16_t low(uint64_t number) { return static_cast<uint16_t>(number & 0xFFFF); }
+};
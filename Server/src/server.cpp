@@ -6,24 +6,54 @@
 #include "proto/interface.grpc.pb.h"
 #include "proto/interface.pb.h"
 
+#include "bulk_ingest.h"
+#include "change_feed.h"
+#include "checkpoint.h"
+#include "layered_store.h"
+#include "number_store.h"
+#include "ordered_lanes.h"
+#include "reclaimer.h"
+#include "snapshot_file.h"
+#include "wal.h"
+
+#include <algorithm>
 #include <iostream>
-#include <map>
-#include <mutex>
 #include <ctime>
+#include <cstdlib>
+#include <filesystem>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 /**
  * @brief Implementation of the NumberManagement gRPC service
  *
  * @details Thread-safe in-memory storage of uint64_t numbers with their insertion timestamps.
- *          Uses std::map + std::mutex for synchronization.
+ *          Numbers live in a NumberStore backend (see number_store.h), which does its own
+ *          synchronization: the default shards the key space into B+trees with one lock
+ *          each, the skip list backend is lock-free. With a write-ahead log attached, every
+ *          mutating RPC waits for its log records to become durable before it replies.
  */
 class NumberServiceImpl final : public numbermgmt::NumberManagement::Service 
 {
 private:
-    std::map<uint64_t, time_t> numbers_;  // number -> unix insertion timestamp
-    std::mutex mutex_;                    // Protects all access to numbers_
+    std::unique_ptr<NumberStore> numbers_;  // number -> unix insertion timestamp, internally synchronized
+    WriteAheadLog* wal_;                     // null when running without persistence
+    ChangeFeed* feed_;                       // null when the change feed is disabled
+
+    static constexpr size_t kStreamChunk = 4096;      // ListStream entries per message by default
+    static constexpr size_t kMaxStreamChunk = 65536;  // keeps every message around 1 MB, under gRPC's 4 MB cap
+    static constexpr size_t kRangePage = 1000;        // ListRange entries per page by default
+    static constexpr size_t kMaxRangePage = 65536;
+    static constexpr char kCursorVersion = 1;         // first byte of every ListRange cursor
+    static constexpr size_t kSessionLanes = 4;        // worker threads per Session stream
+    static constexpr size_t kSessionDepth = 256;      // operations queued per lane before reads pause
+    static constexpr size_t kWatchBatch = 1024;       // changes per Watch message at most
+    static constexpr std::chrono::milliseconds kWatchPoll{200};  // how often an idle Watch checks for cancellation
 
     /**
      * @brief Helper to create a protobuf Timestamp from time_t
@@ -36,41 +66,222 @@ private:
         return ts;
     }
 
-public:
     /**
-     * @brief Insert a number if it doesn't already exist
-     * @param context Server context
-     * @param request Contains the number to insert
-     * @param response Operational result response
-     * @return status
+     * @brief Append change-feed events to a response
+     * @param events Changes read from the feed
+     * @param out Repeated ChangeEvent field of the response
      */
-    ::grpc::Status Insert(::grpc::ServerContext* context,
-                          const ::numbermgmt::InsertRequest* request,
-                          ::numbermgmt::OperationResult* response)
-    {
-        std::cout << "received insert request" << std::endl;
-        std::lock_guard<std::mutex> lock(mutex_);
+    void add_changes(const std::vector<ChangeEvent>& events,
+                     google::protobuf::RepeatedPtrField<numbermgmt::ChangeEvent>* out) {
+        for (const ChangeEvent& event : events) {
+            auto* change = out->Add();
+            change->set_sequence(event.sequence);
+            change->set_number(event.number);
+            switch (event.kind) {
+            case ChangeEvent::Kind::Insert:
+                change->set_kind(numbermgmt::ChangeEvent::INSERT);
+                change->set_unix_seconds(static_cast<int64_t>(event.ts));
+                break;
+            case ChangeEvent::Kind::Erase:
+                change->set_kind(numbermgmt::ChangeEvent::DELETE);
+                break;
+            case ChangeEvent::Kind::ClearRange:
+                change->set_kind(numbermgmt::ChangeEvent::CLEAR_RANGE);
+                change->set_last(event.last);
+                break;
+            }
+        }
+    }
 
-        uint64_t num = request->number();
+    /**
+     * @brief Stream the feed's changes after `version` up to `target` for ListChangesSince
+     * @param chunk Message to send them in; its version follows the last change sent
+     * @param version Last change the client has; advanced past every change sent
+     * @return OK, OUT_OF_RANGE once the ring no longer holds the next change, or CANCELLED
+     */
+    grpc::Status write_changes(grpc::ServerContext* context, grpc::ServerWriter<numbermgmt::ChangesChunk>* writer,
+                               numbermgmt::ChangesChunk& chunk, uint64_t& version, uint64_t target,
+                               size_t chunk_size) {
+        std::vector<ChangeEvent> events;
+        while (version < target) {
+            if (context->IsCancelled())
+                return grpc::Status(grpc::StatusCode::CANCELLED, "ListChangesSince cancelled");
+            events.clear();
+            if (!feed_->read(version, events, std::min<uint64_t>(chunk_size, target - version)))
+                return grpc::Status(grpc::StatusCode::OUT_OF_RANGE, "Changes are no longer kept");
+            if (events.empty()) {
+                feed_->wait(version, kWatchPoll);  // handed out, still being written
+                continue;
+            }
+            chunk.clear_events();
+            add_changes(events, chunk.mutable_events());
+            version = events.back().sequence;
+            chunk.set_version(version);
+            if (!writer->Write(chunk))
+                return grpc::Status(grpc::StatusCode::CANCELLED, "ListChangesSince closed by client");
+            chunk.set_reset(false);
+            chunk.clear_numbers();
+            chunk.clear_unix_seconds();
+        }
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Print the store's allocator statistics
+     * @param when Label for the log line
+     */
+    void log_allocator_stats(const std::string& when) {
+        PoolStats stats = numbers_->allocator_stats();
+        std::cout << "allocator " << when << ": " << stats.slabs << " slabs, "
+                  << stats.reserved_bytes << " bytes reserved, " << stats.live_blocks << " live nodes ("
+                  << stats.live_bytes << " bytes), " << stats.free_blocks << " free nodes, "
+                  << static_cast<int>(stats.utilization() * 100) << "% utilized, "
+                  << Reclaimer::global().pending() << " cleared structures still being freed" << std::endl;
+    }
+
+    /**
+     * @brief Encode a ListRange resume cursor
+     * @details The cursor is the next number to read (a version byte, then 8 bytes little
+     *          endian), not a position, so it stays valid however the set changes between
+     *          pages: numbers that are present throughout are returned exactly once.
+     * @param next First number of the next page
+     * @return Opaque cursor bytes
+     */
+    static std::string encode_cursor(uint64_t next) {
+        std::string cursor(9, '\0');
+        cursor[0] = kCursorVersion;
+        for (int i = 0; i < 8; ++i)
+            cursor[1 + i] = static_cast<char>(next >> (8 * i));
+        return cursor;
+    }
+
+    /**
+     * @brief Decode a cursor produced by encode_cursor
+     * @param cursor Cursor bytes from the client
+     * @param next Decoded first number of the next page
+     * @return false if the cursor is malformed
+     */
+    static bool decode_cursor(const std::string& cursor, uint64_t& next) {
+        if (cursor.size() != 9 || cursor[0] != kCursorVersion)
+            return false;
+        next = 0;
+        for (int i = 0; i < 8; ++i)
+            next |= static_cast<uint64_t>(static_cast<uint8_t>(cursor[1 + i])) << (8 * i);
+        return true;
+    }
+
+    /**
+     * @brief Insert a number and describe the outcome (shared by Insert and Session)
+     * @param num Number to insert
+     * @param response OperationResult or SessionResponse to fill
+     * @return true if the store changed and the caller must commit() before replying
+     */
+    template <typename Response>
+    bool apply_insert(uint64_t num, Response* response) {
         if (num == 0) {
             response->set_success(false);
             response->set_message("Only positive integers (≥1) are allowed");
-            return grpc::Status::OK;
+            return false;
         }
 
-        auto [it, inserted] = numbers_.try_emplace(num, time(nullptr));
+        auto [ts, inserted] = numbers_->insert(num, time(nullptr));
         if (!inserted) {
             response->set_success(false);
             response->set_message("Number " + std::to_string(num) + " already exists");
-        } else {
+            return false;
+        }
+        response->set_success(true);
+        response->set_message("Inserted " + std::to_string(num) +
+                              " at " + std::to_string(ts));
+        auto* entry = response->mutable_entry();
+        entry->set_number(num);
+        *entry->mutable_timestamp() = make_timestamp(ts);
+        return true;
+    }
+
+    /**
+     * @brief Delete a number and describe the outcome (shared by Delete and Session)
+     * @param num Number to delete
+     * @param response OperationResult or SessionResponse to fill
+     * @return true if the store changed and the caller must commit() before replying
+     */
+    template <typename Response>
+    bool apply_delete(uint64_t num, Response* response) {
+        if (!numbers_->erase(num)) {
+            response->set_success(false);
+            response->set_message("Number " + std::to_string(num) + " not found");
+            return false;
+        }
+        response->set_success(true);
+        response->set_message("Deleted " + std::to_string(num));
+        return true;
+    }
+
+    /**
+     * @brief Look a number up without changing the store
+     * @param num Number to look up
+     * @param response Filled with the entry if found
+     */
+    void apply_contains(uint64_t num, numbermgmt::SessionResponse* response) {
+        std::optional<time_t> ts = numbers_->find(num);
+        if (ts) {
             response->set_success(true);
-            response->set_message("Inserted " + std::to_string(num) +
-                               " at " + std::to_string(it->second));
+            response->set_message("Found " + std::to_string(num));
             auto* entry = response->mutable_entry();
             entry->set_number(num);
-            *entry->mutable_timestamp() = make_timestamp(it->second);
+            *entry->mutable_timestamp() = make_timestamp(*ts);
+        } else {
+            response->set_success(false);
+            response->set_message("Number " + std::to_string(num) + " not found");
         }
-        
+    }
+
+    /**
+     * @brief Number a session operation works on, which orders it against other operations
+     */
+    static uint64_t session_key(const numbermgmt::SessionRequest& request) {
+        switch (request.op_case()) {
+        case numbermgmt::SessionRequest::kInsert: return request.insert().number();
+        case numbermgmt::SessionRequest::kDelete: return request.delete_().number();
+        case numbermgmt::SessionRequest::kContains: return request.contains().number();
+        default: return 0;
+        }
+    }
+
+    /**
+     * @brief Wait until this thread's mutations are durable (no-op without a log)
+     */
+    void commit() {
+        if (wal_)
+            wal_->commit();
+    }
+
+public:
+    /**
+     * @brief Construct the service
+     * @param numbers Storage backend
+     * @param wal Write-ahead log observing the store, or null
+     * @param feed Change feed observing the store, or null
+     */
+    NumberServiceImpl(std::unique_ptr<NumberStore> numbers, WriteAheadLog* wal, ChangeFeed* feed)
+        : numbers_(std::move(numbers)), wal_(wal), feed_(feed) {}
+
+    /**
+     * @brief Insert a number if it doesn't already exist
+     * @param context Server context
+     * @param request Contains the number to insert
+     * @param response Operational result response
+     * @return status
+     */
+    ::grpc::Status Insert(::grpc::ServerContext* context,
+                          const ::numbermgmt::InsertRequest* request,
+                          ::numbermgmt::OperationResult* response)
+    {
+        std::cout << "received insert request" << std::endl;
+
+        if (apply_insert(request->number(), response))
+            commit();
+
         return grpc::Status::OK;
     }
 
@@ -86,17 +297,245 @@ public:
                           ::numbermgmt::OperationResult* response)    
     {
         std::cout << "recieved delete request" << std::endl;
-        std::lock_guard<std::mutex> lock(mutex_);
 
+        if (apply_delete(request->number(), response))
+            commit();
+
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Whether a number is stored
+     * @details Read-only: runs under a shared shard lock (see NumberStore::find), so lookups
+     *          never queue behind each other, only behind writers to the same shard.
+     * @param context Server context
+     * @param request Number to look up
+     * @param response found flag
+     * @return status
+     */
+    ::grpc::Status Contains(::grpc::ServerContext* context,
+                            const ::numbermgmt::ContainsRequest* request,
+                            ::numbermgmt::ContainsResponse* response)
+    {
+        response->set_found(numbers_->find(request->number()).has_value());
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Return a stored number with its insertion timestamp
+     * @param context Server context
+     * @param request Number to look up
+     * @param response success = found; the entry when found
+     * @return status
+     */
+    ::grpc::Status Get(::grpc::ServerContext* context,
+                       const ::numbermgmt::GetRequest* request,
+                       ::numbermgmt::OperationResult* response)
+    {
         uint64_t num = request->number();
-        if (numbers_.erase(num)) {
-            response->set_success(true);
-            response->set_message("Deleted " + std::to_string(num));
-        } else {
+        std::optional<time_t> ts = numbers_->find(num);
+        if (!ts) {
             response->set_success(false);
             response->set_message("Number " + std::to_string(num) + " not found");
+            return grpc::Status::OK;
         }
-        
+        response->set_success(true);
+        response->set_message("Found " + std::to_string(num) + " inserted at " + std::to_string(*ts));
+        auto* entry = response->mutable_entry();
+        entry->set_number(num);
+        *entry->mutable_timestamp() = make_timestamp(*ts);
+
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Count the stored numbers smaller than a number
+     * @details The btree backend keeps subtree counts, so this costs O(shards + log n)
+     *          (NumberStore::rank); no entries are copied.
+     * @param context Server context
+     * @param request Number to rank; it need not be stored
+     * @param response Count of smaller stored numbers
+     * @return status
+     */
+    ::grpc::Status Rank(::grpc::ServerContext* context,
+                        const ::numbermgmt::RankRequest* request,
+                        ::numbermgmt::RankResponse* response)
+    {
+        response->set_rank(numbers_->rank(request->number()));
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Return the stored number at a position in ascending order
+     * @details Whole shards are skipped by their size, then the btree descends by subtree
+     *          counts (NumberStore::select).
+     * @param context Server context
+     * @param request Position, 0 for the smallest number
+     * @param response success = position exists; the entry when it does
+     * @return status
+     */
+    ::grpc::Status Select(::grpc::ServerContext* context,
+                          const ::numbermgmt::SelectRequest* request,
+                          ::numbermgmt::OperationResult* response)
+    {
+        uint64_t position = request->position();
+        std::optional<StoreEntry> entry = numbers_->select(position);
+        if (!entry) {
+            response->set_success(false);
+            response->set_message("Position " + std::to_string(position) + " is past the end");
+            return grpc::Status::OK;
+        }
+        response->set_success(true);
+        response->set_message("Number " + std::to_string(entry->number) + " at position " +
+                              std::to_string(position));
+        response->mutable_entry()->set_number(entry->number);
+        *response->mutable_entry()->mutable_timestamp() = make_timestamp(entry->timestamp);
+
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Look up many numbers in one call
+     * @details The batch is looked up in number order, taking each shard's lock shared once.
+     * @param context Server context
+     * @param request Numbers to look up
+     * @param response Count, a found bitmap and a timestamp per number
+     * @return status
+     */
+    ::grpc::Status ContainsMany(::grpc::ServerContext* context,
+                                const ::numbermgmt::ContainsManyRequest* request,
+                                ::numbermgmt::ContainsManyResponse* response)
+    {
+        const auto& numbers = request->numbers();
+        std::string* found = response->mutable_found();
+        found->resize((numbers.size() + 7) / 8);
+        std::vector<time_t> timestamps(numbers.size());
+        size_t count = numbers_->find_batch(numbers.data(), numbers.size(), timestamps.data(),
+                                            reinterpret_cast<uint8_t*>(found->data()));
+        response->set_count(static_cast<uint32_t>(count));
+        response->mutable_unix_seconds()->Reserve(numbers.size());
+        for (time_t ts : timestamps)
+            response->add_unix_seconds(static_cast<int64_t>(ts));
+
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Insert many numbers in one call
+     * @details All new numbers share one timestamp. The batch is applied in number order,
+     *          one lock acquisition per shard, and made durable with a single commit.
+     *          Zeros are skipped with their bit left clear, as BulkInsert does, and the rest
+     *          of the batch is still applied.
+     * @param context Server context
+     * @param request Numbers to insert
+     * @param response Count plus a bitmap of which numbers were inserted
+     * @return status
+     */
+    ::grpc::Status InsertBatch(::grpc::ServerContext* context,
+                               const ::numbermgmt::InsertBatchRequest* request,
+                               ::numbermgmt::BatchResult* response)
+    {
+        const auto& numbers = request->numbers();
+        time_t now = time(nullptr);
+        std::string* outcomes = response->mutable_outcomes();
+        outcomes->resize((numbers.size() + 7) / 8);
+        uint8_t* bitmap = reinterpret_cast<uint8_t*>(outcomes->data());
+        size_t zeros = static_cast<size_t>(std::count(numbers.begin(), numbers.end(), 0));
+        size_t count;
+        if (zeros == 0) {
+            count = numbers_->insert_batch(numbers.data(), numbers.size(), now, bitmap);
+        } else {
+            // Insert the valid numbers, then move their outcome bits back to request positions
+            std::vector<uint64_t> valid;
+            std::vector<uint32_t> positions;
+            valid.reserve(numbers.size() - zeros);
+            positions.reserve(numbers.size() - zeros);
+            for (int i = 0; i < numbers.size(); ++i) {
+                if (numbers[i] != 0) {
+                    valid.push_back(numbers[i]);
+                    positions.push_back(static_cast<uint32_t>(i));
+                }
+            }
+            std::vector<uint8_t> inserted((valid.size() + 7) / 8);
+            count = numbers_->insert_batch(valid.data(), valid.size(), now, inserted.data());
+            for (size_t j = 0; j < valid.size(); ++j) {
+                if (inserted[j / 8] & (1u << (j % 8)))
+                    bitmap[positions[j] / 8] |= static_cast<uint8_t>(1u << (positions[j] % 8));
+            }
+        }
+        if (count > 0)
+            commit();
+        response->set_success(true);
+        response->set_count(static_cast<uint32_t>(count));
+        response->set_message("Inserted " + std::to_string(count) + " of " + std::to_string(numbers.size()) +
+                              " numbers" + (zeros ? ", skipped " + std::to_string(zeros) + " zeros" : ""));
+        *response->mutable_timestamp() = make_timestamp(now);
+
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Delete many numbers in one call
+     * @param context Server context
+     * @param request Numbers to delete
+     * @param response Count plus a bitmap of which numbers were deleted
+     * @return status
+     */
+    ::grpc::Status DeleteBatch(::grpc::ServerContext* context,
+                               const ::numbermgmt::DeleteBatchRequest* request,
+                               ::numbermgmt::BatchResult* response)
+    {
+        const auto& numbers = request->numbers();
+        std::string* outcomes = response->mutable_outcomes();
+        outcomes->resize((numbers.size() + 7) / 8);
+        size_t count = numbers_->erase_batch(numbers.data(), numbers.size(),
+                                             reinterpret_cast<uint8_t*>(outcomes->data()));
+        if (count > 0)
+            commit();
+        response->set_success(true);
+        response->set_count(static_cast<uint32_t>(count));
+        response->set_message("Deleted " + std::to_string(count) + " of " + std::to_string(numbers.size()) +
+                              " numbers");
+
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Insert a stream of number chunks, for large imports
+     * @details Chunks go through a BulkIngest pipeline: while this thread receives and
+     *          decodes the next chunk, earlier ones are sorted, deduplicated and merged into
+     *          the store on two more threads. Receiving blocks while the pipeline is full.
+     *          Zeros are skipped and counted instead of failing the stream, since earlier
+     *          chunks may already be applied. Replies once everything is durable.
+     * @param context Server context
+     * @param reader Stream of chunks
+     * @param response Totals of the import
+     * @return status, CANCELLED if the client went away (received chunks are still applied)
+     */
+    ::grpc::Status BulkInsert(::grpc::ServerContext* context,
+                              ::grpc::ServerReader<::numbermgmt::BulkInsertChunk>* reader,
+                              ::numbermgmt::BulkInsertSummary* response)
+    {
+        std::cout << "received bulk insert request" << std::endl;
+
+        BulkIngest ingest(*numbers_, [this] { commit(); });
+        numbermgmt::BulkInsertChunk chunk;
+        while (reader->Read(&chunk))
+            ingest.push(std::vector<uint64_t>(chunk.numbers().begin(), chunk.numbers().end()));
+        BulkIngestResult result = ingest.finish();
+        if (context->IsCancelled())
+            return grpc::Status(grpc::StatusCode::CANCELLED, "Bulk insert cancelled");
+
+        response->set_success(true);
+        response->set_chunks(result.chunks);
+        response->set_received(result.received);
+        response->set_inserted(result.inserted);
+        response->set_rejected(result.rejected);
+        response->set_message("Inserted " + std::to_string(result.inserted) + " of " +
+                              std::to_string(result.received) + " numbers in " +
+                              std::to_string(result.chunks) + " chunks" +
+                              (result.rejected ? ", skipped " + std::to_string(result.rejected) + " zeros" : ""));
+
         return grpc::Status::OK;
     }
 
@@ -111,19 +550,421 @@ public:
                         const ::numbermgmt::ListRequest* request,
                         ::numbermgmt::NumberListResponse* response)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-
-        response->set_count(numbers_.size());
-        for (const auto& [num, ts] : numbers_) {
+        // A point-in-time view read in chunks: writers keep going while the response is built
+        std::unique_ptr<StoreSnapshot> snapshot = numbers_->snapshot();
+        snapshot->for_each([&](uint64_t num, time_t ts) {
             auto* entry = response->add_entries();
             entry->set_number(num);
             *entry->mutable_timestamp() = make_timestamp(ts);
-        }
-        response->set_message("Current count: " + std::to_string(numbers_.size()));
+        });
+        response->set_count(response->entries_size());
+        response->set_message("Current count: " + std::to_string(response->entries_size()));
         
         return grpc::Status::OK;
     }
 
+    /**
+     * @brief Stream all stored numbers sorted by value, a fixed-size chunk per message
+     * @details Reads the same point-in-time snapshot as List, but only one chunk is in memory
+     *          at a time. Write() blocks while the client falls behind (HTTP/2 flow control),
+     *          so a slow reader throttles the scan instead of queueing the set on the server.
+     * @param context Server context, checked for cancellation between chunks
+     * @param request Chunk size (0 = kStreamChunk, capped at kMaxStreamChunk)
+     * @param writer Stream of NumberChunk messages; an empty set sends no message
+     * @return status, CANCELLED if the client went away mid-stream
+     */
+    ::grpc::Status ListStream(::grpc::ServerContext* context,
+                              const ::numbermgmt::ListStreamRequest* request,
+                              ::grpc::ServerWriter<::numbermgmt::NumberChunk>* writer)
+    {
+        size_t chunk_size = request->chunk_size() ? std::min<size_t>(request->chunk_size(), kMaxStreamChunk)
+                                                  : kStreamChunk;
+        std::unique_ptr<StoreSnapshot> snapshot = numbers_->snapshot();
+        std::vector<StoreEntry> entries(chunk_size);
+        numbermgmt::NumberChunk chunk;
+        chunk.mutable_numbers()->Reserve(static_cast<int>(chunk_size));
+        chunk.mutable_unix_seconds()->Reserve(static_cast<int>(chunk_size));
+
+        uint64_t from = 0;
+        for (;;) {
+            if (context->IsCancelled())
+                return grpc::Status(grpc::StatusCode::CANCELLED, "List stream cancelled");
+            size_t n = snapshot->read(from, entries.data(), chunk_size);
+            if (n == 0)
+                break;
+            chunk.clear_numbers();
+            chunk.clear_unix_seconds();
+            for (size_t i = 0; i < n; ++i) {
+                chunk.add_numbers(entries[i].number);
+                chunk.add_unix_seconds(static_cast<int64_t>(entries[i].timestamp));
+            }
+            if (!writer->Write(chunk))
+                return grpc::Status(grpc::StatusCode::CANCELLED, "List stream closed by client");
+            if (n < chunk_size || entries[n - 1].number == std::numeric_limits<uint64_t>::max())
+                break;
+            from = entries[n - 1].number + 1;
+        }
+
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Return one page of the numbers in [min, max) sorted by value
+     * @details Seeks the ordered index straight to the first number of the page instead of
+     *          scanning from the start, and reads one entry past the page to tell whether
+     *          another page follows. Each page is read from the live store; the cursor keeps
+     *          pages from overlapping or skipping numbers that stay in the set.
+     * @param context Server context
+     * @param request Bounds, page size (0 = kRangePage, capped at kMaxRangePage) and cursor
+     * @param response Entries of the page and the cursor of the next one
+     * @return status
+     */
+    ::grpc::Status ListRange(::grpc::ServerContext* context,
+                             const ::numbermgmt::ListRangeRequest* request,
+                             ::numbermgmt::ListRangeResponse* response)
+    {
+        uint64_t from = request->min();
+        uint64_t max = request->max();  // exclusive, 0 = unbounded
+        if (max != 0 && max <= from) {
+            response->set_success(false);
+            response->set_message("Empty range: max must be greater than min");
+            return grpc::Status::OK;
+        }
+        if (!request->cursor().empty()) {
+            uint64_t next;
+            if (!decode_cursor(request->cursor(), next)) {
+                response->set_success(false);
+                response->set_message("Invalid cursor");
+                return grpc::Status::OK;
+            }
+            from = std::max(from, next);
+        }
+        size_t limit = request->limit() ? std::min<size_t>(request->limit(), kMaxRangePage) : kRangePage;
+
+        std::vector<StoreEntry> entries(limit + 1);
+        size_t n = (max != 0 && from >= max) ? 0 : numbers_->read(from, entries.data(), limit + 1);
+        size_t count = 0;
+        while (count < n && count < limit && (max == 0 || entries[count].number < max)) {
+            auto* entry = response->add_entries();
+            entry->set_number(entries[count].number);
+            *entry->mutable_timestamp() = make_timestamp(entries[count].timestamp);
+            ++count;
+        }
+        if (count == limit && n > limit && (max == 0 || entries[limit].number < max))
+            response->set_next_cursor(encode_cursor(entries[limit].number));
+        response->set_success(true);
+        response->set_message("Returned " + std::to_string(count) + " numbers");
+
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Pipelined Insert/Delete/Contains over one bidirectional stream
+     * @details The client may keep any number of tagged operations in flight. This thread
+     *          reads them and hands each to one of kSessionLanes lanes by its number
+     *          (OrderedLanes), so operations on the same number are applied in the order they
+     *          were sent, while operations on different numbers run in parallel and may
+     *          complete out of order. A lane applies everything queued at once, commits the
+     *          log once for the whole batch and only then writes the batch's responses, so
+     *          no mutation is acknowledged before it is durable. Reading pauses while a lane
+     *          is kSessionDepth operations behind.
+     * @param context Server context
+     * @param stream Operations in, tagged results out
+     * @return status once the client has finished sending and every result was written,
+     *         CANCELLED if a result could not be written (later ones were dropped)
+     */
+    ::grpc::Status Session(::grpc::ServerContext* context,
+                           ::grpc::ServerReaderWriter<::numbermgmt::SessionResponse,
+                                                      ::numbermgmt::SessionRequest>* stream)
+    {
+        std::cout << "session opened" << std::endl;
+
+        std::mutex write_mutex;      // one writer at a time on the stream
+        bool write_failed = false;   // client gone; remaining results are dropped
+        OrderedLanes<numbermgmt::SessionRequest> lanes(
+            kSessionLanes, kSessionDepth, [&](std::vector<numbermgmt::SessionRequest>& batch) {
+                std::vector<numbermgmt::SessionResponse> responses(batch.size());
+                bool mutated = false;
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    const numbermgmt::SessionRequest& request = batch[i];
+                    numbermgmt::SessionResponse& response = responses[i];
+                    response.set_tag(request.tag());
+                    switch (request.op_case()) {
+                    case numbermgmt::SessionRequest::kInsert:
+                        mutated |= apply_insert(request.insert().number(), &response);
+                        break;
+                    case numbermgmt::SessionRequest::kDelete:
+                        mutated |= apply_delete(request.delete_().number(), &response);
+                        break;
+                    case numbermgmt::SessionRequest::kContains:
+                        apply_contains(request.contains().number(), &response);
+                        break;
+                    default:
+                        response.set_success(false);
+                        response.set_message("Empty operation");
+                    }
+                }
+                if (mutated)
+                    commit();
+
+                std::lock_guard<std::mutex> lock(write_mutex);
+                for (size_t i = 0; i < responses.size() && !write_failed; ++i) {
+                    grpc::WriteOptions options;
+                    if (i + 1 < responses.size())
+                        options.set_buffer_hint();  // coalesce the batch into few frames
+                    write_failed = !stream->Write(responses[i], options);
+                }
+            });
+
+        numbermgmt::SessionRequest request;
+        while (stream->Read(&request)) {
+            uint64_t key = session_key(request);
+            lanes.submit(key, std::move(request));
+        }
+        lanes.finish();
+
+        std::cout << "session closed" << std::endl;
+        if (write_failed)
+            return grpc::Status(grpc::StatusCode::CANCELLED, "Session closed by client");
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Stream every change to the set as it happens
+     * @details Reads the ChangeFeed ring, which every mutation of the store is published to
+     *          with a sequence number, and sends whatever is new in messages of at most
+     *          kWatchBatch changes. The first message carries the feed id and the sequence the
+     *          stream starts after. A client that reconnects with that id and the last
+     *          sequence it received continues without gaps, as long as the ring still holds
+     *          the next change. Subscribers never queue anything of their own: one that falls
+     *          more than the ring's capacity behind is cut off with RESOURCE_EXHAUSTED and has
+     *          to resynchronize with List. Changes are published when applied, which can be
+     *          shortly before they are durable.
+     * @param context Server context
+     * @param request Where to start: the next change, or a resume point
+     * @param writer Stream of change batches
+     * @return status once the client cancels, or why the stream was cut off
+     */
+    ::grpc::Status Watch(::grpc::ServerContext* context,
+                         const ::numbermgmt::WatchRequest* request,
+                         ::grpc::ServerWriter<::numbermgmt::WatchResponse>* writer)
+    {
+        if (!feed_)
+            return grpc::Status(grpc::StatusCode::UNAVAILABLE, "Change feed is disabled (--watch-ring 0)");
+
+        uint64_t after = feed_->head();
+        if (request->feed_id() != 0) {
+            if (request->feed_id() != feed_->id())
+                return grpc::Status(grpc::StatusCode::OUT_OF_RANGE, "Unknown feed (the server restarted); resynchronize with List");
+            if (request->after_sequence() > after)
+                return grpc::Status(grpc::StatusCode::OUT_OF_RANGE, "Sequence " + std::to_string(request->after_sequence()) +
+                                                                    " has not happened yet");
+            after = request->after_sequence();
+        }
+
+        std::vector<ChangeEvent> events;
+        events.reserve(kWatchBatch);
+        if (!feed_->read(after, events, kWatchBatch))
+            return grpc::Status(grpc::StatusCode::OUT_OF_RANGE, "Changes after sequence " + std::to_string(after) +
+                                                                " are no longer kept; resynchronize with List");
+
+        auto lapped = [this] {
+            return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Watcher fell more than " +
+                                std::to_string(feed_->capacity()) + " changes behind; resynchronize with List");
+        };
+        numbermgmt::WatchResponse response;
+        response.set_feed_id(feed_->id());
+        response.set_sequence(after);
+        if (!writer->Write(response))
+            return grpc::Status(grpc::StatusCode::CANCELLED, "Watch closed by client");
+
+        while (!context->IsCancelled()) {
+            if (events.empty()) {
+                feed_->wait(after, kWatchPoll);
+                if (!feed_->read(after, events, kWatchBatch))
+                    return lapped();
+                continue;
+            }
+            response.clear_events();
+            add_changes(events, response.mutable_events());
+            after = events.back().sequence;
+            response.set_sequence(after);
+            if (!writer->Write(response))
+                return grpc::Status(grpc::StatusCode::CANCELLED, "Watch closed by client");
+            events.clear();
+            if (!feed_->read(after, events, kWatchBatch))
+                return lapped();
+        }
+        return grpc::Status(grpc::StatusCode::CANCELLED, "Watch cancelled");
+    }
+
+    /**
+     * @brief Bring a client's copy of the set up to date with what changed since its version
+     * @details A version is a change-feed sequence, paired with the feed id of the server run
+     *          it belongs to. While the ring still holds every change after the client's
+     *          version, only those changes are sent, so refreshing costs as much as the churn
+     *          and not as much as the set. Otherwise (first call, history truncated, server
+     *          restarted or the feed disabled) a message with reset set starts the whole set
+     *          from a snapshot, as in ListStream. That message is usually the first, but if the
+     *          ring is overrun while changes are being sent it follows the change messages
+     *          already written: reset always means discard everything received so far, those
+     *          changes included, along with the local copy. The feed head is read before the
+     *          snapshot is taken and the changes after it are sent once the snapshot is done;
+     *          some of them may already be part of the snapshot, which applying them again
+     *          does not change. Every message carries the version reached so far.
+     * @param context Server context, checked for cancellation between messages
+     * @param request Feed id and version of the previous call, chunk size (0 = kStreamChunk,
+     *                capped at kMaxStreamChunk)
+     * @param writer Stream of ChangesChunk messages, at least one
+     * @return status, CANCELLED if the client went away mid-stream
+     */
+    ::grpc::Status ListChangesSince(::grpc::ServerContext* context,
+                                    const ::numbermgmt::ListChangesRequest* request,
+                                    ::grpc::ServerWriter<::numbermgmt::ChangesChunk>* writer)
+    {
+        size_t chunk_size = request->chunk_size() ? std::min<size_t>(request->chunk_size(), kMaxStreamChunk)
+                                                  : kStreamChunk;
+        numbermgmt::ChangesChunk chunk;
+        chunk.set_feed_id(feed_ ? feed_->id() : 0);
+
+        uint64_t version = request->version();
+        if (feed_ && request->feed_id() == feed_->id() && version <= feed_->head()) {
+            chunk.set_version(version);
+            grpc::Status status = write_changes(context, writer, chunk, version, feed_->head(), chunk_size);
+            if (status.error_code() != grpc::StatusCode::OUT_OF_RANGE) {
+                if (status.ok() && version == request->version() && !writer->Write(chunk))
+                    return grpc::Status(grpc::StatusCode::CANCELLED, "ListChangesSince closed by client");
+                return status;
+            }
+        }
+
+        // Full resync; changes up to the head read here are all in the snapshot
+        version = feed_ ? feed_->head() : 0;
+        std::unique_ptr<StoreSnapshot> snapshot = numbers_->snapshot();
+        std::vector<StoreEntry> entries(chunk_size);
+        chunk.clear_events();
+        chunk.set_version(version);
+        chunk.set_reset(true);
+        chunk.mutable_numbers()->Reserve(static_cast<int>(chunk_size));
+        chunk.mutable_unix_seconds()->Reserve(static_cast<int>(chunk_size));
+
+        uint64_t from = 0;
+        for (bool more = true; more;) {
+            if (context->IsCancelled())
+                return grpc::Status(grpc::StatusCode::CANCELLED, "ListChangesSince cancelled");
+            size_t n = snapshot->read(from, entries.data(), chunk_size);
+            more = n == chunk_size && entries[n - 1].number != std::numeric_limits<uint64_t>::max();
+            if (n == 0 && !chunk.reset())
+                break;
+            chunk.clear_numbers();
+            chunk.clear_unix_seconds();
+            for (size_t i = 0; i < n; ++i) {
+                chunk.add_numbers(entries[i].number);
+                chunk.add_unix_seconds(static_cast<int64_t>(entries[i].timestamp));
+            }
+            if (!writer->Write(chunk))
+                return grpc::Status(grpc::StatusCode::CANCELLED, "ListChangesSince closed by client");
+            chunk.set_reset(false);
+            if (more)
+                from = entries[n - 1].number + 1;
+        }
+        snapshot.reset();
+
+        if (!feed_)
+            return grpc::Status::OK;
+        chunk.clear_numbers();
+        chunk.clear_unix_seconds();
+        grpc::Status status = write_changes(context, writer, chunk, version, feed_->head(), chunk_size);
+        // If even the catch-up was overrun, the client continues from the version it reached
+        return status.error_code() == grpc::StatusCode::OUT_OF_RANGE ? grpc::Status::OK : status;
+    }
+
+    /**
+     * @brief Return the count, number bounds, insertion-time range and memory footprint
+     * @details Served from counters and bounds that writers keep current (NumberStore::stats),
+     *          so polling it never walks the set. The sharded backends never wait for a lock;
+     *          on skiplist and lsm the time range is a bound that deletes do not narrow.
+     * @param context Server context
+     * @param request Empty request
+     * @param response Store statistics
+     * @return status
+     */
+    ::grpc::Status Stats(::grpc::ServerContext* context,
+                         const ::numbermgmt::StatsRequest* request,
+                         ::numbermgmt::StatsResponse* response)
+    {
+        StoreStats stats = numbers_->stats();
+        response->set_count(stats.count);
+        response->set_min(stats.min);
+        response->set_max(stats.max);
+        *response->mutable_oldest() = make_timestamp(stats.oldest);
+        *response->mutable_newest() = make_timestamp(stats.newest);
+        response->set_memory_bytes(stats.memory_bytes);
+
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Remove every number in [min, max)
+     * @details Shards lying wholly inside the range are swapped out in constant time and the
+     *          rest is erased by scanning just the range (NumberStore::erase_range), so the
+     *          cost follows the removed span rather than the size of the set.
+     * @param context Server context
+     * @param request Range; max 0 means no upper bound
+     * @param response Number of entries removed
+     * @return status
+     */
+    ::grpc::Status DeleteRange(::grpc::ServerContext* context,
+                               const ::numbermgmt::DeleteRangeRequest* request,
+                               ::numbermgmt::DeleteCountResult* response)
+    {
+        uint64_t max = request->max();  // exclusive, 0 = unbounded
+        if (max != 0 && max <= request->min()) {
+            response->set_success(false);
+            response->set_message("Empty range: max must be greater than min");
+            return grpc::Status::OK;
+        }
+        uint64_t last = max == 0 ? std::numeric_limits<uint64_t>::max() : max - 1;
+        size_t count = numbers_->erase_range(request->min(), last);
+        if (count > 0)
+            commit();
+
+        response->set_success(true);
+        response->set_count(count);
+        response->set_message("Deleted " + std::to_string(count) + " numbers");
+
+        return grpc::Status::OK;
+    }
+
+    /**
+     * @brief Remove every number inserted before a point in time
+     * @details Sharded backends skip shards with nothing old enough by their per-second counts
+     *          and swap out wholly expired ones. btree, art and hash list each second's numbers
+     *          by default and visit only the expiring ones; roaring, unless started with
+     *          --expiry-index on, walks each shard that expires in part
+     *          (NumberStore::erase_inserted_before). skiplist and lsm walk the set.
+     * @param context Server context
+     * @param request Cutoff; numbers inserted strictly earlier are removed
+     * @param response Number of entries removed
+     * @return status
+     */
+    ::grpc::Status DeleteInsertedBefore(::grpc::ServerContext* context,
+                                        const ::numbermgmt::DeleteInsertedBeforeRequest* request,
+                                        ::numbermgmt::DeleteCountResult* response)
+    {
+        time_t before = static_cast<time_t>(request->before().unix_seconds());
+        size_t count = numbers_->erase_inserted_before(before);
+        if (count > 0)
+            commit();
+
+        response->set_success(true);
+        response->set_count(count);
+        response->set_message("Deleted " + std::to_string(count) + " numbers inserted before " +
+                              std::to_string(before));
+
+        return grpc::Status::OK;
+    }
+
     /**
      * @brief Remove all stored numbers
      * @param context Server context
@@ -135,10 +976,10 @@ public:
                          const ::numbermgmt::ClearRequest* request,
                          ::numbermgmt::OperationResult* response)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-
-        size_t count = numbers_.size();
-        numbers_.clear();
+        log_allocator_stats("before clear");
+        size_t count = numbers_->clear();
+        commit();
+        log_allocator_stats("after clear");
 
         response->set_success(true);
         response->set_message("Cleared " + std::to_string(count) + " numbers");
@@ -147,15 +988,168 @@ public:
     }
 };
 
+/**
+ * @brief Command line configuration of the server
+ */
+struct ServerOptions {
+    StoreOptions store;
+    WalOptions wal;  // persistence is enabled when wal.directory is set
+    std::chrono::seconds checkpoint_interval{300};
+    size_t watch_ring = 65536;  // changes kept for Watch subscribers; 0 disables the feed
+};
+
+/**
+ * @brief Prints the server usage message
+ */
+void print_usage() {
+    std::cout << R"(
+    Usage: server [options]
+      --store <backend>    Storage backend: btree (sharded B+tree, default),
+                           skiplist (lock-free skip list), roaring
+                           (compressed bitmap, for dense numbers), art
+                           (adaptive radix tree), hash (hash table with a
+                           sorted view rebuilt on List) or lsm (log-structured
+                           merge tree on disk in <path>/lsm; needs --data-dir)
+      --shards <n>         Number of key-range shards (default 16)
+      --key-space <max>    Largest number expected; shard ranges are spread evenly
+                           over [0, max] (default 2^64 - 1)
+      --data-dir <path>    Persist mutations to a write-ahead log in <path> and
+                           replay it on startup (default: in-memory only)
+      --durability <mode>  When a mutation is acknowledged: fsync (after its own
+                           fsync), group (after a shared fsync, batched over the
+                           commit window; default) or async (immediately; the
+                           log is flushed every commit window)
+      --commit-window-us <n>
+                           Group commit / async flush window in microseconds
+                           (default 500)
+      --checkpoint-interval-s <n>
+                           Seconds between checkpoints of the whole set to
+                           <path>/snapshot.dat, which also trims the log; on
+                           startup the checkpoint is served immediately while
+                           it loads in the background (default 300, 0 = off)
+      --io <uring|pwrite>  How the log and checkpoints are written: io_uring
+                           with registered buffers (default; falls back to
+                           pwrite when unavailable) or plain pwrite/fdatasync
+      --watch-ring <n>     Changes kept for Watch subscribers; one that falls
+                           further behind is cut off (default 65536, 0 = no
+                           change feed; on skiplist the feed makes writers
+                           take striped locks)
+      --expiry-index <on|off>
+                           Sharded backends: list every number under its
+                           insertion second, so DeleteInsertedBefore only
+                           visits expiring numbers, at ~10 bytes per number
+                           (default on, except roaring: there partly expiring
+                           shards are walked in full)
+    )" << std::endl;
+}
+
+/**
+ * @brief Parses command line arguments into ServerOptions
+ * @param argc Argument count
+ * @param argv Argument values
+ * @param options Parsed options
+ * @return false if the arguments were invalid
+ */
+bool parse_options(int argc, char** argv, ServerOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        try {
+            if (arg == "--store") options.store.backend = argv[++i];
+            else if (arg == "--shards") options.store.shard_count = std::stoull(argv[++i]);
+            else if (arg == "--key-space") options.store.key_space = std::stoull(argv[++i]);
+            else if (arg == "--data-dir") options.wal.directory = argv[++i];
+            else if (arg == "--durability") {
+                if (!WriteAheadLog::parse_durability(argv[++i], options.wal.durability)) return false;
+            }
+            else if (arg == "--commit-window-us") options.wal.window = std::chrono::microseconds(std::stoull(argv[++i]));
+            else if (arg == "--io") {
+                std::string io = argv[++i];
+                if (io != "uring" && io != "pwrite") return false;
+                options.wal.use_io_uring = io == "uring";
+            }
+            else if (arg == "--checkpoint-interval-s") options.checkpoint_interval = std::chrono::seconds(std::stoull(argv[++i]));
+            else if (arg == "--watch-ring") options.watch_ring = std::stoull(argv[++i]);
+            else if (arg == "--expiry-index") {
+                std::string index = argv[++i];
+                if (index != "on" && index != "off") return false;
+                options.store.expiry_index = index == "on";
+            }
+            else return false;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return options.store.shard_count > 0;
+}
+
 /**
  * @brief Start the gRPC server on an abstract Unix domain socket
  *
  * @details: Listens on: unix-abstract:numbers-daemon.sock
+ * @param options Server configuration
  */
-void RunServer() {
+void RunServer(const ServerOptions& options) {
     std::string socket_address = "unix-abstract:numbers-daemon.sock";
 
-    NumberServiceImpl service;
+    StoreOptions store_options = options.store;
+    store_options.use_io_uring = options.wal.use_io_uring;
+    if (store_options.backend == "lsm") {
+        if (options.wal.directory.empty()) {
+            std::cout << "The lsm backend needs --data-dir" << std::endl;
+            return;
+        }
+        store_options.directory = options.wal.directory + "/lsm";
+    }
+    std::unique_ptr<NumberStore> numbers;
+    try {
+        numbers = make_number_store(store_options);
+    } catch (const std::exception& e) {
+        std::cout << "Cannot open the " << store_options.backend << " store: " << e.what() << std::endl;
+        return;
+    }
+    if (!numbers) {
+        std::cout << "Unknown storage backend: " << options.store.backend << std::endl;
+        return;
+    }
+    std::cout << "Using " << options.store.backend << " storage backend" << std::endl;
+
+    std::unique_ptr<WriteAheadLog> wal;
+    if (!options.wal.directory.empty()) {
+        try {
+            wal = std::make_unique<WriteAheadLog>(options.wal);
+            uint64_t first_segment = 0;
+            std::string checkpoint = Checkpointer::snapshot_path(options.wal.directory);
+            if (numbers->persistent() && std::filesystem::exists(checkpoint))
+                throw std::runtime_error(checkpoint + " was written by an in-memory backend");
+            if (!numbers->persistent() && std::filesystem::exists(options.wal.directory + "/lsm/MANIFEST"))
+                throw std::runtime_error("the directory belongs to the lsm backend");
+            if (!numbers->persistent() && std::filesystem::exists(checkpoint)) {
+                std::shared_ptr<const SnapshotFile> base = SnapshotFile::open(checkpoint);
+                first_segment = base->wal_seq();
+                std::cout << "Serving checkpoint of " << base->size() << " numbers while it loads" << std::endl;
+                numbers = std::make_unique<LayeredStore>(std::move(numbers), std::move(base));
+            }
+            size_t replayed = wal->recover(*numbers, first_segment);
+            std::cout << "Replayed " << replayed << " log records from " << options.wal.directory
+                      << " (" << numbers->size() << " numbers); logging with " << wal->io_name() << std::endl;
+        } catch (const std::exception& e) {
+            std::cout << "Cannot restore from " << options.wal.directory << ": " << e.what() << std::endl;
+            return;
+        }
+    }
+    std::unique_ptr<ChangeFeed> feed;
+    if (options.watch_ring > 0)
+        feed = std::make_unique<ChangeFeed>(options.watch_ring, wal.get());
+    // The feed forwards every change to the log before publishing it, so it takes the log's place
+    numbers->set_observer(feed ? static_cast<MutationObserver*>(feed.get()) : wal.get());
+    NumberStore& store = *numbers;
+    NumberServiceImpl service(std::move(numbers), wal.get(), feed.get());
+
+    std::unique_ptr<Checkpointer> checkpointer;
+    if (wal)
+        checkpointer = std::make_unique<Checkpointer>(store, *wal, options.wal.directory, options.checkpoint_interval,
+                                                      options.wal.use_io_uring);
 
     grpc::ServerBuilder builder;
     builder.AddListeningPort(socket_address, grpc::InsecureServerCredentials());
@@ -167,7 +1161,13 @@ void RunServer() {
     server->Wait();
 }
 
-int main() {
-    RunServer();
+int main(int argc, char** argv) {
+    ServerOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    RunServer(options);
     return 0;
 }
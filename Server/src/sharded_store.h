@@ -0,0 +1,956 @@
+// sharded_store.h
+#pragma once
+
+#include "btree_index.h"
+#include "number_store.h"
+#include "reclaimer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Detects indexes that can stream their number column (scan_numbers)
+ */
+template <typename Index, typename = void>
+struct HasNumberScan : std::false_type {};
+
+template <typename Index>
+struct HasNumberScan<Index, std::void_t<decltype(std::declval<const Index&>().scan_numbers(
+                                uint64_t{}, std::declval<bool (*)(const uint64_t*, size_t)>()))>>
+    : std::true_type {};
+
+/**
+ * @brief Detects indexes with order statistics (rank and select)
+ */
+template <typename Index, typename = void>
+struct HasOrderStatistics : std::false_type {};
+
+template <typename Index>
+struct HasOrderStatistics<Index, std::void_t<decltype(std::declval<const Index&>().rank(uint64_t{})),
+                                             decltype(std::declval<const Index&>().select(size_t{}))>>
+    : std::true_type {};
+
+/**
+ * @brief Detects indexes that keep their order in a lazily rebuilt view (HashIndex)
+ * @details Their scan() refreshes the view, so it must not run alongside another reader.
+ */
+template <typename Index, typename = void>
+struct HasLazySortedView : std::false_type {};
+
+template <typename Index>
+struct HasLazySortedView<Index, std::enable_if_t<Index::kLazySortedView>> : std::true_type {};
+
+/**
+ * @brief Number -> timestamp store split into key-range shards with one lock each
+ *
+ * @details The key space [0, key_space] is cut into shard_count equal-width ranges; any
+ *          number above key_space lands in the last shard. Every shard owns its own mutex
+ *          and ordered Index (BtreeIndex, RoaringIndex, ...), so point operations lock
+ *          exactly one shard and operations on different ranges proceed in parallel.
+ *          The mutex is a reader-writer lock: lookups (find, find_batch, size) and scans
+ *          share it, so concurrent readers of one shard only wait for its writers. Only an
+ *          index that rebuilds state while scanning (HashIndex) takes it exclusively to scan.
+ *          Because shards are ordered by range, walking them in index order yields globally
+ *          sorted output without ever holding more than one shard lock. Node-based indexes
+ *          allocate from per-shard pools, so shards never contend on the global allocator
+ *          either.
+ *
+ *          Snapshots use multi-versioning by undo log. Every mutation takes the next store
+ *          version; while a snapshot older than that version is open, the shard also logs
+ *          what the mutation replaced. A snapshot reads the live index chunk by chunk and
+ *          patches it with the earliest logged change after its version for each key, so it
+ *          sees the set as it was, while writers only ever wait for one chunk. Log records
+ *          are trimmed once every open snapshot is newer than them. clear() does not log the
+ *          entries it drops: it swaps in an empty index and keeps the old one as a retired
+ *          generation, which older snapshots read in place of the live index until they close.
+ *
+ *          Each shard counts its numbers per insertion second, which gives stats() the time
+ *          range and lets erase_inserted_before() skip or swap out whole shards. With the
+ *          expiry index (on unless turned off; make_number_store turns it off for roaring),
+ *          the buckets also list their numbers (about 10 bytes per number), so expiry visits
+ *          only the expiring numbers. Without it a partly expiring shard is walked in full. erase_range() swaps out shards lying wholly inside the range, like
+ *          clear(), and scans just the part of the others that overlaps it.
+ */
+template <typename Index = BtreeIndex>
+class ShardedStore final : public NumberStore {
+public:
+    /**
+     * @brief Construct an empty store
+     * @param shard_count Number of range shards (at least 1)
+     * @param key_space Largest number expected; ranges are spread evenly below it
+     * @param expiry_index List every number in its insertion-time bucket, so expiry does not
+     *        walk the shards it only partly empties
+     */
+    explicit ShardedStore(size_t shard_count = kDefaultShards,
+                          uint64_t key_space = std::numeric_limits<uint64_t>::max(), bool expiry_index = true)
+        : shard_count_(std::max<size_t>(shard_count, 1)),
+          shards_(new Shard[shard_count_]),
+          shard_width_(range_width(key_space, shard_count_)),
+          expiry_index_(expiry_index) {}
+
+    static constexpr size_t kDefaultShards = 16;
+
+    /**
+     * @brief Insert a number unless it already exists
+     * @param number Number to insert
+     * @param ts Timestamp stored when the number is new
+     * @return Stored timestamp (existing one on duplicates) and whether an insertion happened
+     */
+    std::pair<time_t, bool> insert(uint64_t number, time_t ts) override {
+        Shard& shard = shard_for(number);
+        std::lock_guard<std::shared_mutex> lock(shard.mutex);
+        auto result = shard.numbers->insert(number, ts);
+        if (result.second) {
+            commit(shard, number, std::nullopt);
+            track_insert(shard, number, result.first);
+            publish(shard);
+            if (observer_)
+                observer_->on_insert(number, result.first);
+        }
+        return result;
+    }
+
+    /**
+     * @brief Remove a number
+     * @param number Number to remove
+     * @return true if the number was present
+     */
+    bool erase(uint64_t number) override {
+        Shard& shard = shard_for(number);
+        std::lock_guard<std::shared_mutex> lock(shard.mutex);
+        std::optional<time_t> erased = shard.numbers->erase(number);
+        if (!erased)
+            return false;
+        commit(shard, number, erased);
+        track_erase(shard, number, *erased);
+        publish(shard);
+        if (observer_)
+            observer_->on_erase(number);
+        return true;
+    }
+
+    /**
+     * @brief Look up a number under a shared shard lock
+     * @param number Number to look up
+     * @return Its timestamp, or nullopt if absent
+     */
+    std::optional<time_t> find(uint64_t number) const override {
+        const Shard& shard = shards_[shard_index(number)];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.numbers->find(number);
+    }
+
+    /**
+     * @brief Look up a batch, taking each shard's lock shared once
+     */
+    size_t find_batch(const uint64_t* numbers, size_t count, time_t* timestamps, uint8_t* found) const override {
+        std::fill(found, found + (count + 7) / 8, 0);
+        std::vector<uint32_t> order = batch_order(numbers, count);
+        size_t hits = 0;
+        for (size_t begin = 0; begin < count;) {
+            size_t index = shard_index(numbers[order[begin]]);
+            const Shard& shard = shards_[index];
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            size_t end = begin;
+            for (; end < count && shard_index(numbers[order[end]]) == index; ++end) {
+                uint32_t i = order[end];
+                std::optional<time_t> ts = shard.numbers->find(numbers[i]);
+                timestamps[i] = ts.value_or(0);
+                if (ts) {
+                    found[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+                    ++hits;
+                }
+            }
+            begin = end;
+        }
+        return hits;
+    }
+
+    /**
+     * @brief Count numbers below a number: shard sizes before its shard, then the index
+     * @details Each shard is read under its own shared lock, so the count is consistent per
+     *          shard like size(). Indexes without order statistics are scanned instead.
+     */
+    size_t rank(uint64_t number) const override {
+        size_t target = shard_index(number);
+        size_t below = 0;
+        for (size_t i = 0; i < target; ++i) {
+            std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+            below += shards_[i].numbers->size();
+        }
+        const Shard& shard = shards_[target];
+        if constexpr (HasOrderStatistics<Index>::value) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            return below + shard.numbers->rank(number);
+        } else {
+            ScanLock lock(shard.mutex);
+            shard.numbers->scan(0, [&](uint64_t stored, time_t) {
+                if (stored >= number)
+                    return false;
+                ++below;
+                return true;
+            });
+            return below;
+        }
+    }
+
+    /**
+     * @brief Entry at position k: skip whole shards by size, then select within one
+     */
+    std::optional<StoreEntry> select(uint64_t k) const override {
+        for (size_t i = 0; i < shard_count_; ++i) {
+            const Shard& shard = shards_[i];
+            if constexpr (HasOrderStatistics<Index>::value) {
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                if (k < shard.numbers->size())
+                    return shard.numbers->select(static_cast<size_t>(k));
+                k -= shard.numbers->size();
+            } else {
+                ScanLock lock(shard.mutex);
+                if (k >= shard.numbers->size()) {
+                    k -= shard.numbers->size();
+                    continue;
+                }
+                std::optional<StoreEntry> found;
+                shard.numbers->scan(0, [&](uint64_t number, time_t ts) {
+                    if (k-- > 0)
+                        return true;
+                    found = StoreEntry{number, ts};
+                    return false;
+                });
+                return found;
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Insert a batch, locking each shard once
+     * @details The batch is sorted first, so every shard's run of numbers is applied in key
+     *          order under a single lock acquisition.
+     */
+    size_t insert_batch(const uint64_t* numbers, size_t count, time_t ts, uint8_t* inserted) override {
+        return apply_batch(numbers, count, inserted, [&](Shard& shard, uint64_t number) {
+            auto result = shard.numbers->insert(number, ts);
+            if (!result.second)
+                return false;
+            commit(shard, number, std::nullopt);
+            track_insert(shard, number, result.first);
+            if (observer_)
+                observer_->on_insert(number, result.first);
+            return true;
+        });
+    }
+
+    /**
+     * @brief Remove a batch, locking each shard once
+     */
+    size_t erase_batch(const uint64_t* numbers, size_t count, uint8_t* erased) override {
+        return apply_batch(numbers, count, erased, [&](Shard& shard, uint64_t number) {
+            std::optional<time_t> before = shard.numbers->erase(number);
+            if (!before)
+                return false;
+            commit(shard, number, before);
+            track_erase(shard, number, *before);
+            if (observer_)
+                observer_->on_erase(number);
+            return true;
+        });
+    }
+
+    /**
+     * @brief Remove every number in [lo, hi]
+     * @details Shards inside the range are swapped for an empty index as in clear(), in
+     *          constant time. The one or two shards the range cuts are scanned from lo and
+     *          erased kEraseChunk numbers per lock hold, so the cost follows the removed span.
+     * @return Number of entries removed
+     */
+    size_t erase_range(uint64_t lo, uint64_t hi) override {
+        size_t removed = 0;
+        for (size_t i = shard_index(lo); lo <= hi && i <= shard_index(hi); ++i) {
+            if (lo > shard_first(i) || hi < shard_last(i))
+                removed += erase_shard_range(i, std::max(lo, shard_first(i)), std::min(hi, shard_last(i)));
+            else
+                removed += clear_shard(i);
+        }
+        return removed;
+    }
+
+    /**
+     * @brief Remove every number inserted before ts
+     * @details Shards whose oldest number is recent enough are skipped on their published
+     *          summary without locking. A shard that expires entirely is swapped out as in
+     *          clear(); otherwise its oldest time buckets are drained with the expiry index,
+     *          or the shard is walked without it, kEraseChunk entries per lock hold.
+     * @return Number of entries removed
+     */
+    size_t erase_inserted_before(time_t ts) override {
+        size_t removed = 0;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            StoreStats summary = read_summary(shards_[i].summary);
+            if (summary.count != 0 && summary.oldest < ts)
+                removed += erase_shard_before(i, ts);
+        }
+        return removed;
+    }
+
+    /**
+     * @brief Copy entries with number >= from in ascending order
+     * @details Shards are visited in range order, each under its own lock only, so writers
+     *          to other shards are never blocked; the view is consistent per shard. The lock
+     *          is shared unless the index scans through a lazy view, so lookups keep going.
+     * @param from Smallest number of interest
+     * @param out Destination buffer
+     * @param max Capacity of out
+     * @return Entries written
+     */
+    size_t read(uint64_t from, StoreEntry* out, size_t max) const override {
+        size_t n = 0;
+        for (size_t i = shard_index(from); i < shard_count_ && n < max; ++i) {
+            const Shard& shard = shards_[i];
+            ScanLock lock(shard.mutex);
+            shard.numbers->scan(from, [&](uint64_t number, time_t ts) {
+                out[n++] = {number, ts};
+                return n < max;
+            });
+        }
+        return n;
+    }
+
+    /**
+     * @brief Copy numbers >= from in ascending order, without their timestamps
+     * @details Indexes with a number column (scan_numbers) are copied span by span.
+     * @param from Smallest number of interest
+     * @param out Destination buffer
+     * @param max Capacity of out
+     * @return Numbers written
+     */
+    size_t read_numbers(uint64_t from, uint64_t* out, size_t max) const override {
+        size_t n = 0;
+        for (size_t i = shard_index(from); i < shard_count_ && n < max; ++i) {
+            const Shard& shard = shards_[i];
+            ScanLock lock(shard.mutex);
+            if constexpr (HasNumberScan<Index>::value) {
+                shard.numbers->scan_numbers(from, [&](const uint64_t* numbers, size_t count) {
+                    size_t take = std::min(count, max - n);
+                    std::copy(numbers, numbers + take, out + n);
+                    n += take;
+                    return n < max;
+                });
+            } else {
+                shard.numbers->scan(from, [&](uint64_t number, time_t) {
+                    out[n++] = number;
+                    return n < max;
+                });
+            }
+        }
+        return n;
+    }
+
+    /**
+     * @brief Remove every number, one shard at a time
+     * @details Each shard swaps in an empty index, so the lock is held for constant time
+     *          however large the shard was. The old index goes to the Reclaimer, or is kept
+     *          as a retired generation while an older snapshot may still read it.
+     * @return Number of entries removed
+     */
+    size_t clear() override {
+        size_t removed = 0;
+        for (size_t i = 0; i < shard_count_; ++i)
+            removed += clear_shard(i);
+        return removed;
+    }
+
+    /**
+     * @brief Total number of stored entries (sum of per-shard sizes)
+     */
+    size_t size() const override {
+        size_t total = 0;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+            total += shards_[i].numbers->size();
+        }
+        return total;
+    }
+
+    /**
+     * @brief Allocator statistics summed over every shard
+     */
+    PoolStats allocator_stats() const override {
+        PoolStats total;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+            total += shards_[i].numbers->allocator_stats();
+        }
+        return total;
+    }
+
+    /**
+     * @brief Count, bounds, insertion-time range and memory, in O(shards) without locking
+     * @details Writers keep a summary per shard up to date as they go and publish it through
+     *          a sequence counter, so this only copies shard_count small records and never
+     *          locks. Each shard's record is consistent; across shards the totals may mix
+     *          moments.
+     */
+    StoreStats stats() const override {
+        StoreStats total;
+        bool any = false;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            StoreStats shard = read_summary(shards_[i].summary);
+            if (shard.count == 0) {
+                total.memory_bytes += shard.memory_bytes;
+                continue;
+            }
+            total.count += shard.count;
+            total.min = any ? std::min(total.min, shard.min) : shard.min;
+            total.max = any ? std::max(total.max, shard.max) : shard.max;
+            total.oldest = any ? std::min(total.oldest, shard.oldest) : shard.oldest;
+            total.newest = any ? std::max(total.newest, shard.newest) : shard.newest;
+            total.memory_bytes += shard.memory_bytes;
+            any = true;
+        }
+        return total;
+    }
+
+    /**
+     * @brief Take a point-in-time view; writers keep going while it is read
+     * @return Snapshot valid until released; must not outlive the store
+     */
+    std::unique_ptr<StoreSnapshot> snapshot() const override {
+        std::lock_guard<std::mutex> lock(snapshot_mutex_);
+        // Two-phase publish: advertise a lower bound first, then read the real version.
+        // A writer that missed the bound took its version before that second read, so its
+        // change is part of the snapshot; every later writer sees the bound and logs.
+        uint64_t bound = version_.load();
+        if (bound < oldest_snapshot_.load())
+            oldest_snapshot_.store(bound);
+        uint64_t version = version_.load();
+        open_snapshots_.insert(version);
+        oldest_snapshot_.store(*open_snapshots_.begin());
+        return std::make_unique<Snapshot>(*this, version);
+    }
+
+    size_t shard_count() const { return shard_count_; }
+
+private:
+    /**
+     * @brief What one mutation replaced, kept while an older snapshot may need it
+     */
+    struct UndoRecord {
+        uint64_t version;  // version of the mutation
+        uint64_t number;
+        time_t ts;         // timestamp the number had before, when existed
+        bool existed;      // number was present before the mutation
+    };
+
+    /**
+     * @brief Index swapped out (clear, range or expiry) while an older snapshot was open
+     */
+    struct Retired {
+        uint64_t version;  // version of the swap
+        std::unique_ptr<Index> numbers;
+    };
+
+    /**
+     * @brief Numbers inserted with one timestamp
+     * @details numbers is only filled with the expiry index on. Erasing a number only lowers
+     *          live; its entry lingers until the bucket is compacted or dropped, and is told
+     *          apart by the index holding another timestamp for it (or none).
+     */
+    struct TimeBucket {
+        uint64_t live = 0;              // stored numbers that have this timestamp
+        std::vector<uint64_t> numbers;  // every number inserted with it, stale ones included
+    };
+
+    using TimeIndex = std::map<time_t, TimeBucket>;  // insertion time -> its numbers
+
+    // Lock held while scanning a shard: shared, unless scan() refreshes a lazy view
+    using ScanLock = std::conditional_t<HasLazySortedView<Index>::value, std::unique_lock<std::shared_mutex>,
+                                        std::shared_lock<std::shared_mutex>>;
+
+    /**
+     * @brief A shard's StoreStats, written under the shard lock and read without it
+     * @details Sequence lock: the writer makes seq odd, stores the fields, then makes it
+     *          even again; a reader retries until it sees the same even seq on both sides.
+     */
+    struct Summary {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> min{0};
+        std::atomic<uint64_t> max{0};
+        std::atomic<int64_t> oldest{0};
+        std::atomic<int64_t> newest{0};
+        std::atomic<uint64_t> memory_bytes{0};
+    };
+
+    // Each shard sits on its own cache lines so locking one never bounces another
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;  // exclusive for writes, shared for lookups and scans (see ScanLock)
+        std::unique_ptr<Index> numbers = std::make_unique<Index>();
+        std::deque<UndoRecord> undo;  // ascending versions
+        uint64_t undo_base = 0;       // position of undo.front() since the shard was created
+        std::deque<Retired> retired;  // ascending versions
+        uint64_t min = 0;             // smallest and largest number, while not empty
+        uint64_t max = 0;
+        TimeIndex times;              // oldest and newest insertion time are its ends
+        Summary summary;              // published copy of the above, for stats()
+    };
+
+    static constexpr uint64_t kNoSnapshot = std::numeric_limits<uint64_t>::max();
+    static constexpr size_t kEraseChunk = kReadChunk;  // most entries a range or expiry erase per lock hold
+    static constexpr size_t kBucketSlack = 64;         // stale entries a time bucket may always carry
+
+    size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+    uint64_t shard_width_;
+    bool expiry_index_;  // time buckets list their numbers
+
+    std::atomic<uint64_t> version_{0};                       // mutations applied so far
+    mutable std::atomic<uint64_t> oldest_snapshot_{kNoSnapshot};  // lower bound of open snapshot versions
+    mutable std::mutex snapshot_mutex_;                      // guards open_snapshots_
+    mutable std::multiset<uint64_t> open_snapshots_;
+
+    /**
+     * @brief Point-in-time reader over the live shards and their undo logs
+     */
+    class Snapshot final : public StoreSnapshot {
+    public:
+        Snapshot(const ShardedStore& store, uint64_t version)
+            : store_(store), version_(version), views_(store.shard_count_) {}
+
+        ~Snapshot() override { store_.release_snapshot(version_); }
+
+        size_t read(uint64_t from, StoreEntry* out, size_t max) const override {
+            size_t n = 0;
+            for (size_t i = store_.shard_index(from); i < store_.shard_count_ && n < max; ++i) {
+                const Shard& shard = store_.shards_[i];
+                ScanLock lock(shard.mutex);
+                n += read_shard(shard, views_[i], from, out + n, max - n);
+            }
+            return n;
+        }
+
+        uint64_t version() const override { return version_; }
+
+    private:
+        // Per shard: how much of the undo log was folded in, and the resulting overrides
+        struct ShardView {
+            uint64_t undo_seen = 0;
+            std::map<uint64_t, std::optional<time_t>> before;  // number -> state as of the snapshot
+        };
+
+        const ShardedStore& store_;
+        uint64_t version_;
+        mutable std::vector<ShardView> views_;
+
+        size_t read_shard(const Shard& shard, ShardView& view, uint64_t from, StoreEntry* out, size_t max) const {
+            // A clear after the snapshot retired the index it must read; later records
+            // describe the fresh index and do not apply
+            const Index* numbers = shard.numbers.get();
+            uint64_t until = std::numeric_limits<uint64_t>::max();
+            for (const Retired& generation : shard.retired) {
+                if (generation.version > version_) {
+                    numbers = generation.numbers.get();
+                    until = generation.version;
+                    break;
+                }
+            }
+
+            // Fold in records logged since the last chunk; the first one per number wins
+            size_t start = view.undo_seen > shard.undo_base ? view.undo_seen - shard.undo_base : 0;
+            for (size_t r = start; r < shard.undo.size(); ++r) {
+                const UndoRecord& rec = shard.undo[r];
+                if (rec.version > version_ && rec.version < until)
+                    view.before.emplace(rec.number, rec.existed ? std::optional<time_t>(rec.ts) : std::nullopt);
+            }
+            view.undo_seen = shard.undo_base + shard.undo.size();
+
+            // Merge the live index with the overrides, in number order
+            size_t n = 0;
+            auto patch = view.before.lower_bound(from);
+            auto emit_patch = [&] {
+                if (patch->second)
+                    out[n++] = {patch->first, *patch->second};
+                ++patch;
+            };
+            numbers->scan(from, [&](uint64_t number, time_t ts) {
+                while (patch != view.before.end() && patch->first < number && n < max)
+                    emit_patch();
+                if (n == max)
+                    return false;
+                if (patch != view.before.end() && patch->first == number)
+                    emit_patch();
+                else
+                    out[n++] = {number, ts};
+                return n < max;
+            });
+            while (patch != view.before.end() && n < max)
+                emit_patch();
+            return n;
+        }
+    };
+
+    uint64_t next_version() { return version_.fetch_add(1) + 1; }
+
+    /**
+     * @brief Run op(shard, number) over a batch in number order, one lock per shard run
+     * @return Number of calls that returned true; their bits are set in the bitmap
+     */
+    template <typename Op>
+    size_t apply_batch(const uint64_t* numbers, size_t count, uint8_t* bitmap, Op&& op) {
+        std::fill(bitmap, bitmap + (count + 7) / 8, 0);
+        std::vector<uint32_t> order = batch_order(numbers, count);
+        size_t applied = 0;
+        for (size_t begin = 0; begin < count;) {
+            size_t index = shard_index(numbers[order[begin]]);
+            Shard& shard = shards_[index];
+            std::lock_guard<std::shared_mutex> lock(shard.mutex);
+            size_t end = begin;
+            for (; end < count && shard_index(numbers[order[end]]) == index; ++end) {
+                uint32_t i = order[end];
+                if (op(shard, numbers[i])) {
+                    bitmap[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+                    ++applied;
+                }
+            }
+            publish(shard);
+            begin = end;
+        }
+        return applied;
+    }
+
+    /**
+     * @brief Swap an empty index into shard i, in constant time
+     * @details The old index goes to the Reclaimer, or is kept as a retired generation while
+     *          an older snapshot may still read it.
+     * @return Number of entries removed
+     */
+    size_t clear_shard(size_t i) {
+        Shard& shard = shards_[i];
+        std::unique_ptr<Index> old;
+        size_t removed;
+        {
+            std::lock_guard<std::shared_mutex> lock(shard.mutex);
+            removed = shard.numbers->size();
+            if (removed == 0)
+                return 0;
+            old = drop_index(shard, i);
+        }
+        Reclaimer::global().retire(std::move(old));
+        return removed;
+    }
+
+    /**
+     * @brief Replace shard i's index with an empty one (caller holds the shard lock)
+     * @return The old index for the caller to retire once unlocked, or nullptr if a snapshot
+     *         still needs it
+     */
+    std::unique_ptr<Index> drop_index(Shard& shard, size_t i) {
+        std::unique_ptr<Index> old = std::exchange(shard.numbers, std::make_unique<Index>());
+        track_clear(shard);
+        publish(shard);
+        uint64_t version = next_version();
+        if (must_log(version))
+            shard.retired.push_back({version, std::move(old)});
+        if (observer_)
+            observer_->on_clear_range(shard_first(i), shard_last(i));
+        return old;
+    }
+
+    /**
+     * @brief Erase the numbers of shard i in [lo, hi], a chunk per lock hold
+     * @details Each chunk is reported as one cleared range ending at its last number, or at
+     *          hi for the final chunk; the shard holds nothing in it once it is reported.
+     */
+    size_t erase_shard_range(size_t i, uint64_t lo, uint64_t hi) {
+        Shard& shard = shards_[i];
+        std::vector<uint64_t> victims;
+        victims.reserve(kEraseChunk);
+        size_t removed = 0;
+        for (;;) {
+            std::lock_guard<std::shared_mutex> lock(shard.mutex);
+            victims.clear();
+            shard.numbers->scan(lo, [&](uint64_t number, time_t) {
+                if (number > hi)
+                    return false;
+                victims.push_back(number);
+                return victims.size() < kEraseChunk;
+            });
+            if (victims.empty())
+                return removed;
+            for (uint64_t number : victims) {
+                std::optional<time_t> before = shard.numbers->erase(number);
+                commit(shard, number, before);
+                track_erase(shard, number, *before);
+            }
+            publish(shard);
+            removed += victims.size();
+            bool last = victims.size() < kEraseChunk || victims.back() >= hi;
+            if (observer_)
+                observer_->on_clear_range(lo, last ? hi : victims.back());
+            if (last)
+                return removed;
+            lo = victims.back() + 1;
+        }
+    }
+
+    /**
+     * @brief Erase the numbers of shard i inserted before ts, a chunk per lock hold
+     * @details With the expiry index, entries are popped off the oldest buckets; stale ones
+     *          are skipped but still count towards the chunk. Without it, the shard is walked
+     *          in number order from a cursor kept across lock holds.
+     */
+    size_t erase_shard_before(size_t i, time_t ts) {
+        Shard& shard = shards_[i];
+        size_t removed = 0;
+        uint64_t from = 0;  // next number to visit when walking the shard
+        for (;;) {
+            std::unique_ptr<Index> old;
+            {
+                std::lock_guard<std::shared_mutex> lock(shard.mutex);
+                if (shard.times.empty() || shard.times.begin()->first >= ts)
+                    return removed;
+                if (shard.times.rbegin()->first < ts) {
+                    removed += shard.numbers->size();
+                    old = drop_index(shard, i);
+                } else {
+                    bool done = false;
+                    removed += expiry_index_ ? drain_buckets(shard, ts) : walk_expired(shard, ts, from, done);
+                    publish(shard);
+                    if (done)
+                        return removed;
+                    continue;
+                }
+            }
+            Reclaimer::global().retire(std::move(old));
+            return removed;
+        }
+    }
+
+    /**
+     * @brief Pop up to kEraseChunk entries off the buckets older than ts (caller holds the shard lock)
+     * @return Number of entries erased
+     */
+    size_t drain_buckets(Shard& shard, time_t ts) {
+        size_t removed = 0;
+        for (size_t budget = kEraseChunk; budget > 0; --budget) {
+            auto bucket = shard.times.begin();
+            if (bucket == shard.times.end() || bucket->first >= ts)
+                break;
+            if (bucket->second.numbers.empty()) {
+                shard.times.erase(bucket);  // cannot happen while live counts are right
+                continue;
+            }
+            time_t stamp = bucket->first;
+            uint64_t number = bucket->second.numbers.back();
+            bucket->second.numbers.pop_back();
+            std::optional<time_t> before = shard.numbers->find(number);
+            if (before != stamp)
+                continue;  // erased since, or reinserted later
+            shard.numbers->erase(number);
+            commit(shard, number, before);
+            track_erase(shard, number, stamp);
+            if (observer_)
+                observer_->on_erase(number);
+            ++removed;
+        }
+        return removed;
+    }
+
+    /**
+     * @brief Visit up to kEraseChunk entries from `from` and erase those older than ts
+     * @details Caller holds the shard lock. Advances from past the visited entries and sets
+     *          done once the walk reached the end of the shard.
+     * @return Number of entries erased
+     */
+    size_t walk_expired(Shard& shard, time_t ts, uint64_t& from, bool& done) {
+        std::vector<uint64_t> victims;
+        size_t visited = 0;
+        uint64_t last = from;
+        shard.numbers->scan(from, [&](uint64_t number, time_t stamp) {
+            if (stamp < ts)
+                victims.push_back(number);
+            last = number;
+            return ++visited < kEraseChunk;
+        });
+        for (uint64_t number : victims) {
+            std::optional<time_t> before = shard.numbers->erase(number);
+            commit(shard, number, before);
+            track_erase(shard, number, *before);
+            if (observer_)
+                observer_->on_erase(number);
+        }
+        done = visited < kEraseChunk || last == std::numeric_limits<uint64_t>::max();
+        from = last + 1;
+        return victims.size();
+    }
+
+    /**
+     * @brief Account for a new number (caller holds the shard lock; publish() afterwards)
+     */
+    void track_insert(Shard& shard, uint64_t number, time_t ts) const {
+        bool first = shard.numbers->size() == 1;
+        shard.min = first ? number : std::min(shard.min, number);
+        shard.max = first ? number : std::max(shard.max, number);
+        TimeBucket& bucket = shard.times[ts];
+        ++bucket.live;
+        if (expiry_index_)
+            bucket.numbers.push_back(number);
+    }
+
+    /**
+     * @brief Account for a removed number (caller holds the shard lock; publish() afterwards)
+     * @details Removing the smallest or largest number looks the new one up in the index:
+     *          a walk down one edge of the tree, or a few pops off HashIndex's edge heaps.
+     */
+    static void track_erase(Shard& shard, uint64_t number, time_t ts) {
+        auto it = shard.times.find(ts);
+        if (it != shard.times.end()) {
+            if (--it->second.live == 0)
+                shard.times.erase(it);
+            else if (it->second.numbers.size() > 2 * it->second.live + kBucketSlack)
+                compact_bucket(shard, it->first, it->second);
+        }
+        if (shard.numbers->size() == 0) {
+            shard.min = shard.max = 0;
+            return;
+        }
+        if (number == shard.min)
+            shard.min = *shard.numbers->first();
+        if (number == shard.max)
+            shard.max = *shard.numbers->last();
+    }
+
+    /**
+     * @brief Drop a bucket's stale entries once they outnumber its live ones
+     * @details Costs O(b log b) for a bucket of b entries, paid for by the b / 2 erasures
+     *          that left them behind.
+     */
+    static void compact_bucket(const Shard& shard, time_t ts, TimeBucket& bucket) {
+        std::vector<uint64_t>& numbers = bucket.numbers;
+        std::sort(numbers.begin(), numbers.end());
+        numbers.erase(std::unique(numbers.begin(), numbers.end()), numbers.end());
+        numbers.erase(std::remove_if(numbers.begin(), numbers.end(),
+                                     [&](uint64_t number) { return shard.numbers->find(number) != ts; }),
+                      numbers.end());
+        numbers.shrink_to_fit();
+    }
+
+    /**
+     * @brief Reset the accounting after clear() swapped in an empty index
+     */
+    static void track_clear(Shard& shard) {
+        if (!shard.times.empty())
+            Reclaimer::global().retire(std::make_unique<TimeIndex>(std::exchange(shard.times, TimeIndex())));
+        shard.min = shard.max = 0;
+    }
+
+    /**
+     * @brief Publish the shard's accounting to stats() readers (caller holds the shard lock)
+     */
+    static void publish(Shard& shard) {
+        Summary& summary = shard.summary;
+        uint64_t seq = summary.seq.load(std::memory_order_relaxed);
+        summary.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bool empty = shard.times.empty();
+        summary.count.store(shard.numbers->size(), std::memory_order_relaxed);
+        summary.min.store(shard.min, std::memory_order_relaxed);
+        summary.max.store(shard.max, std::memory_order_relaxed);
+        summary.oldest.store(empty ? 0 : shard.times.begin()->first, std::memory_order_relaxed);
+        summary.newest.store(empty ? 0 : shard.times.rbegin()->first, std::memory_order_relaxed);
+        summary.memory_bytes.store(shard.numbers->allocator_stats().reserved_bytes, std::memory_order_relaxed);
+        summary.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    static StoreStats read_summary(const Summary& summary) {
+        for (;;) {
+            uint64_t seq = summary.seq.load(std::memory_order_acquire);
+            if (seq & 1)
+                continue;  // a writer is mid-update; it only stores a few words
+            StoreStats stats;
+            stats.count = summary.count.load(std::memory_order_relaxed);
+            stats.min = summary.min.load(std::memory_order_relaxed);
+            stats.max = summary.max.load(std::memory_order_relaxed);
+            stats.oldest = static_cast<time_t>(summary.oldest.load(std::memory_order_relaxed));
+            stats.newest = static_cast<time_t>(summary.newest.load(std::memory_order_relaxed));
+            stats.memory_bytes = summary.memory_bytes.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (summary.seq.load(std::memory_order_relaxed) == seq)
+                return stats;
+        }
+    }
+
+    bool must_log(uint64_t version) const { return oldest_snapshot_.load() < version; }
+
+    /**
+     * @brief Stamp a mutation with the next version and log it if an open snapshot predates it
+     * @param before Timestamp the number had, or nullopt if it was absent
+     */
+    void commit(Shard& shard, uint64_t number, std::optional<time_t> before) {
+        uint64_t version = next_version();
+        if (must_log(version))
+            shard.undo.push_back({version, number, before.value_or(0), before.has_value()});
+        else if (!shard.undo.empty() || !shard.retired.empty())
+            trim_undo(shard);
+    }
+
+    /**
+     * @brief Drop records and retired indexes no open snapshot can need (caller holds the shard lock)
+     */
+    void trim_undo(Shard& shard) const {
+        uint64_t oldest = oldest_snapshot_.load();
+        while (!shard.undo.empty() && shard.undo.front().version <= oldest) {
+            shard.undo.pop_front();
+            ++shard.undo_base;
+        }
+        while (!shard.retired.empty() && shard.retired.front().version <= oldest) {
+            Reclaimer::global().retire(std::move(shard.retired.front().numbers));
+            shard.retired.pop_front();
+        }
+    }
+
+    void release_snapshot(uint64_t version) const {
+        {
+            std::lock_guard<std::mutex> lock(snapshot_mutex_);
+            open_snapshots_.erase(open_snapshots_.find(version));
+            oldest_snapshot_.store(open_snapshots_.empty() ? kNoSnapshot : *open_snapshots_.begin());
+        }
+        for (size_t i = 0; i < shard_count_; ++i) {
+            Shard& shard = shards_[i];
+            std::lock_guard<std::shared_mutex> lock(shard.mutex);
+            trim_undo(shard);
+        }
+    }
+
+    static uint64_t range_width(uint64_t key_space, size_t shard_count) {
+        uint64_t width = key_space / shard_count;
+        return width == std::numeric_limits<uint64_t>::max() ? width : width + 1;
+    }
+
+    size_t shard_index(uint64_t number) const {
+        return static_cast<size_t>(std::min<uint64_t>(number / shard_width_, shard_count_ - 1));
+    }
+
+    Shard& shard_for(uint64_t number) { return shards_[shard_index(number)]; }
+
+    uint64_t shard_first(size_t i) const { return static_cast<uint64_t>(i) * shard_width_; }
+
+    uint64_t shard_last(size_t i) const {
+        return i + 1 == shard_count_ ? std::numeric_limits<uint64_t>::max() : shard_first(i + 1) - 1;
+    }
+};
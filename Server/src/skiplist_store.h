@@ -0,0 +1,435 @@
+// skiplist_store.h
+#pragma once
+
+#include "epoch.h"
+#include "number_store.h"
+#include "reclaimer.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <utility>
+
+/**
+ * @brief Lock-free ordered number store backed by a concurrent skip list
+ *
+ * @details Follows the Harris/Fraser design: a node is logically deleted by setting the
+ *          mark bit in its next pointers (top level first, level 0 last; whoever marks level
+ *          0 owns the deletion) and physically unlinked by any traversal that meets it.
+ *          Insert, erase and read never block one another; a reader walking level 0 sees
+ *          every entry that stays present for the whole walk.
+ *
+ *          Nodes are reclaimed through the process-wide EpochDomain. A node may only be
+ *          retired once it is unreachable at every level, so each node counts the levels
+ *          still linked; the thread whose unlink (or abandoned link) brings the count to
+ *          zero retires it. clear() swaps in a fresh list and hands the old one to the
+ *          Reclaimer, which waits out the grace period itself and then frees its nodes in the
+ *          background; the list never sits in a thread's limbo waiting for that thread to
+ *          retire more.
+ *
+ *          With a MutationObserver attached, insert and erase hold one of a fixed set of
+ *          striped locks (chosen by number) around the change and its notification, so the
+ *          observer sees the changes to each number in the order they took effect.
+ *
+ *          stats() is O(log n): the count and node bytes are kept in atomics and the number
+ *          bounds come from the ends of the list. The insertion-time range covers every entry
+ *          inserted since the last clear and is not narrowed by erases, so it is a bound rather
+ *          than the exact range of what is left.
+ */
+class SkipListStore final : public NumberStore {
+public:
+    SkipListStore() : list_(new List) {}
+
+    ~SkipListStore() override { delete list_.load(); }
+
+    SkipListStore(const SkipListStore&) = delete;
+    SkipListStore& operator=(const SkipListStore&) = delete;
+
+    std::pair<time_t, bool> insert(uint64_t number, time_t ts) override {
+        if (!observer_)
+            return insert_node(number, ts);
+        std::lock_guard<std::mutex> lock(stripe_for(number));
+        auto result = insert_node(number, ts);
+        if (result.second)
+            observer_->on_insert(number, ts);
+        return result;
+    }
+
+    bool erase(uint64_t number) override {
+        if (!observer_)
+            return erase_node(number);
+        std::lock_guard<std::mutex> lock(stripe_for(number));
+        bool erased = erase_node(number);
+        if (erased)
+            observer_->on_erase(number);
+        return erased;
+    }
+
+    size_t read(uint64_t from, StoreEntry* out, size_t max) const override {
+        auto guard = domain().pin();
+
+        // Descend without helping unlink; marked nodes still point forward in key order
+        Node* pred = list_.load(std::memory_order_acquire)->head;
+        Node* curr = nullptr;
+        for (int l = kMaxHeight - 1; l >= 0; --l) {
+            curr = ptr(pred->next[l].load(std::memory_order_acquire));
+            while (curr && curr->key < from) {
+                pred = curr;
+                curr = ptr(curr->next[l].load(std::memory_order_acquire));
+            }
+        }
+
+        size_t n = 0;
+        for (; curr && n < max; curr = ptr(curr->next[0].load(std::memory_order_acquire)))
+            if (!marked(curr->next[0].load(std::memory_order_acquire)))
+                out[n++] = {curr->key, curr->ts};
+        return n;
+    }
+
+    /**
+     * @brief Swap in an empty list; the old one is freed in the background
+     * @details Operations still running on the old list notice the swap and redo their work
+     *          on the new one. With an observer attached every stripe lock is held across the
+     *          swap, so the clear is ordered against each number's other notifications.
+     */
+    size_t clear() override {
+        std::unique_ptr<std::unique_lock<std::mutex>[]> locks;
+        if (observer_) {
+            locks.reset(new std::unique_lock<std::mutex>[kStripes]);
+            for (size_t i = 0; i < kStripes; ++i)
+                locks[i] = std::unique_lock<std::mutex>(stripes_[i].mutex);
+        }
+        List* old = list_.exchange(new List, std::memory_order_acq_rel);
+        size_t removed = old->size.load(std::memory_order_relaxed);
+        if (observer_)
+            observer_->on_clear_range(0, std::numeric_limits<uint64_t>::max());
+        // The reclaimer frees it once no pinned thread can still be walking it
+        Reclaimer::global().retire(std::make_unique<RetiredList>(old, domain().retire_epoch()));
+        return removed;
+    }
+
+    size_t size() const override {
+        auto guard = domain().pin();
+        return list_.load(std::memory_order_acquire)->size.load(std::memory_order_relaxed);
+    }
+
+    StoreStats stats() const override {
+        auto guard = domain().pin();
+        const List& list = *list_.load(std::memory_order_acquire);
+        StoreStats stats;
+        stats.count = list.size.load(std::memory_order_relaxed);
+        stats.memory_bytes = list.bytes.load(std::memory_order_relaxed);
+        auto min = first_key(list);
+        auto max = last_key(list);
+        if (!min || !max)
+            return stats;  // emptied under us; count may still lag by the racing erase
+        stats.min = *min;
+        stats.max = *max;
+        stats.oldest = list.oldest.load(std::memory_order_relaxed);
+        stats.newest = list.newest.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    static constexpr int kMaxHeight = 20;  // p = 1/4 covers ~4^20 entries
+    static constexpr uintptr_t kMark = 1;
+    static constexpr size_t kStripes = 64;
+
+    struct Node {
+        uint64_t key;
+        time_t ts;
+        int height;
+        std::atomic<int> linked_levels;         // levels not yet unlinked or abandoned
+        std::atomic<uintptr_t> next[1];         // really `height` entries; low bit = deleted mark
+    };
+
+    struct alignas(64) Stripe {
+        std::mutex mutex;
+    };
+
+    /**
+     * @brief One generation of the skip list; clear() replaces the whole thing
+     */
+    struct List {
+        Node* head = new_node(0, 0, kMaxHeight);
+        std::atomic<size_t> size{0};
+        std::atomic<size_t> bytes{0};  // node memory of the linked entries
+        std::atomic<time_t> oldest{std::numeric_limits<time_t>::max()};  // over every insert, not narrowed by erase
+        std::atomic<time_t> newest{std::numeric_limits<time_t>::min()};
+        int level = kMaxHeight - 1;  // release_some() progress
+        Node* cursor = nullptr;
+
+        List() = default;
+        List(const List&) = delete;
+        List& operator=(const List&) = delete;
+
+        ~List() {
+            while (!release_some(std::numeric_limits<size_t>::max())) {
+            }
+        }
+
+        /**
+         * @brief Free about `bytes` of nodes of a list nobody can reach any more
+         * @details Walks the levels top-down and drops one link per visit; a node is freed
+         *          at the last level it is linked at, so each is freed exactly once. Nodes
+         *          already fully unlinked were retired to the epoch domain and are not seen.
+         * @return true once every node, the head included, is gone
+         */
+        bool release_some(size_t bytes) {
+            if (!head)
+                return true;
+            size_t released = 0;
+            while (released < bytes) {
+                if (!cursor) {
+                    if (level < 0) {
+                        free_node(head);
+                        head = nullptr;
+                        return true;
+                    }
+                    cursor = ptr(head->next[level--].load());
+                    continue;
+                }
+                Node* node = cursor;
+                cursor = ptr(node->next[level + 1].load());
+                if (node->linked_levels.fetch_sub(1, std::memory_order_relaxed) == 1) {
+                    released += node_bytes(node->height);
+                    free_node(node);
+                }
+            }
+            return false;
+        }
+    };
+
+    /**
+     * @brief A list swapped out by clear(), freed by the Reclaimer after its grace period
+     */
+    struct RetiredList {
+        RetiredList(List* list, uint64_t epoch) : list(list), epoch(epoch) {}
+
+        bool release_some(size_t bytes) { return domain().synchronized(epoch) && list->release_some(bytes); }
+
+        std::unique_ptr<List> list;
+        uint64_t epoch;  // retire epoch of the swap
+    };
+
+    std::atomic<List*> list_;
+    std::unique_ptr<Stripe[]> stripes_{new Stripe[kStripes]};  // order observer calls per key
+
+    std::mutex& stripe_for(uint64_t number) { return stripes_[(number * 0x9E3779B97F4A7C15ull) >> 58].mutex; }
+
+    std::pair<time_t, bool> insert_node(uint64_t number, time_t ts) {
+        auto guard = domain().pin();
+        for (;;) {
+            List* list = list_.load(std::memory_order_acquire);
+            auto result = insert_into(*list, number, ts);
+            if (list_.load(std::memory_order_acquire) == list)
+                return result;  // otherwise a clear overtook us; the old list no longer counts
+        }
+    }
+
+    bool erase_node(uint64_t number) {
+        auto guard = domain().pin();
+        for (;;) {
+            List* list = list_.load(std::memory_order_acquire);
+            bool erased = erase_from(*list, number);
+            if (list_.load(std::memory_order_acquire) == list)
+                return erased;
+        }
+    }
+
+    std::pair<time_t, bool> insert_into(List& list, uint64_t number, time_t ts) {
+        Node* preds[kMaxHeight];
+        Node* succs[kMaxHeight];
+        Node* node = nullptr;
+        int height = random_height();
+
+        for (;;) {
+            if (find(list, number, preds, succs)) {
+                time_t existing = succs[0]->ts;
+                if (node)
+                    free_node(node);  // never published
+                return {existing, false};
+            }
+            if (!node)
+                node = new_node(number, ts, height);
+            for (int l = 0; l < height; ++l)
+                node->next[l].store(raw(succs[l]), std::memory_order_relaxed);
+
+            uintptr_t expected = raw(succs[0]);
+            if (preds[0]->next[0].compare_exchange_strong(expected, raw(node)))
+                break;
+        }
+        list.size.fetch_add(1, std::memory_order_relaxed);
+        list.bytes.fetch_add(node_bytes(height), std::memory_order_relaxed);
+        for (time_t t = list.oldest.load(std::memory_order_relaxed); ts < t;)
+            list.oldest.compare_exchange_weak(t, ts, std::memory_order_relaxed);
+        for (time_t t = list.newest.load(std::memory_order_relaxed); ts > t;)
+            list.newest.compare_exchange_weak(t, ts, std::memory_order_relaxed);
+
+        // Linked at level 0 (the linearization point); now build the upper levels
+        for (int l = 1; l < height; ++l) {
+            for (;;) {
+                uintptr_t cur = node->next[l].load();
+                if (marked(cur)) {
+                    abandon_levels(node, height - l);
+                    return {ts, true};
+                }
+                if (cur != raw(succs[l]) && !node->next[l].compare_exchange_strong(cur, raw(succs[l])))
+                    continue;  // lost a race with a concurrent mark; re-check
+                uintptr_t expected = raw(succs[l]);
+                if (preds[l]->next[l].compare_exchange_strong(expected, raw(node)))
+                    break;
+                find(list, number, preds, succs);
+                if (succs[0] != node) {  // deleted meanwhile
+                    abandon_levels(node, height - l);
+                    return {ts, true};
+                }
+            }
+            if (marked(node->next[l].load())) {
+                // Deleted after we linked this level; the deleter may already have passed, so snip it ourselves
+                find(list, number, preds, succs);
+                abandon_levels(node, height - l - 1);
+                return {ts, true};
+            }
+        }
+        return {ts, true};
+    }
+
+    bool erase_from(List& list, uint64_t number) {
+        Node* preds[kMaxHeight];
+        Node* succs[kMaxHeight];
+        if (!find(list, number, preds, succs))
+            return false;
+
+        Node* victim = succs[0];
+        for (int l = victim->height - 1; l >= 1; --l) {
+            uintptr_t next = victim->next[l].load();
+            while (!marked(next))
+                victim->next[l].compare_exchange_weak(next, next | kMark);
+        }
+
+        uintptr_t next = victim->next[0].load();
+        for (;;) {
+            if (marked(next))
+                return false;  // another eraser won
+            if (victim->next[0].compare_exchange_weak(next, next | kMark))
+                break;
+        }
+        list.size.fetch_sub(1, std::memory_order_relaxed);
+        list.bytes.fetch_sub(node_bytes(victim->height), std::memory_order_relaxed);
+        find(list, number, preds, succs);  // unlink from every level
+        return true;
+    }
+
+    static EpochDomain& domain() { return EpochDomain::global(); }
+
+    static bool marked(uintptr_t p) { return p & kMark; }
+    static Node* ptr(uintptr_t p) { return reinterpret_cast<Node*>(p & ~kMark); }
+    static uintptr_t raw(Node* n) { return reinterpret_cast<uintptr_t>(n); }
+
+    static size_t node_bytes(int height) { return sizeof(Node) + (height - 1) * sizeof(std::atomic<uintptr_t>); }
+
+    static Node* new_node(uint64_t key, time_t ts, int height) {
+        void* mem = ::operator new(node_bytes(height));
+        Node* node = static_cast<Node*>(mem);
+        node->key = key;
+        node->ts = ts;
+        node->height = height;
+        new (&node->linked_levels) std::atomic<int>(height);
+        for (int l = 0; l < height; ++l)
+            new (&node->next[l]) std::atomic<uintptr_t>(0);
+        return node;
+    }
+
+    static void free_node(void* p) { ::operator delete(p); }
+
+    static int random_height() {
+        thread_local uint64_t state = 0x9E3779B97F4A7C15ull ^ reinterpret_cast<uintptr_t>(&state);
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        int height = 1;
+        for (uint64_t bits = state; height < kMaxHeight && (bits & 3) == 0; bits >>= 2)
+            ++height;
+        return height;
+    }
+
+    static void release_levels(Node* node, int levels) {
+        if (levels > 0 && node->linked_levels.fetch_sub(levels, std::memory_order_acq_rel) == levels)
+            domain().retire(node, &free_node);
+    }
+
+    static void abandon_levels(Node* node, int levels) { release_levels(node, levels); }
+
+    /**
+     * @brief Smallest live number; skips the marked nodes at the front of level 0
+     */
+    static std::optional<uint64_t> first_key(const List& list) {
+        for (Node* curr = ptr(list.head->next[0].load(std::memory_order_acquire)); curr;
+             curr = ptr(curr->next[0].load(std::memory_order_acquire)))
+            if (!marked(curr->next[0].load(std::memory_order_acquire)))
+                return curr->key;
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Largest live number
+     * @details Descends to the last node below a limit, starting with no limit; if that node
+     *          is marked the descent is repeated below its key. Each retry costs O(log n), and
+     *          there is one per deleted node still linked at the tail.
+     */
+    static std::optional<uint64_t> last_key(const List& list) {
+        std::optional<uint64_t> limit;
+        for (;;) {
+            Node* pred = list.head;
+            for (int l = kMaxHeight - 1; l >= 0; --l) {
+                Node* curr = ptr(pred->next[l].load(std::memory_order_acquire));
+                while (curr && (!limit || curr->key < *limit)) {
+                    pred = curr;
+                    curr = ptr(curr->next[l].load(std::memory_order_acquire));
+                }
+            }
+            if (pred == list.head)
+                return std::nullopt;
+            if (!marked(pred->next[0].load(std::memory_order_acquire)))
+                return pred->key;
+            limit = pred->key;
+        }
+    }
+
+    /**
+     * @brief Locate the predecessors/successors of key at every level, unlinking marked nodes
+     * @return true if an unmarked node with this key is linked at level 0 (succs[0])
+     */
+    bool find(List& list, uint64_t key, Node** preds, Node** succs) const {
+    retry:
+        Node* pred = list.head;
+        for (int l = kMaxHeight - 1; l >= 0; --l) {
+            Node* curr = ptr(pred->next[l].load());
+            while (curr) {
+                uintptr_t succ = curr->next[l].load();
+                if (marked(succ)) {
+                    uintptr_t expected = raw(curr);
+                    if (!pred->next[l].compare_exchange_strong(expected, succ & ~kMark))
+                        goto retry;
+                    release_levels(curr, 1);
+                    curr = ptr(succ);
+                    continue;
+                }
+                if (curr->key >= key)
+                    break;
+                pred = curr;
+                curr = ptr(succ);
+            }
+            preds[l] = pred;
+            succs[l] = curr;
+        }
+        return succs[0] && succs[0]->key == key;
+    }
+};
@@ -0,0 +1,246 @@
+// snapshot_file.cpp
+#include "snapshot_file.h"
+
+#include "crc32c.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+struct SnapshotFile::Header {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t block_entries;
+    uint64_t count;
+    uint64_t block_count;
+    uint64_t index_offset;
+    uint64_t wal_seq;
+    uint32_t index_crc;
+    uint32_t header_crc;  // over every other byte (version 1: every byte before it)
+    uint32_t oldest;      // TimestampCodec offsets of the insertion-time range; version 2 on
+    uint32_t newest;
+};
+
+namespace {
+
+constexpr char kMagic[8] = {'N', 'U', 'M', 'S', 'N', 'A', 'P', '1'};
+constexpr size_t kEntryBytes = sizeof(uint64_t) + sizeof(uint32_t);
+
+size_t index_offset(uint64_t count) {
+    return (64 + count * kEntryBytes + 7) / 8 * 8;  // after the blocks, 8-byte aligned
+}
+
+std::system_error errno_error(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+/**
+ * @brief Owns a file descriptor; closes it on scope exit
+ */
+struct FileHandle {
+    int fd;
+    ~FileHandle() {
+        if (fd >= 0)
+            ::close(fd);
+    }
+};
+
+std::string parent_directory(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+}
+
+}  // namespace
+
+uint32_t SnapshotFile::header_checksum(const Header& header) {
+    uint32_t crc = crc32c(&header, offsetof(Header, header_crc));
+    if (header.format_version < 2)
+        return crc;
+    return crc32c(&header.oldest, sizeof(Header) - offsetof(Header, oldest), crc);
+}
+
+size_t SnapshotFile::write(const std::string& path, const StoreSnapshot& source, uint64_t wal_seq,
+                          FileWriter& writer) {
+    std::string tmp = path + ".tmp";
+    FileHandle file{::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)};
+    if (file.fd < 0)
+        throw errno_error("create " + tmp);
+
+    static_assert(sizeof(Header) == 64, "snapshot header must stay 64 bytes");
+    try {
+        uint64_t offset = sizeof(Header);  // the header goes last, once the counts are known
+        auto append = [&](const void* data, size_t size) {
+            writer.write(file.fd, data, size, offset);
+            offset += size;
+        };
+
+        std::vector<uint64_t> numbers;
+        std::vector<uint32_t> offsets;
+        std::vector<uint64_t> first_numbers;
+        std::vector<uint32_t> block_crcs;
+        numbers.reserve(kBlockEntries);
+        offsets.reserve(kBlockEntries);
+        size_t count = 0;
+        uint32_t oldest = 0;
+        uint32_t newest = 0;
+
+        auto write_block = [&] {
+            uint32_t crc = crc32c(numbers.data(), numbers.size() * sizeof(uint64_t));
+            crc = crc32c(offsets.data(), offsets.size() * sizeof(uint32_t), crc);
+            append(numbers.data(), numbers.size() * sizeof(uint64_t));
+            append(offsets.data(), offsets.size() * sizeof(uint32_t));
+            first_numbers.push_back(numbers.front());
+            block_crcs.push_back(crc);
+            numbers.clear();
+            offsets.clear();
+        };
+
+        source.for_each([&](uint64_t number, time_t ts) {
+            uint32_t offset = TimestampCodec::encode(ts);
+            numbers.push_back(number);
+            offsets.push_back(offset);
+            oldest = count ? std::min(oldest, offset) : offset;
+            newest = count ? std::max(newest, offset) : offset;
+            ++count;
+            if (numbers.size() == kBlockEntries)
+                write_block();
+        });
+        if (!numbers.empty())
+            write_block();
+
+        uint64_t padding = 0;
+        append(&padding, index_offset(count) - offset);
+
+        uint32_t index_crc = crc32c(first_numbers.data(), first_numbers.size() * sizeof(uint64_t));
+        index_crc = crc32c(block_crcs.data(), block_crcs.size() * sizeof(uint32_t), index_crc);
+        append(first_numbers.data(), first_numbers.size() * sizeof(uint64_t));
+        append(block_crcs.data(), block_crcs.size() * sizeof(uint32_t));
+
+        Header header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.format_version = kFormatVersion;
+        header.block_entries = kBlockEntries;
+        header.count = count;
+        header.block_count = first_numbers.size();
+        header.index_offset = index_offset(count);
+        header.wal_seq = wal_seq;
+        header.index_crc = index_crc;
+        header.oldest = oldest;
+        header.newest = newest;
+        header.header_crc = header_checksum(header);
+        writer.write(file.fd, &header, sizeof(header), 0);
+        writer.sync(file.fd);
+
+        if (std::rename(tmp.c_str(), path.c_str()) != 0)
+            throw errno_error("rename " + tmp);
+        FileHandle dir{::open(parent_directory(path).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+        if (dir.fd >= 0)
+            ::fsync(dir.fd);
+        return count;
+    } catch (...) {
+        ::unlink(tmp.c_str());
+        throw;
+    }
+}
+
+std::shared_ptr<const SnapshotFile> SnapshotFile::open(const std::string& path) {
+    FileHandle file{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (file.fd < 0)
+        throw errno_error("open " + path);
+    struct stat st;
+    if (::fstat(file.fd, &st) != 0)
+        throw errno_error("stat " + path);
+    size_t length = static_cast<size_t>(st.st_size);
+    if (length < sizeof(Header))
+        throw std::runtime_error(path + ": too short for a snapshot");
+
+    void* data = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, file.fd, 0);
+    if (data == MAP_FAILED)
+        throw errno_error("mmap " + path);
+
+    std::shared_ptr<SnapshotFile> snapshot(new SnapshotFile());
+    snapshot->data_ = static_cast<const uint8_t*>(data);
+    snapshot->length_ = length;
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0)
+        throw std::runtime_error(path + ": not a snapshot file");
+    if (header.header_crc != header_checksum(header))
+        throw std::runtime_error(path + ": header checksum mismatch");
+    if (header.format_version != kFormatVersion && header.format_version != 1)
+        throw std::runtime_error(path + ": unsupported format version " + std::to_string(header.format_version));
+    if (header.block_entries == 0 || header.block_entries % 2 != 0 ||
+        header.block_count != (header.count + header.block_entries - 1) / header.block_entries ||
+        header.index_offset != index_offset(header.count) ||
+        length != header.index_offset + header.block_count * (sizeof(uint64_t) + sizeof(uint32_t)))
+        throw std::runtime_error(path + ": inconsistent header");
+
+    const uint8_t* index = snapshot->data_ + header.index_offset;
+    size_t index_bytes = length - header.index_offset;
+    if (crc32c(index, index_bytes) != header.index_crc)
+        throw std::runtime_error(path + ": index checksum mismatch");
+
+    snapshot->count_ = header.count;
+    snapshot->block_entries_ = header.block_entries;
+    snapshot->block_count_ = header.block_count;
+    snapshot->wal_seq_ = header.wal_seq;
+    snapshot->has_time_range_ = header.format_version >= 2;
+    if (header.count > 0 && snapshot->has_time_range_) {
+        snapshot->oldest_ = TimestampCodec::decode(header.oldest);
+        snapshot->newest_ = TimestampCodec::decode(header.newest);
+    }
+    snapshot->first_numbers_ = reinterpret_cast<const uint64_t*>(index);
+    snapshot->block_crcs_ = reinterpret_cast<const uint32_t*>(index + header.block_count * sizeof(uint64_t));
+    snapshot->verified_.reset(new std::atomic<bool>[header.block_count]());
+    return snapshot;
+}
+
+SnapshotFile::~SnapshotFile() {
+    if (data_)
+        ::munmap(const_cast<uint8_t*>(data_), length_);
+}
+
+size_t SnapshotFile::lower_bound(uint64_t key) const {
+    // Last block whose first number is <= key, then a search inside it
+    const uint64_t* next = std::upper_bound(first_numbers_, first_numbers_ + block_count_, key);
+    if (next == first_numbers_)
+        return 0;
+    size_t b = static_cast<size_t>(next - first_numbers_) - 1;
+    const uint64_t* numbers = block(b);
+    size_t n = block_size(b);
+    return b * block_entries_ + static_cast<size_t>(std::lower_bound(numbers, numbers + n, key) - numbers);
+}
+
+bool SnapshotFile::find(uint64_t key, time_t& ts) const {
+    size_t i = lower_bound(key);
+    if (i == count_ || number(i) != key)
+        return false;
+    ts = timestamp(i);
+    return true;
+}
+
+size_t SnapshotFile::block_offset(size_t b) const {
+    return sizeof(Header) + b * block_entries_ * kEntryBytes;
+}
+
+void SnapshotFile::verify_block(size_t b) const {
+    size_t bytes = block_size(b) * kEntryBytes;
+    if (crc32c(data_ + block_offset(b), bytes) != block_crcs_[b]) {
+        std::cerr << "snapshot: block " << b << " failed its checksum; aborting" << std::endl;
+        std::abort();
+    }
+    verified_[b].store(true, std::memory_order_release);
+}
@@ -0,0 +1,141 @@
+// snapshot_file.h
+#pragma once
+
+#include "file_writer.h"
+#include "number_store.h"
+#include "timestamp_codec.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Read-only, memory-mapped checkpoint of a NumberStore
+ *
+ * @details File layout (little-endian):
+ *
+ *            header   64 bytes: magic "NUMSNAP1", format version, entries per block, entry
+ *                     count, block count, index offset, first WAL segment to replay on top,
+ *                     CRC-32C of the index and of the header itself, then the oldest and
+ *                     newest timestamp (format 2; format 1 files leave them out)
+ *            blocks   per block of up to kBlockEntries entries: the sorted numbers (uint64)
+ *                     followed by their timestamps (uint32 offsets, see TimestampCodec)
+ *            index    8-byte aligned: first number of every block, then the CRC-32C of every
+ *                     block
+ *
+ *          open() maps the file and checks only the header and the index, so it costs the
+ *          same for any size. Each block is checksummed the first time it is read, so a
+ *          server can answer from the mapping immediately and pay for verification as it
+ *          touches the data. A block that fails its checksum is fatal: the process aborts
+ *          rather than serve corrupt entries.
+ */
+class SnapshotFile {
+public:
+    static constexpr uint32_t kFormatVersion = 2;
+    static constexpr uint32_t kBlockEntries = 4096;
+
+    /**
+     * @brief Write every entry of a snapshot to path, atomically replacing any existing file
+     * @details Writes path + ".tmp", fsyncs it and renames it over path.
+     * @param path Destination file
+     * @param source Entries to write
+     * @param wal_seq First log segment holding mutations that may be missing from source
+     * @param writer I/O implementation used for the file's contents
+     * @return Number of entries written
+     * @throws std::system_error on I/O errors
+     */
+    static size_t write(const std::string& path, const StoreSnapshot& source, uint64_t wal_seq,
+                        FileWriter& writer);
+
+    /**
+     * @brief Map a snapshot file
+     * @param path File written by write()
+     * @return The mapped snapshot
+     * @throws std::system_error if the file cannot be mapped, std::runtime_error if it is invalid
+     */
+    static std::shared_ptr<const SnapshotFile> open(const std::string& path);
+
+    ~SnapshotFile();
+
+    SnapshotFile(const SnapshotFile&) = delete;
+    SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+    size_t size() const { return count_; }
+
+    /**
+     * @brief First log segment to replay on top of this snapshot
+     */
+    uint64_t wal_seq() const { return wal_seq_; }
+
+    /**
+     * @brief Oldest and newest insertion time in the snapshot, both 0 when it is empty
+     * @return false for format 1 files, which do not record them
+     */
+    bool time_range(time_t& oldest, time_t& newest) const {
+        oldest = oldest_;
+        newest = newest_;
+        return has_time_range_;
+    }
+
+    uint64_t number(size_t i) const { return block(i / block_entries_)[i % block_entries_]; }
+
+    time_t timestamp(size_t i) const {
+        size_t b = i / block_entries_;
+        const uint64_t* numbers = block(b);
+        const auto* offsets = reinterpret_cast<const uint32_t*>(numbers + block_size(b));
+        return TimestampCodec::decode(offsets[i % block_entries_]);
+    }
+
+    /**
+     * @brief Position of the first entry with number >= key (size() if none)
+     */
+    size_t lower_bound(uint64_t key) const;
+
+    /**
+     * @brief Look up one number
+     * @param key Number to find
+     * @param ts Its timestamp, if found
+     * @return true if the number is in the snapshot
+     */
+    bool find(uint64_t key, time_t& ts) const;
+
+private:
+    struct Header;
+
+    const uint8_t* data_ = nullptr;
+    size_t length_ = 0;
+    size_t count_ = 0;
+    size_t block_entries_ = 0;
+    size_t block_count_ = 0;
+    uint64_t wal_seq_ = 0;
+    bool has_time_range_ = false;
+    time_t oldest_ = 0;
+    time_t newest_ = 0;
+    const uint64_t* first_numbers_ = nullptr;            // index: first number per block
+    const uint32_t* block_crcs_ = nullptr;               // index: checksum per block
+    std::unique_ptr<std::atomic<bool>[]> verified_;      // blocks checked so far
+
+    SnapshotFile() = default;
+
+    static uint32_t header_checksum(const Header& header);
+
+    size_t block_size(size_t b) const {
+        return b + 1 == block_count_ ? count_ - b * block_entries_ : block_entries_;
+    }
+
+    /**
+     * @brief Numbers of block b, checksummed on first use
+     */
+    const uint64_t* block(size_t b) const {
+        const auto* numbers = reinterpret_cast<const uint64_t*>(data_ + block_offset(b));
+        if (!verified_[b].load(std::memory_order_acquire))
+            verify_block(b);
+        return numbers;
+    }
+
+    size_t block_offset(size_t b) const;
+    void verify_block(size_t b) const;
+};
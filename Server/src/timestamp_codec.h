@@ -0,0 +1,27 @@
+// timestamp_codec.h
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <limits>
+
+/**
+ * @brief Packs unix timestamps into 32-bit offsets from a fixed base epoch
+ *
+ * @details Insertion times are whole seconds close to "now", so storing them as an unsigned
+ *          offset from 2020-01-01 halves the column width and covers dates up to 2156.
+ *          Values outside that window are clamped.
+ */
+struct TimestampCodec {
+    static constexpr time_t kBaseEpoch = 1577836800;  // 2020-01-01T00:00:00Z
+
+    static uint32_t encode(time_t t) {
+        if (t <= kBaseEpoch)
+            return 0;
+        uint64_t offset = static_cast<uint64_t>(t - kBaseEpoch);
+        return offset > std::numeric_limits<uint32_t>::max() ? std::numeric_limits<uint32_t>::max()
+                                                             : static_cast<uint32_t>(offset);
+    }
+
+    static time_t decode(uint32_t offset) { return kBaseEpoch + static_cast<time_t>(offset); }
+};
@@ -0,0 +1,317 @@
+// wal.cpp
+#include "wal.h"
+
+#include "crc32c.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <system_error>
+
+namespace {
+
+constexpr size_t kHeaderBytes = 5;  // crc32c (4) + type (1)
+constexpr size_t kMaxPayload = 16;
+
+thread_local uint64_t t_last_lsn = 0;  // last record appended by this thread
+
+[[noreturn]] void fatal(const std::string& what) {
+    std::cerr << "write-ahead log: " << what << "; aborting" << std::endl;
+    std::abort();
+}
+
+std::system_error errno_error(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+void sync_directory(const std::string& dir) {
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        throw errno_error("open " + dir);
+    ::fsync(fd);
+    ::close(fd);
+}
+
+}  // namespace
+
+WriteAheadLog::WriteAheadLog(WalOptions options) : options_(std::move(options)) {
+    std::error_code ec;
+    std::filesystem::create_directories(options_.directory, ec);
+    if (ec)
+        throw std::system_error(ec, "create " + options_.directory);
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (persister_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;  // the persistence thread drains the buffer before it exits
+        }
+        work_.notify_one();
+        persister_.join();
+    }
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+size_t WriteAheadLog::recover(NumberStore& store, uint64_t first_seq) {
+    std::vector<uint64_t> segments = list_segments();
+    size_t applied = 0;
+    bool torn = false;
+    for (uint64_t seq : segments) {
+        std::string path = segment_path(seq);
+        if (seq < first_seq) {
+            // Left behind by a crash between a checkpoint and its cleanup
+            std::filesystem::remove(path);
+            continue;
+        }
+        if (torn) {
+            // Records after a tear were written after one that is lost; they cannot be applied
+            std::cerr << "write-ahead log: discarding " << path << " after a torn segment" << std::endl;
+            std::filesystem::remove(path);
+            continue;
+        }
+        applied += replay_segment(path, store, torn);
+    }
+
+    open_segment(std::max(segments.empty() ? 1 : segments.back() + 1, first_seq));
+    std::string fallback_reason;
+    writer_ = make_file_writer(options_.use_io_uring, &fallback_reason);
+    if (!fallback_reason.empty())
+        std::cerr << "write-ahead log: io_uring unavailable (" << fallback_reason << "), using pwrite" << std::endl;
+    persister_ = std::thread(&WriteAheadLog::persist_loop, this);
+    return applied;
+}
+
+void WriteAheadLog::on_insert(uint64_t number, time_t ts) {
+    uint8_t payload[16];
+    int64_t seconds = static_cast<int64_t>(ts);
+    std::memcpy(payload, &number, 8);
+    std::memcpy(payload + 8, &seconds, 8);
+    append(RecordType::Insert, payload, sizeof(payload));
+}
+
+void WriteAheadLog::on_erase(uint64_t number) {
+    append(RecordType::Erase, &number, sizeof(number));
+}
+
+void WriteAheadLog::on_clear_range(uint64_t lo, uint64_t hi) {
+    uint8_t payload[16];
+    std::memcpy(payload, &lo, 8);
+    std::memcpy(payload + 8, &hi, 8);
+    append(RecordType::ClearRange, payload, sizeof(payload));
+}
+
+void WriteAheadLog::commit() {
+    if (options_.durability == Durability::Async)
+        return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    wait_durable(lock, t_last_lsn);
+}
+
+void WriteAheadLog::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    wait_durable(lock, appended_lsn_);
+}
+
+uint64_t WriteAheadLog::rotate() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t target = rotations_ + 1;
+    rotate_requested_ = true;
+    work_.notify_one();
+    flushed_.wait(lock, [&] { return rotations_ >= target; });
+    return rotated_seq_;
+}
+
+void WriteAheadLog::remove_segments_before(uint64_t seq) {
+    for (uint64_t old : list_segments()) {
+        if (old >= seq)
+            break;
+        std::filesystem::remove(segment_path(old));
+    }
+}
+
+uint64_t WriteAheadLog::appended() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return appended_lsn_;
+}
+
+bool WriteAheadLog::parse_durability(const std::string& name, Durability& mode) {
+    if (name == "fsync") mode = Durability::Fsync;
+    else if (name == "group") mode = Durability::Group;
+    else if (name == "async") mode = Durability::Async;
+    else return false;
+    return true;
+}
+
+void WriteAheadLog::append(RecordType type, const void* payload, size_t size) {
+    uint8_t record[kHeaderBytes + kMaxPayload];
+    record[4] = static_cast<uint8_t>(type);
+    std::memcpy(record + kHeaderBytes, payload, size);
+    uint32_t crc = crc32c(record + 4, 1 + size);
+    std::memcpy(record, &crc, 4);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer_.insert(buffer_.end(), record, record + kHeaderBytes + size);
+    t_last_lsn = ++appended_lsn_;
+}
+
+/**
+ * @brief Ask the persistence thread for records up to lsn and wait until they are durable
+ */
+void WriteAheadLog::wait_durable(std::unique_lock<std::mutex>& lock, uint64_t lsn) {
+    if (durable_lsn_ >= lsn)
+        return;
+    if (requested_lsn_ < lsn) {
+        requested_lsn_ = lsn;
+        work_.notify_one();
+    }
+    flushed_.wait(lock, [&] { return durable_lsn_ >= lsn; });
+}
+
+void WriteAheadLog::persist_loop() {
+    bool async = options_.durability == Durability::Async;
+    bool group = options_.durability == Durability::Group && options_.window.count() > 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto wanted = [this] { return stopping_ || rotate_requested_ || requested_lsn_ > durable_lsn_; };
+    for (;;) {
+        if (async)
+            work_.wait_for(lock, options_.window, wanted);
+        else
+            work_.wait(lock, wanted);
+
+        if (group && requested_lsn_ > durable_lsn_ && !rotate_requested_ && !stopping_) {
+            // Give concurrent RPCs the window to append before the shared fsync
+            lock.unlock();
+            std::this_thread::sleep_for(options_.window);
+            lock.lock();
+        }
+        if (durable_lsn_ < appended_lsn_ || rotate_requested_)
+            write_batch(lock);
+        if (stopping_ && durable_lsn_ == appended_lsn_)
+            return;
+    }
+}
+
+/**
+ * @brief Write and fsync the buffered records, rotating the segment if due (persistence
+ *        thread only; called and returns with the lock held)
+ */
+void WriteAheadLog::write_batch(std::unique_lock<std::mutex>& lock) {
+    std::vector<uint8_t> batch;
+    batch.swap(buffer_);
+    buffer_.swap(spare_);
+    uint64_t upto = appended_lsn_;
+    bool rotate = rotate_requested_;
+    rotate_requested_ = false;
+    lock.unlock();
+
+    try {
+        if (!batch.empty()) {
+            writer_->write(fd_, batch.data(), batch.size(), segment_size_);
+            writer_->sync(fd_);
+            segment_size_ += batch.size();
+        }
+        if (rotate || segment_size_ >= options_.segment_bytes)
+            open_segment(segment_seq_ + 1);
+    } catch (const std::system_error& e) {
+        fatal(e.what());
+    }
+    batch.clear();
+
+    lock.lock();
+    spare_.swap(batch);
+    durable_lsn_ = upto;
+    if (rotate) {
+        rotated_seq_ = segment_seq_;
+        ++rotations_;
+    }
+    flushed_.notify_all();
+}
+
+void WriteAheadLog::open_segment(uint64_t seq) {
+    std::string path = segment_path(seq);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw errno_error("open " + path);
+    sync_directory(options_.directory);
+    if (fd_ >= 0)
+        ::close(fd_);  // already fsynced by the batch that filled it
+    fd_ = fd;
+    segment_seq_ = seq;
+    segment_size_ = 0;
+}
+
+std::string WriteAheadLog::segment_path(uint64_t seq) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "wal-%020llu.log", static_cast<unsigned long long>(seq));
+    return options_.directory + "/" + name;
+}
+
+std::vector<uint64_t> WriteAheadLog::list_segments() const {
+    std::vector<uint64_t> segments;
+    for (const auto& entry : std::filesystem::directory_iterator(options_.directory)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() == 28 && name.compare(0, 4, "wal-") == 0 && name.compare(24, 4, ".log") == 0)
+            segments.push_back(std::stoull(name.substr(4, 20)));
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+/**
+ * @brief Apply one segment's records; stops at (and truncates) the first invalid record
+ * @param torn Set when the segment ended in a torn or corrupt record
+ * @return Records applied
+ */
+size_t WriteAheadLog::replay_segment(const std::string& path, NumberStore& store, bool& torn) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw errno_error("open " + path);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    size_t pos = 0;
+    size_t applied = 0;
+    while (pos + kHeaderBytes <= data.size()) {
+        const uint8_t* record = data.data() + pos;
+        auto type = static_cast<RecordType>(record[4]);
+        size_t size = type == RecordType::Erase ? 8 : 16;
+        uint32_t crc;
+        std::memcpy(&crc, record, 4);
+        bool known = type == RecordType::Insert || type == RecordType::Erase || type == RecordType::ClearRange;
+        if (!known || pos + kHeaderBytes + size > data.size() || crc32c(record + 4, 1 + size) != crc)
+            break;
+
+        const uint8_t* payload = record + kHeaderBytes;
+        uint64_t a;
+        uint64_t b = 0;
+        std::memcpy(&a, payload, 8);
+        if (size == 16)
+            std::memcpy(&b, payload + 8, 8);
+        switch (type) {
+        case RecordType::Insert: store.insert(a, static_cast<time_t>(static_cast<int64_t>(b))); break;
+        case RecordType::Erase: store.erase(a); break;
+        case RecordType::ClearRange: store.erase_range(a, b); break;
+        }
+        pos += kHeaderBytes + size;
+        ++applied;
+    }
+
+    if (pos < data.size()) {
+        torn = true;
+        std::cerr << "write-ahead log: " << path << " is torn at byte " << pos << " of " << data.size()
+                  << "; truncating" << std::endl;
+        std::filesystem::resize_file(path, pos);
+    }
+    return applied;
+}
@@ -0,0 +1,166 @@
+// wal.h
+#pragma once
+
+#include "file_writer.h"
+#include "number_store.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief When a mutation counts as durable
+ */
+enum class Durability {
+    Fsync,  // every RPC waits for its records to be fsynced; concurrent ones share the fsync
+    Group,  // like Fsync, but the persistence thread first waits a short window to batch more RPCs
+    Async,  // RPCs never wait; the persistence thread flushes every window (may lose that window)
+};
+
+/**
+ * @brief Write-ahead log configuration
+ */
+struct WalOptions {
+    std::string directory;                                 // where segments live
+    Durability durability = Durability::Group;
+    std::chrono::microseconds window{500};                 // group commit / async flush interval
+    size_t segment_bytes = size_t{64} << 20;               // start a new segment past this size
+    bool use_io_uring = true;                              // falls back to pwrite when unavailable
+};
+
+/**
+ * @brief Append-only, checksummed log of store mutations with group commit
+ *
+ * @details Attached to a NumberStore as its MutationObserver, the log copies each mutation
+ *          into an in-memory buffer while the store still holds the key's lock, so the log
+ *          order matches the store order. RPC handlers then call commit(), which waits, as
+ *          the durability mode demands, until the records appended by the calling thread are
+ *          on disk. RPC threads never touch the file: a dedicated persistence thread takes
+ *          everything buffered so far, writes it and fsyncs it in one go (one io_uring
+ *          submission when available, see FileWriter), then wakes every RPC the batch made
+ *          durable, so N concurrent RPCs cost one fsync.
+ *
+ *          Records are fixed-size per type and protected by CRC-32C. The log is a sequence
+ *          of numbered segment files (wal-<seq>.log); recover() replays them in order and
+ *          stops at the first torn or corrupt record, then starts a fresh segment. A
+ *          Checkpointer rotates the log and deletes the segments its snapshot file covers.
+ *
+ *          I/O errors after startup are fatal: the process aborts rather than acknowledge
+ *          writes it cannot persist.
+ */
+class WriteAheadLog final : public MutationObserver {
+public:
+    /**
+     * @brief Open (creating if needed) the log directory
+     * @param options Log configuration
+     * @throws std::system_error if the directory cannot be created
+     */
+    explicit WriteAheadLog(WalOptions options);
+
+    /**
+     * @brief Flush everything still buffered and close the log
+     */
+    ~WriteAheadLog() override;
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    /**
+     * @brief Replay every segment into the store, then open a new segment for appends
+     * @details Must run before the log is attached as the store's observer. Segments older
+     *          than first_seq are already covered by a checkpoint and are deleted unread.
+     * @param store Store to rebuild
+     * @param first_seq First segment to replay (SnapshotFile::wal_seq() of the checkpoint)
+     * @return Number of records applied
+     * @throws std::system_error if a segment cannot be read or the new one created
+     */
+    size_t recover(NumberStore& store, uint64_t first_seq = 0);
+
+    void on_insert(uint64_t number, time_t ts) override;
+    void on_erase(uint64_t number) override;
+    void on_clear_range(uint64_t lo, uint64_t hi) override;
+
+    /**
+     * @brief Wait until the calling thread's records are durable, as the mode requires
+     */
+    void commit();
+
+    /**
+     * @brief Write and fsync everything appended so far, regardless of mode
+     */
+    void flush();
+
+    /**
+     * @brief Flush, then direct all later records to a new segment
+     * @details Every record appended before the call lives in a segment older than the one
+     *          returned, so a checkpoint taken afterwards makes those segments redundant.
+     * @return Sequence number of the new segment
+     */
+    uint64_t rotate();
+
+    /**
+     * @brief Delete segments older than seq
+     * @param seq First segment to keep
+     */
+    void remove_segments_before(uint64_t seq);
+
+    /**
+     * @brief Number of records appended since the log was opened
+     */
+    uint64_t appended() const;
+
+    /**
+     * @brief Name of the I/O implementation in use ("io_uring" or "pwrite"), once recovered
+     */
+    const char* io_name() const { return writer_ ? writer_->name() : "none"; }
+
+    /**
+     * @brief Parse a durability mode name (fsync, group, async)
+     * @param name Mode name
+     * @param mode Parsed mode
+     * @return false if the name is unknown
+     */
+    static bool parse_durability(const std::string& name, Durability& mode);
+
+private:
+    enum class RecordType : uint8_t { Insert = 1, Erase = 2, ClearRange = 3 };
+
+    WalOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_;      // wakes the persistence thread
+    std::condition_variable flushed_;   // wakes committers
+    std::vector<uint8_t> buffer_;       // records appended but not yet written
+    std::vector<uint8_t> spare_;        // recycled write buffer
+    uint64_t appended_lsn_ = 0;         // records appended so far
+    uint64_t requested_lsn_ = 0;        // highest record a committer waits for
+    uint64_t durable_lsn_ = 0;          // records written and fsynced
+    bool rotate_requested_ = false;
+    uint64_t rotations_ = 0;            // rotations completed
+    uint64_t rotated_seq_ = 0;          // segment started by the last rotation
+    bool stopping_ = false;
+
+    // Owned by the persistence thread once it runs
+    std::unique_ptr<FileWriter> writer_;
+    int fd_ = -1;
+    uint64_t segment_seq_ = 0;
+    size_t segment_size_ = 0;
+
+    std::thread persister_;
+
+    void append(RecordType type, const void* payload, size_t size);
+    void wait_durable(std::unique_lock<std::mutex>& lock, uint64_t lsn);
+    void persist_loop();
+    void write_batch(std::unique_lock<std::mutex>& lock);
+    void open_segment(uint64_t seq);
+    std::string segment_path(uint64_t seq) const;
+    std::vector<uint64_t> list_segments() const;
+    size_t replay_segment(const std::string& path, NumberStore& store, bool& torn);
+};